@@ -331,6 +331,8 @@ blconf_g_property_channel_disconnect(gpointer user_data,
     g_return_if_fail(BLCONF_IS_CHANNEL(binding->channel));
     g_return_if_fail(!binding->object || G_IS_OBJECT(binding->object));
 
+    _blconf_channel_unpin_property(binding->channel, binding->blconf_property);
+
     /* unset the prevent recursing in object_disconnect */
     binding->channel = NULL;
 
@@ -371,6 +373,9 @@ blconf_g_property_init(BlconfChannel *channel,
                                                     blconf_g_property_object_disconnect, 0);
     g_free(detailed_signal);
 
+    /* keep the value cached for as long as it's bound */
+    _blconf_channel_pin_property(channel, blconf_property);
+
     /* transfer channel property to the object */
     if(blconf_channel_get_property(channel, blconf_property, &value)) {
         blconf_g_property_channel_notify(channel, blconf_property,
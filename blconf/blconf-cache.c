@@ -40,10 +40,6 @@
 #include "blconf-alias.h"
 #endif
 
-#if 0
-#define DEFAULT_MAX_ENTRIES  -1  /* no limit */
-#define DEFAULT_MAX_AGE      (60*60)  /* 1 hour */
-#endif
 
 #define ALIGN_VAL(val, align)  ( ((val) + ((align) -1)) & ~((align) - 1) )
 
@@ -59,16 +55,144 @@
 
 
 
+/**************** BlconfCacheNode ****************/
+
+
+typedef struct _BlconfCacheNode BlconfCacheNode;
+typedef struct _BlconfCacheItem BlconfCacheItem;
+
+/* the prefix index has a node for every path component of the cached
+ * properties, so a subtree can be found without looking at anything
+ * outside of it.  nodes go away once they have neither an item nor
+ * children. */
+struct _BlconfCacheNode
+{
+    BlconfCacheNode *parent;
+    gchar *name;  /* key in the parent's |children| */
+    GHashTable *children;  /* created when needed */
+    BlconfCacheItem *item;
+};
+
+static BlconfCacheNode *
+blconf_cache_node_new(BlconfCacheNode *parent,
+                      const gchar *name,
+                      gsize name_len)
+{
+    BlconfCacheNode *node = g_slice_new0(BlconfCacheNode);
+
+    node->parent = parent;
+    node->name = g_strndup(name, name_len);
+
+    if(parent) {
+        if(!parent->children)
+            parent->children = g_hash_table_new(g_str_hash, g_str_equal);
+        g_hash_table_insert(parent->children, node->name, node);
+    }
+
+    return node;
+}
+
+static void
+blconf_cache_node_free(BlconfCacheNode *node)
+{
+    if(node->children) {
+        GHashTableIter iter;
+        gpointer child;
+
+        g_hash_table_iter_init(&iter, node->children);
+        while(g_hash_table_iter_next(&iter, NULL, &child))
+            blconf_cache_node_free(child);
+        g_hash_table_destroy(node->children);
+    }
+
+    g_free(node->name);
+    g_slice_free(BlconfCacheNode, node);
+}
+
+/* finds the node of |property| below |root|, one step per path
+ * component, optionally creating the missing ones */
+static BlconfCacheNode *
+blconf_cache_node_lookup(BlconfCacheNode *root,
+                         const gchar *property,
+                         gboolean create)
+{
+    BlconfCacheNode *node = root;
+    const gchar *p = property, *end;
+    gchar *name;
+
+    for(;;) {
+        BlconfCacheNode *child = NULL;
+
+        end = strchr(p, '/');
+        if(!end)
+            end = p + strlen(p);
+
+        name = g_strndup(p, end - p);
+        if(node->children)
+            child = g_hash_table_lookup(node->children, name);
+        g_free(name);
+
+        if(!child) {
+            if(!create)
+                return NULL;
+            child = blconf_cache_node_new(node, p, end - p);
+        }
+
+        node = child;
+        if(!*end)
+            return node;
+        p = end + 1;
+    }
+}
+
+/* frees |node| and its ancestors for as long as they're unused */
+static void
+blconf_cache_node_prune(BlconfCacheNode *node)
+{
+    while(node->parent && !node->item
+          && (!node->children || !g_hash_table_size(node->children)))
+    {
+        BlconfCacheNode *parent = node->parent;
+
+        g_hash_table_remove(parent->children, node->name);
+        blconf_cache_node_free(node);
+        node = parent;
+    }
+}
+
+static void
+blconf_cache_node_collect_items(BlconfCacheNode *node,
+                                GSList **items)
+{
+    if(node->item)
+        *items = g_slist_prepend(*items, node->item);
+
+    if(node->children) {
+        GHashTableIter iter;
+        gpointer child;
+
+        g_hash_table_iter_init(&iter, node->children);
+        while(g_hash_table_iter_next(&iter, NULL, &child))
+            blconf_cache_node_collect_items(child, items);
+    }
+}
+
+
 /**************** BlconfCacheItem ****************/
 
 
-typedef struct
+struct _BlconfCacheItem
 {
-#if 0
-    GTimeVal last_used;
-#endif
+    gint64 last_used;
     GValue *value;
-} BlconfCacheItem;
+
+    /* the item's key, link in the cache's LRU list (most recently
+     * used first) and node in the prefix index, if it's in the cache */
+    const gchar *property;
+    GQueue *lru;
+    GList *lru_link;
+    BlconfCacheNode *node;
+};
 
 static BlconfCacheItem *
 blconf_cache_item_new(const GValue *value,
@@ -79,9 +203,7 @@ blconf_cache_item_new(const GValue *value,
     g_return_val_if_fail(value, NULL);
 
     item = g_slice_new0(BlconfCacheItem);
-#if 0
-    g_get_current_time(&item->last_used);
-#endif
+    item->last_used = g_get_monotonic_time();
 
     if(G_LIKELY(steal)) {
         item->value = (GValue *) value;
@@ -101,9 +223,12 @@ blconf_cache_item_update(BlconfCacheItem *item,
     if(value && _blconf_gvalue_is_equal(item->value, value))
         return FALSE;
 
-#if 0
-    g_get_current_time(&item->last_used);
-#endif
+    /* with a %NULL |value| this just marks the item as used */
+    item->last_used = g_get_monotonic_time();
+    if(item->lru && item->lru->head != item->lru_link) {
+        g_queue_unlink(item->lru, item->lru_link);
+        g_queue_push_head_link(item->lru, item->lru_link);
+    }
 
     if(value) {
         g_value_unset(item->value);
@@ -121,12 +246,48 @@ blconf_cache_item_free(BlconfCacheItem *item)
 {
     g_return_if_fail(item);
 
+    if(item->lru)
+        g_queue_delete_link(item->lru, item->lru_link);
+    if(item->node) {
+        item->node->item = NULL;
+        blconf_cache_node_prune(item->node);
+    }
+
     g_value_unset(item->value);
     g_free(item->value);
     g_slice_free(BlconfCacheItem, item);
 }
 
 
+/**************** BlconfCacheAbsent ****************/
+
+
+/* a property known not to exist; evicted just like the items */
+typedef struct
+{
+    gchar *property;
+    gint64 last_used;
+} BlconfCacheAbsent;
+
+static BlconfCacheAbsent *
+blconf_cache_absent_new(const gchar *property)
+{
+    BlconfCacheAbsent *absent = g_slice_new(BlconfCacheAbsent);
+
+    absent->property = g_strdup(property);
+    absent->last_used = g_get_monotonic_time();
+
+    return absent;
+}
+
+static void
+blconf_cache_absent_free(BlconfCacheAbsent *absent)
+{
+    g_free(absent->property);
+    g_slice_free(BlconfCacheAbsent, absent);
+}
+
+
 /******************* BlconfCacheOldItem *******************/
 
 
@@ -192,6 +353,85 @@ blconf_cache_old_item_end_call(gpointer key,
 }
 
 
+/******************* BlconfCacheBatchItem *******************/
+
+
+/* a property set during a batch, and what to put back if the batch
+ * doesn't go through */
+typedef struct
+{
+    GValue value;
+    BlconfCacheItem *old_item;  /* NULL if the property didn't exist */
+} BlconfCacheBatchItem;
+
+static void
+blconf_cache_batch_item_free(BlconfCacheBatchItem *batch_item)
+{
+    g_value_unset(&batch_item->value);
+    if(batch_item->old_item)
+        blconf_cache_item_free(batch_item->old_item);
+    g_slice_free(BlconfCacheBatchItem, batch_item);
+}
+
+
+/******************* BlconfCacheFetch *******************/
+
+
+/* an asynchronous GetProperty or GetAllProperties call, and everyone
+ * waiting for its result */
+typedef struct
+{
+    BlconfCache *cache;
+    gchar *property;  /* the property base for GetAllProperties */
+    gboolean all;
+    DBusGProxyCall *call;
+    GSList *waiters;
+} BlconfCacheFetch;
+
+typedef struct
+{
+    BlconfCacheFetchFunc func;
+    gpointer user_data;
+} BlconfCacheWaiter;
+
+static BlconfCacheFetch *
+blconf_cache_fetch_new(BlconfCache *cache,
+                       const gchar *property,
+                       gboolean all)
+{
+    BlconfCacheFetch *fetch = g_slice_new0(BlconfCacheFetch);
+
+    fetch->cache = cache;
+    fetch->property = g_strdup(property);
+    fetch->all = all;
+
+    return fetch;
+}
+
+static void
+blconf_cache_fetch_free(BlconfCacheFetch *fetch)
+{
+    g_slist_foreach(fetch->waiters, (GFunc)g_free, NULL);
+    g_slist_free(fetch->waiters);
+    g_free(fetch->property);
+    g_slice_free(BlconfCacheFetch, fetch);
+}
+
+static gboolean
+blconf_cache_fetch_cancel_ht(gpointer key,
+                             gpointer value,
+                             gpointer user_data)
+{
+    BlconfCacheFetch *fetch = value;
+
+    if(fetch->call)
+        dbus_g_proxy_cancel_call(user_data, fetch->call);
+    blconf_cache_fetch_free(fetch);
+
+    return TRUE;
+}
+
+
 /************************* BlconfCache ********************/
 
 
@@ -206,16 +446,49 @@ struct _BlconfCache
 
     gchar *channel_name;
 
-#if 0
+    /* whether we still listen to PropertyChanged and PropertyRemoved,
+     * which we stop doing once the daemon turns out to send
+     * PropertiesChanged as well */
+    gboolean legacy_signals;
+
     gint max_entries;
     gint max_age;
-#endif
-
-    GTree *properties;
+    guint evict_source_id;
+
+    /* property name -> BlconfCacheItem, and the prefix index of the
+     * same items */
+    GHashTable *properties;
+    BlconfCacheNode *root;
+    GQueue lru;
+
+    /* properties bound to object properties: name -> pin count */
+    GHashTable *pins;
+
+    /* properties known not to exist: name -> link in |absent_lru|, whose
+     * data is the BlconfCacheAbsent.  everything below |complete_base|
+     * that isn't in |properties| doesn't exist either, as we've fetched
+     * all of it, except for what got evicted since: those are in
+     * |unknown| */
+    GHashTable *absent;
+    GQueue absent_lru;
+    gchar *complete_base;
+    GHashTable *unknown;
 
     GHashTable *pending_calls;
     GHashTable *old_properties;
 
+    /* nesting level of blconf_cache_begin_batch(), and the properties set
+     * since the outermost one: property name -> BlconfCacheBatchItem */
+    gint batch_depth;
+    GHashTable *batch;
+    /* batches whose commit is waiting for the daemon */
+    GSList *committing;
+
+    /* asynchronous reads in flight, by property (GetProperty) and by
+     * property base (GetAllProperties): name -> BlconfCacheFetch */
+    GHashTable *fetches;
+    GHashTable *fetches_all;
+
 #if GLIB_CHECK_VERSION (2, 32, 0)
     GMutex cache_lock;
 #else
@@ -243,10 +516,8 @@ enum
 {
     PROP0 = 0,
     PROP_CHANNEL_NAME,
-#if 0
     PROP_MAX_ENTRIES,
     PROP_MAX_AGE,
-#endif
 };
 
 static void blconf_cache_set_g_property(GObject *object,
@@ -268,6 +539,13 @@ static void blconf_cache_property_removed(DBusGProxy *proxy,
                                           const gchar *cache_name,
                                           const gchar *property,
                                           gpointer user_data);
+static void blconf_cache_properties_changed(DBusGProxy *proxy,
+                                            const gchar *cache_name,
+                                            GHashTable *changed,
+                                            gchar **removed,
+                                            gpointer user_data);
+
+static void blconf_cache_forget_absent(BlconfCache *cache);
 
 
 static guint signals[N_SIGS] = { 0, };
@@ -308,13 +586,12 @@ blconf_cache_class_init(BlconfCacheClass *klass)
                                                         | G_PARAM_STATIC_NAME
                                                         | G_PARAM_STATIC_NICK
                                                         | G_PARAM_STATIC_BLURB));
-#if 0
     g_object_class_install_property(object_class, PROP_MAX_ENTRIES,
                                     g_param_spec_int("max-entries",
                                                      "Maximum entries",
-                                                     "Maximum number of cache entries to hold at once",
+                                                     "Maximum number of cache entries to hold at once, or -1 for no limit",
                                                      -1, G_MAXINT,
-                                                     DEFAULT_MAX_ENTRIES,
+                                                     BLCONF_CACHE_DEFAULT_MAX_ENTRIES,
                                                      G_PARAM_READWRITE
                                                      | G_PARAM_CONSTRUCT
                                                      | G_PARAM_STATIC_NAME
@@ -324,15 +601,14 @@ blconf_cache_class_init(BlconfCacheClass *klass)
     g_object_class_install_property(object_class, PROP_MAX_AGE,
                                     g_param_spec_int("max-age",
                                                      "Maximum age",
-                                                     "Maximum age (in seconds) before an entry gets evicted from the cache",
+                                                     "Maximum time (in seconds) an entry can go unused before it gets evicted from the cache, or 0 for no limit",
                                                      0, G_MAXINT,
-                                                     DEFAULT_MAX_AGE,
+                                                     BLCONF_CACHE_DEFAULT_MAX_AGE,
                                                      G_PARAM_READWRITE
                                                      | G_PARAM_CONSTRUCT
                                                      | G_PARAM_STATIC_NAME
                                                      | G_PARAM_STATIC_NICK
                                                      | G_PARAM_STATIC_BLURB));
-#endif
 }
 
 static void
@@ -346,16 +622,33 @@ blconf_cache_init(BlconfCache *cache)
     dbus_g_proxy_connect_signal(proxy, "PropertyRemoved",
                                 G_CALLBACK(blconf_cache_property_removed),
                                 cache, NULL);
+    dbus_g_proxy_connect_signal(proxy, "PropertiesChanged",
+                                G_CALLBACK(blconf_cache_properties_changed),
+                                cache, NULL);
+    cache->legacy_signals = TRUE;
 
-    cache->properties = g_tree_new_full((GCompareDataFunc)strcmp, NULL,
-                                        (GDestroyNotify)g_free,
-                                        (GDestroyNotify)blconf_cache_item_free);
+    cache->properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              (GDestroyNotify)g_free,
+                                              (GDestroyNotify)blconf_cache_item_free);
+    cache->root = blconf_cache_node_new(NULL, "", 0);
+
+    g_queue_init(&cache->lru);
+    cache->pins = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        (GDestroyNotify)g_free, NULL);
+
+    /* the keys belong to the BlconfCacheAbsent */
+    cache->absent = g_hash_table_new(g_str_hash, g_str_equal);
+    g_queue_init(&cache->absent_lru);
+    cache->unknown = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           (GDestroyNotify)g_free, NULL);
 
     cache->pending_calls = g_hash_table_new_full(g_direct_hash, g_direct_equal,
                                                  NULL,
                                                  (GDestroyNotify)blconf_cache_old_item_free);
     cache->old_properties = g_hash_table_new_full(g_str_hash, g_str_equal,
                                                   NULL, NULL);
+    cache->fetches = g_hash_table_new(g_str_hash, g_str_equal);
+    cache->fetches_all = g_hash_table_new(g_str_hash, g_str_equal);
 
 #if GLIB_CHECK_VERSION (2, 32, 0)
     g_mutex_init (&cache->cache_lock);
@@ -377,7 +670,7 @@ blconf_cache_set_g_property(GObject *object,
             g_free(cache->channel_name);
             cache->channel_name = g_value_dup_string(value);
             break;
-#if 0
+
         case PROP_MAX_ENTRIES:
             blconf_cache_set_max_entries(cache, g_value_get_int(value));
             break;
@@ -385,7 +678,7 @@ blconf_cache_set_g_property(GObject *object,
         case PROP_MAX_AGE:
             blconf_cache_set_max_age(cache, g_value_get_int(value));
             break;
-#endif
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -404,7 +697,7 @@ blconf_cache_get_g_property(GObject *object,
         case PROP_CHANNEL_NAME:
             g_value_set_string(value, cache->channel_name);
             break;
-#if 0
+
         case PROP_MAX_ENTRIES:
             g_value_set_int(value, cache->max_entries);
             break;
@@ -412,7 +705,7 @@ blconf_cache_get_g_property(GObject *object,
         case PROP_MAX_AGE:
             g_value_set_int(value, cache->max_age);
             break;
-#endif
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -426,12 +719,18 @@ blconf_cache_finalize(GObject *obj)
     DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
     GHashTable *pending_calls;
 
-    dbus_g_proxy_disconnect_signal(proxy, "PropertyChanged",
-                                   G_CALLBACK(blconf_cache_property_changed),
-                                   cache);
+    if(cache->legacy_signals) {
+        dbus_g_proxy_disconnect_signal(proxy, "PropertyChanged",
+                                       G_CALLBACK(blconf_cache_property_changed),
+                                       cache);
+
+        dbus_g_proxy_disconnect_signal(proxy, "PropertyRemoved",
+                                       G_CALLBACK(blconf_cache_property_removed),
+                                       cache);
+    }
 
-    dbus_g_proxy_disconnect_signal(proxy, "PropertyRemoved",
-                                   G_CALLBACK(blconf_cache_property_removed),
+    dbus_g_proxy_disconnect_signal(proxy, "PropertiesChanged",
+                                   G_CALLBACK(blconf_cache_properties_changed),
                                    cache);
 
     /* finish pending calls (without emitting signals, therefore we set
@@ -442,11 +741,33 @@ blconf_cache_finalize(GObject *obj)
                                 cache->channel_name);
     g_hash_table_unref(pending_calls);
 
+    /* nobody can be waiting for these anymore, as the waiters keep the
+     * channel, and thus us, alive */
+    g_hash_table_foreach_remove(cache->fetches,
+                                blconf_cache_fetch_cancel_ht, proxy);
+    g_hash_table_destroy(cache->fetches);
+    g_hash_table_foreach_remove(cache->fetches_all,
+                                blconf_cache_fetch_cancel_ht, proxy);
+    g_hash_table_destroy(cache->fetches_all);
+
     g_free(cache->channel_name);
 
-    g_tree_destroy(cache->properties);
+    if(cache->evict_source_id)
+        g_source_remove(cache->evict_source_id);
+
+    /* this empties the LRU list and the prefix index too */
+    g_hash_table_destroy(cache->properties);
+    blconf_cache_node_free(cache->root);
+    g_hash_table_destroy(cache->pins);
+    blconf_cache_forget_absent(cache);
+    g_hash_table_destroy(cache->absent);
+    g_hash_table_destroy(cache->unknown);
     g_hash_table_destroy(cache->old_properties);
 
+    /* a batch that was never committed is dropped */
+    if(cache->batch)
+        g_hash_table_destroy(cache->batch);
+
 #if !GLIB_CHECK_VERSION (2, 32, 0)
     g_mutex_free (cache->cache_lock);
 #endif
@@ -457,19 +778,230 @@ blconf_cache_finalize(GObject *obj)
 
 
 static void
-blconf_cache_property_changed(DBusGProxy *proxy,
-                              const gchar *channel_name,
-                              const gchar *property,
-                              const GValue *value,
-                              gpointer user_data)
+blconf_cache_insert_item(BlconfCache *cache,
+                         gchar *property,
+                         BlconfCacheItem *item)
+{
+    BlconfCacheNode *node;
+
+    /* takes ownership of |property|, which the item then points to.
+     * the old item goes first, so that the table keeps the new key and
+     * pruning the old node can't take the new item's node with it */
+    g_hash_table_remove(cache->properties, property);
+    g_hash_table_insert(cache->properties, property, item);
+
+    node = blconf_cache_node_lookup(cache->root, property, TRUE);
+    node->item = item;
+    item->node = node;
+
+    item->property = property;
+    item->lru = &cache->lru;
+    g_queue_push_head(&cache->lru, item);
+    item->lru_link = cache->lru.head;
+
+    g_hash_table_remove(cache->unknown, property);
+}
+
+/* whether |property| was set in a batch that isn't through yet */
+static gboolean
+blconf_cache_is_batched(BlconfCache *cache,
+                        const gchar *property)
+{
+    GSList *l;
+
+    if(cache->batch && g_hash_table_lookup(cache->batch, property))
+        return TRUE;
+
+    for(l = cache->committing; l; l = l->next) {
+        if(g_hash_table_lookup(l->data, property))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+blconf_cache_is_pinned(BlconfCache *cache,
+                       const gchar *property)
+{
+    /* properties with bindings, or with writes that can still fail and
+     * need the old value put back */
+    return g_hash_table_lookup(cache->pins, property)
+           || g_hash_table_lookup(cache->old_properties, property)
+           || blconf_cache_is_batched(cache, property);
+}
+
+/* whether |property| is below |complete_base| */
+static gboolean
+blconf_cache_is_complete(BlconfCache *cache,
+                         const gchar *property)
+{
+    gsize len;
+
+    if(!cache->complete_base)
+        return FALSE;
+    if(cache->complete_base[0] == '/' && !cache->complete_base[1])
+        return TRUE;
+
+    len = strlen(cache->complete_base);
+    return !strncmp(property, cache->complete_base, len)
+           && (property[len] == '\0' || property[len] == '/');
+}
+
+static gboolean
+blconf_cache_is_absent(BlconfCache *cache,
+                       const gchar *property)
+{
+    GList *link;
+
+    /* callers check |properties| first */
+    link = g_hash_table_lookup(cache->absent, property);
+    if(link) {
+        BlconfCacheAbsent *absent = link->data;
+
+        absent->last_used = g_get_monotonic_time();
+        if(cache->absent_lru.head != link) {
+            g_queue_unlink(&cache->absent_lru, link);
+            g_queue_push_head_link(&cache->absent_lru, link);
+        }
+
+        return TRUE;
+    }
+
+    return blconf_cache_is_complete(cache, property)
+           && !g_hash_table_lookup(cache->unknown, property);
+}
+
+static void
+blconf_cache_set_absent(BlconfCache *cache,
+                        const gchar *property)
+{
+    g_hash_table_remove(cache->unknown, property);
+
+    if(!blconf_cache_is_absent(cache, property)) {
+        BlconfCacheAbsent *absent = blconf_cache_absent_new(property);
+
+        g_queue_push_head(&cache->absent_lru, absent);
+        g_hash_table_insert(cache->absent, absent->property,
+                            cache->absent_lru.head);
+    }
+}
+
+static void
+blconf_cache_unset_absent(BlconfCache *cache,
+                          const gchar *property)
+{
+    GList *link = g_hash_table_lookup(cache->absent, property);
+
+    if(link) {
+        BlconfCacheAbsent *absent = link->data;
+
+        /* |property| may be the absent's own key */
+        g_hash_table_remove(cache->absent, absent->property);
+        g_queue_delete_link(&cache->absent_lru, link);
+        blconf_cache_absent_free(absent);
+    }
+}
+
+/* forgets everything we know about properties that don't exist */
+static void
+blconf_cache_forget_absent(BlconfCache *cache)
+{
+    BlconfCacheAbsent *absent;
+
+    g_hash_table_remove_all(cache->absent);
+    while((absent = g_queue_pop_head(&cache->absent_lru)))
+        blconf_cache_absent_free(absent);
+
+    g_free(cache->complete_base);
+    cache->complete_base = NULL;
+    g_hash_table_remove_all(cache->unknown);
+}
+
+/* drops the least recently used entries while there are more than
+ * |max_entries|, and any that haven't been used for |max_age| seconds.
+ * the properties known not to exist are limited the same way, on their
+ * own */
+static void
+blconf_cache_evict_locked(BlconfCache *cache)
+{
+    gint64 too_old = 0;
+    GList *l, *prev;
+    guint n_left;
+
+    if(cache->max_age > 0)
+        too_old = g_get_monotonic_time() - (gint64)cache->max_age * G_USEC_PER_SEC;
+
+    /* every item is looked at once at most, even the pinned ones that
+     * get moved to the front */
+    n_left = cache->lru.length;
+    for(l = cache->lru.tail; l && n_left > 0; l = prev, --n_left) {
+        BlconfCacheItem *item = l->data;
+
+        prev = l->prev;
+
+        if((cache->max_entries < 0
+            || g_hash_table_size(cache->properties) <= (guint)cache->max_entries)
+           && item->last_used >= too_old)
+        {
+            /* the rest were used more recently */
+            break;
+        }
+
+        if(blconf_cache_is_pinned(cache, item->property)) {
+            /* it's in use for as long as it's pinned; without this it
+             * would sit at the front looking old once it's unpinned,
+             * and keep the entries behind it from expiring */
+            item->last_used = g_get_monotonic_time();
+            g_queue_unlink(&cache->lru, l);
+            g_queue_push_head_link(&cache->lru, l);
+            continue;
+        }
+
+        /* the property exists, so being below |complete_base| and not
+         * cached no longer means it doesn't */
+        if(blconf_cache_is_complete(cache, item->property)) {
+            g_hash_table_replace(cache->unknown, g_strdup(item->property),
+                                 GINT_TO_POINTER(1));
+        }
+
+        g_hash_table_remove(cache->properties, item->property);
+    }
+
+    while(cache->absent_lru.tail) {
+        BlconfCacheAbsent *absent = cache->absent_lru.tail->data;
+
+        if((cache->max_entries < 0
+            || cache->absent_lru.length <= (guint)cache->max_entries)
+           && absent->last_used >= too_old)
+        {
+            break;
+        }
+
+        blconf_cache_unset_absent(cache, absent->property);
+    }
+}
+
+static gboolean
+blconf_cache_evict_timeout(gpointer user_data)
 {
     BlconfCache *cache = BLCONF_CACHE(user_data);
+
+    blconf_cache_mutex_lock(cache);
+    blconf_cache_evict_locked(cache);
+    blconf_cache_mutex_unlock(cache);
+
+    return TRUE;
+}
+
+static void
+blconf_cache_update_property(BlconfCache *cache,
+                             const gchar *property,
+                             const GValue *value)
+{
     BlconfCacheItem *item;
     gboolean changed = TRUE;
 
-    if(strcmp(channel_name, cache->channel_name))
-        return;
-
     /* if a call was cancelled, we still receive a property-changed from
      * that value, in that case, abort the emission of the signal. we can
      * detect this because the new reply is not processed yet and thus
@@ -477,18 +1009,57 @@ blconf_cache_property_changed(DBusGProxy *proxy,
     if(g_hash_table_lookup(cache->old_properties, property))
         return;
 
-    item = g_tree_lookup(cache->properties, property);
+    /* the batch will overwrite it anyway (or put the old value back) */
+    if(blconf_cache_is_batched(cache, property))
+        return;
+
+    item = g_hash_table_lookup(cache->properties, property);
     if(item)
         changed = blconf_cache_item_update(item, value);
     else {
         item = blconf_cache_item_new(value, FALSE);
-        g_tree_insert(cache->properties, g_strdup(property), item);
+        blconf_cache_insert_item(cache, g_strdup(property), item);
+        blconf_cache_unset_absent(cache, property);
+        blconf_cache_evict_locked(cache);
     }
 
-    if(changed) {
-        g_signal_emit(G_OBJECT(cache), signals[SIG_PROPERTY_CHANGED], 0,
-                      cache->channel_name, property, value);
-    }
+    if(changed) {
+        g_signal_emit(G_OBJECT(cache), signals[SIG_PROPERTY_CHANGED], 0,
+                      cache->channel_name, property, value);
+    }
+}
+
+static void
+blconf_cache_remove_property(BlconfCache *cache,
+                             const gchar *property)
+{
+    GValue value = { 0, };
+
+    if(blconf_cache_is_batched(cache, property))
+        return;
+
+    g_hash_table_remove(cache->properties, property);
+    blconf_cache_set_absent(cache, property);
+
+    g_signal_emit(G_OBJECT(cache), signals[SIG_PROPERTY_CHANGED], 0,
+                  cache->channel_name, property, &value);
+}
+
+/* PropertyChanged and PropertyRemoved are only listened to until the
+ * first PropertiesChanged arrives; older daemons only send these */
+static void
+blconf_cache_property_changed(DBusGProxy *proxy,
+                              const gchar *channel_name,
+                              const gchar *property,
+                              const GValue *value,
+                              gpointer user_data)
+{
+    BlconfCache *cache = BLCONF_CACHE(user_data);
+
+    if(strcmp(channel_name, cache->channel_name))
+        return;
+
+    blconf_cache_update_property(cache, property, value);
 }
 
 static void
@@ -498,15 +1069,49 @@ blconf_cache_property_removed(DBusGProxy *proxy,
                               gpointer user_data)
 {
     BlconfCache *cache = BLCONF_CACHE(user_data);
-    GValue value = { 0, };
 
     if(strcmp(channel_name, cache->channel_name))
         return;
 
-    g_tree_remove(cache->properties, property);
+    blconf_cache_remove_property(cache, property);
+}
+
+static void
+blconf_cache_properties_changed(DBusGProxy *proxy,
+                                const gchar *channel_name,
+                                GHashTable *changed,
+                                gchar **removed,
+                                gpointer user_data)
+{
+    BlconfCache *cache = BLCONF_CACHE(user_data);
+    GHashTableIter iter;
+    gpointer property, value;
+    gint i;
+
+    /* a daemon running with --legacy-signals sends PropertyChanged and
+     * PropertyRemoved right after this for the same properties, which we
+     * don't need to see again */
+    if(cache->legacy_signals) {
+        dbus_g_proxy_disconnect_signal(proxy, "PropertyChanged",
+                                       G_CALLBACK(blconf_cache_property_changed),
+                                       cache);
+        dbus_g_proxy_disconnect_signal(proxy, "PropertyRemoved",
+                                       G_CALLBACK(blconf_cache_property_removed),
+                                       cache);
+        cache->legacy_signals = FALSE;
+    }
 
-    g_signal_emit(G_OBJECT(cache), signals[SIG_PROPERTY_CHANGED], 0,
-                  cache->channel_name, property, &value);
+    if(strcmp(channel_name, cache->channel_name))
+        return;
+
+    if(changed) {
+        g_hash_table_iter_init(&iter, changed);
+        while(g_hash_table_iter_next(&iter, &property, &value))
+            blconf_cache_update_property(cache, property, value);
+    }
+
+    for(i = 0; removed && removed[i]; ++i)
+        blconf_cache_remove_property(cache, removed[i]);
 }
 
 
@@ -538,7 +1143,7 @@ blconf_cache_set_property_reply_handler(DBusGProxy *proxy,
     /* don't destroy old_item yet */
     g_hash_table_steal(cache->pending_calls, old_item->call);
 
-    item = g_tree_lookup(cache->properties, old_item->property);
+    item = g_hash_table_lookup(cache->properties, old_item->property);
     if(G_UNLIKELY(!item)) {
 #ifndef NDEBUG
         g_debug("Couldn't find current cache item based on pending call (libblconf bug?)");
@@ -558,7 +1163,7 @@ blconf_cache_set_property_reply_handler(DBusGProxy *proxy,
         if(old_item->item)
             blconf_cache_item_update(item, old_item->item->value);
         else {
-            g_tree_remove(cache->properties, old_item->property);
+            g_hash_table_remove(cache->properties, old_item->property);
             item = NULL;
         }
 
@@ -616,6 +1221,26 @@ out:
 
 
 
+/* dbus-glib doesn't map remote errors back into our domain; it uses
+ * DBUS_GERROR_REMOTE_EXCEPTION and hides the D-Bus error name in the
+ * message */
+static gboolean
+blconf_cache_error_is_not_found(const GError *error)
+{
+    const gchar *dbus_error_name;
+
+    if(error->domain != DBUS_GERROR
+       || error->code != DBUS_GERROR_REMOTE_EXCEPTION)
+    {
+        return FALSE;
+    }
+
+    dbus_error_name = dbus_g_error_get_name((GError *)error);
+
+    return !g_strcmp0(dbus_error_name, "org.blade.Blconf.Error.PropertyNotFound")
+           || !g_strcmp0(dbus_error_name, "org.blade.Blconf.Error.ChannelNotFound");
+}
+
 BlconfCache *
 blconf_cache_new(const gchar *channel_name)
 {
@@ -633,7 +1258,7 @@ blconf_cache_prefetch_ht(gpointer key,
     BlconfCacheItem *item;
 
     item = blconf_cache_item_new(value, TRUE);
-    g_tree_insert(cache->properties, key, item);
+    blconf_cache_insert_item(cache, key, item);
 
     return TRUE;
 }
@@ -648,7 +1273,7 @@ blconf_cache_prefetch(BlconfCache *cache,
     DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
     GError *tmp_error = NULL;
 
-    g_return_val_if_fail(g_tree_nnodes(cache->properties) == 0, FALSE);
+    g_return_val_if_fail(g_hash_table_size(cache->properties) == 0, FALSE);
 
     blconf_cache_mutex_lock(cache);
 
@@ -658,11 +1283,22 @@ blconf_cache_prefetch(BlconfCache *cache,
     {
         g_hash_table_foreach_steal(props, blconf_cache_prefetch_ht, cache);
         g_hash_table_destroy(props);
-        /* TODO: honor max entries */
+        ret = TRUE;
+    } else if(blconf_cache_error_is_not_found(tmp_error)) {
+        /* the channel doesn't exist yet, so there's nothing below
+         * |property_base| either */
+        g_error_free(tmp_error);
         ret = TRUE;
     } else
         g_propagate_error(error, tmp_error);
 
+    if(ret) {
+        g_free(cache->complete_base);
+        cache->complete_base = g_strdup(property_base ? property_base : "/");
+        g_hash_table_remove_all(cache->unknown);
+        blconf_cache_evict_locked(cache);
+    }
+
     blconf_cache_mutex_unlock(cache);
 
     return ret;
@@ -676,8 +1312,8 @@ blconf_cache_lookup_locked(BlconfCache *cache,
 {
     BlconfCacheItem *item = NULL;
 
-    item = g_tree_lookup(cache->properties, property);
-    if(!item) {
+    item = g_hash_table_lookup(cache->properties, property);
+    if(!item && !blconf_cache_is_absent(cache, property)) {
         DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
         GValue tmpval = { 0, };
         GError *tmp_error = NULL;
@@ -687,9 +1323,12 @@ blconf_cache_lookup_locked(BlconfCache *cache,
                                       property, &tmpval, &tmp_error))
         {
             item = blconf_cache_item_new(&tmpval, FALSE);
-            g_tree_insert(cache->properties, g_strdup(property), item);
+            blconf_cache_insert_item(cache, g_strdup(property), item);
             g_value_unset(&tmpval);
-            /* TODO: check tree for evictions */
+        } else if(blconf_cache_error_is_not_found(tmp_error)) {
+            /* remember that, so we don't ask again until it's set */
+            blconf_cache_set_absent(cache, property);
+            g_error_free(tmp_error);
         } else
             g_propagate_error(error, tmp_error);
     }
@@ -706,10 +1345,8 @@ blconf_cache_lookup_locked(BlconfCache *cache,
                     item = NULL;
             }
         }
-#if 0
         if(item)
             blconf_cache_item_update(item, NULL);
-#endif
     }
 
     return !!item;
@@ -728,11 +1365,339 @@ blconf_cache_lookup(BlconfCache *cache,
 
     blconf_cache_mutex_lock(cache);
     ret = blconf_cache_lookup_locked(cache, property, value, error);
+    blconf_cache_evict_locked(cache);
+    blconf_cache_mutex_unlock(cache);
+
+    return ret;
+}
+
+/* looks up all of |properties| with at most one round trip to the daemon,
+ * for the ones that aren't cached yet.  |values| must have room for one
+ * (unset) GValue per property; those of properties that don't exist are
+ * left unset. */
+gboolean
+blconf_cache_lookup_many(BlconfCache *cache,
+                         const gchar * const *properties,
+                         GValue *values,
+                         GError **error)
+{
+    GPtrArray *missing;
+    gboolean ret = TRUE;
+    gint i;
+
+    g_return_val_if_fail(BLCONF_IS_CACHE(cache) && properties && values
+                         && (!error || !*error), FALSE);
+
+    blconf_cache_mutex_lock(cache);
+
+    missing = g_ptr_array_new();
+    for(i = 0; properties[i]; ++i) {
+        if(!g_hash_table_lookup(cache->properties, properties[i])
+           && !blconf_cache_is_absent(cache, properties[i]))
+        {
+            g_ptr_array_add(missing, (gpointer)properties[i]);
+        }
+    }
+
+    if(missing->len > 0) {
+        DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
+        GHashTable *props = NULL;
+        guint n_missing = missing->len;
+
+        g_ptr_array_add(missing, NULL);
+
+        if(blconf_client_get_properties(proxy, cache->channel_name,
+                                        (const gchar **)missing->pdata,
+                                        &props, error))
+        {
+            g_hash_table_foreach_steal(props, blconf_cache_prefetch_ht, cache);
+            g_hash_table_destroy(props);
+
+            /* whatever didn't come back doesn't exist */
+            for(i = 0; i < (gint)n_missing; ++i) {
+                const gchar *property = g_ptr_array_index(missing, i);
+
+                if(!g_hash_table_lookup(cache->properties, property))
+                    blconf_cache_set_absent(cache, property);
+            }
+        } else
+            ret = FALSE;
+    }
+
+    g_ptr_array_free(missing, TRUE);
+
+    for(i = 0; properties[i]; ++i) {
+        BlconfCacheItem *item = g_hash_table_lookup(cache->properties, properties[i]);
+
+        if(item) {
+            g_value_init(&values[i], G_VALUE_TYPE(item->value));
+            g_value_copy(item->value, &values[i]);
+            blconf_cache_item_update(item, NULL);
+        }
+    }
+
+    blconf_cache_evict_locked(cache);
+
     blconf_cache_mutex_unlock(cache);
 
     return ret;
 }
 
+static void
+blconf_cache_fetch_insert_ht(gpointer key,
+                             gpointer value,
+                             gpointer user_data)
+{
+    BlconfCache *cache = BLCONF_CACHE(user_data);
+
+    /* anything already in the cache was set or changed while the call
+     * was in flight, so it's newer than what we got */
+    if(!g_hash_table_lookup(cache->properties, key)) {
+        blconf_cache_insert_item(cache, g_strdup(key),
+                                 blconf_cache_item_new(value, FALSE));
+        blconf_cache_unset_absent(cache, key);
+    }
+}
+
+static void
+blconf_cache_fetch_reply_handler(DBusGProxy *proxy,
+                                 DBusGProxyCall *call,
+                                 gpointer user_data)
+{
+    BlconfCacheFetch *fetch = user_data;
+    BlconfCache *cache = fetch->cache;
+    GValue value = { 0, };
+    GHashTable *props = NULL;
+    gconstpointer result = NULL;
+    GError *error = NULL;
+    GSList *waiters, *l;
+
+    blconf_cache_mutex_lock(cache);
+
+    g_hash_table_remove(fetch->all ? cache->fetches_all : cache->fetches,
+                        fetch->property);
+    fetch->call = NULL;
+    waiters = fetch->waiters;
+    fetch->waiters = NULL;
+
+    if(fetch->all) {
+        if(dbus_g_proxy_end_call(proxy, call, &error,
+                                 BLCONF_TYPE_G_STRING_VALUE_HASHTABLE, &props,
+                                 G_TYPE_INVALID))
+        {
+            g_hash_table_foreach(props, blconf_cache_fetch_insert_ht, cache);
+            result = props;
+        }
+    } else {
+        BlconfCacheItem *item;
+
+        if(!dbus_g_proxy_end_call(proxy, call, &error,
+                                  G_TYPE_VALUE, &value,
+                                  G_TYPE_INVALID)
+           && blconf_cache_error_is_not_found(error))
+        {
+            /* not an error; the property just doesn't exist */
+            g_clear_error(&error);
+        }
+
+        if(!error) {
+            if(G_IS_VALUE(&value))
+                blconf_cache_fetch_insert_ht(fetch->property, &value, cache);
+            else if(!g_hash_table_lookup(cache->properties, fetch->property))
+                blconf_cache_set_absent(cache, fetch->property);
+
+            /* hand out what's in the cache now, which might be newer */
+            item = g_hash_table_lookup(cache->properties, fetch->property);
+            if(item) {
+                if(G_IS_VALUE(&value))
+                    g_value_unset(&value);
+                g_value_init(&value, G_VALUE_TYPE(item->value));
+                g_value_copy(item->value, &value);
+                result = &value;
+            }
+        }
+    }
+
+    blconf_cache_evict_locked(cache);
+
+    blconf_cache_mutex_unlock(cache);
+
+    /* waiters that abandoned the fetch are no longer in the list, and the
+     * ones still in it can't abandon it anymore */
+    for(l = waiters; l; l = l->next) {
+        BlconfCacheWaiter *waiter = l->data;
+
+        waiter->func(cache, result, error, waiter->user_data);
+        g_free(waiter);
+    }
+    g_slist_free(waiters);
+
+    if(G_IS_VALUE(&value))
+        g_value_unset(&value);
+    if(props)
+        g_hash_table_destroy(props);
+    if(error)
+        g_error_free(error);
+
+    blconf_cache_fetch_free(fetch);
+}
+
+static void
+blconf_cache_fetch_internal(BlconfCache *cache,
+                            const gchar *property,
+                            gboolean all,
+                            BlconfCacheFetchFunc func,
+                            gpointer user_data)
+{
+    GHashTable *fetches = all ? cache->fetches_all : cache->fetches;
+    BlconfCacheFetch *fetch;
+    BlconfCacheWaiter *waiter;
+
+    /* called with the cache lock held.  concurrent reads of the same
+     * thing all wait for a single call */
+    fetch = g_hash_table_lookup(fetches, property);
+    if(!fetch) {
+        DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
+
+        fetch = blconf_cache_fetch_new(cache, property, all);
+        fetch->call = dbus_g_proxy_begin_call(proxy,
+                                              all ? "GetAllProperties"
+                                                  : "GetProperty",
+                                              blconf_cache_fetch_reply_handler,
+                                              fetch, NULL,
+                                              G_TYPE_STRING, cache->channel_name,
+                                              G_TYPE_STRING, property,
+                                              G_TYPE_INVALID);
+        g_hash_table_insert(fetches, fetch->property, fetch);
+    }
+
+    waiter = g_new0(BlconfCacheWaiter, 1);
+    waiter->func = func;
+    waiter->user_data = user_data;
+    fetch->waiters = g_slist_append(fetch->waiters, waiter);
+}
+
+/* reads |property| without blocking.  if it's cached (or known not to
+ * exist), |func| is called right away and %FALSE is returned; otherwise
+ * it's called once the value arrives from the daemon, unless the fetch
+ * is abandoned first.  the result passed to |func| is the (cache-owned)
+ * GValue of the property, or %NULL if it doesn't exist. */
+gboolean
+blconf_cache_fetch(BlconfCache *cache,
+                   const gchar *property,
+                   BlconfCacheFetchFunc func,
+                   gpointer user_data)
+{
+    BlconfCacheItem *item;
+    GValue value = { 0, };
+    gboolean absent = FALSE;
+
+    g_return_val_if_fail(BLCONF_IS_CACHE(cache) && property && func, FALSE);
+
+    blconf_cache_mutex_lock(cache);
+
+    item = g_hash_table_lookup(cache->properties, property);
+    if(item) {
+        g_value_init(&value, G_VALUE_TYPE(item->value));
+        g_value_copy(item->value, &value);
+        blconf_cache_item_update(item, NULL);
+    } else if(blconf_cache_is_absent(cache, property))
+        absent = TRUE;
+    else
+        blconf_cache_fetch_internal(cache, property, FALSE, func, user_data);
+
+    blconf_cache_mutex_unlock(cache);
+
+    if(item) {
+        func(cache, &value, NULL, user_data);
+        g_value_unset(&value);
+    } else if(absent)
+        func(cache, NULL, NULL, user_data);
+
+    return !item && !absent;
+}
+
+/* like blconf_cache_fetch(), but for all properties below |property_base|,
+ * which always come from the daemon.  the result passed to |func| is a
+ * (cache-owned) property name -> GValue hash table. */
+void
+blconf_cache_fetch_all(BlconfCache *cache,
+                       const gchar *property_base,
+                       BlconfCacheFetchFunc func,
+                       gpointer user_data)
+{
+    g_return_if_fail(BLCONF_IS_CACHE(cache) && func);
+
+    blconf_cache_mutex_lock(cache);
+    blconf_cache_fetch_internal(cache, property_base ? property_base : "/",
+                                TRUE, func, user_data);
+    blconf_cache_mutex_unlock(cache);
+}
+
+static GSList *
+blconf_cache_fetch_find_waiter(GHashTable *fetches,
+                               BlconfCacheFetchFunc func,
+                               gpointer user_data,
+                               BlconfCacheFetch **fetch_return)
+{
+    GHashTableIter iter;
+    gpointer value;
+    GSList *l;
+
+    g_hash_table_iter_init(&iter, fetches);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) {
+        BlconfCacheFetch *fetch = value;
+
+        for(l = fetch->waiters; l; l = l->next) {
+            BlconfCacheWaiter *waiter = l->data;
+
+            if(waiter->func == func && waiter->user_data == user_data) {
+                *fetch_return = fetch;
+                return l;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* stops waiting for the fetch that |func| and |user_data| were passed to;
+ * the call itself is cancelled when nobody else waits for it.  returns
+ * %FALSE if it's too late, in which case |func| is (being) called anyway. */
+gboolean
+blconf_cache_fetch_abandon(BlconfCache *cache,
+                           BlconfCacheFetchFunc func,
+                           gpointer user_data)
+{
+    BlconfCacheFetch *fetch = NULL;
+    GSList *l;
+
+    g_return_val_if_fail(BLCONF_IS_CACHE(cache) && func, FALSE);
+
+    blconf_cache_mutex_lock(cache);
+
+    l = blconf_cache_fetch_find_waiter(cache->fetches, func, user_data, &fetch);
+    if(!l)
+        l = blconf_cache_fetch_find_waiter(cache->fetches_all, func, user_data, &fetch);
+
+    if(l) {
+        g_free(l->data);
+        fetch->waiters = g_slist_delete_link(fetch->waiters, l);
+
+        if(!fetch->waiters) {
+            g_hash_table_remove(fetch->all ? cache->fetches_all : cache->fetches,
+                                fetch->property);
+            dbus_g_proxy_cancel_call(_blconf_get_dbus_g_proxy(), fetch->call);
+            fetch->call = NULL;
+            blconf_cache_fetch_free(fetch);
+        }
+    }
+
+    blconf_cache_mutex_unlock(cache);
+
+    return !!l;
+}
+
 gboolean
 blconf_cache_set(BlconfCache *cache,
                  const gchar *property,
@@ -745,7 +1710,7 @@ blconf_cache_set(BlconfCache *cache,
 
     blconf_cache_mutex_lock(cache);
 
-    item = g_tree_lookup(cache->properties, property);
+    item = g_hash_table_lookup(cache->properties, property);
     if(!item) {
         /* this is really quite the opposite of what we want here,
          * but i can't think of a better way yet. */
@@ -753,23 +1718,7 @@ blconf_cache_set(BlconfCache *cache,
         GError *tmp_error = NULL;
 
         if(!blconf_cache_lookup_locked(cache, property, &tmp_val, &tmp_error)) {
-            /* this is just another example of dbus-glib's brain-deadedness.
-             * instead of remapping the remote error back into the local
-             * domain and code, it uses DBUS_GERROR as the domain,
-             * DBUS_GERROR_REMOTE_EXCEPTION as the code, and then "hides"
-             * the full string ("org.blade.Blconf.Error.Whatever") in
-             * GError::message after a NUL byte.  so stupid. */
-            const gchar *dbus_error_name = NULL;
-
-            if(G_LIKELY(tmp_error->domain == DBUS_GERROR
-                        && tmp_error->code == DBUS_GERROR_REMOTE_EXCEPTION))
-            {
-                dbus_error_name = dbus_g_error_get_name(tmp_error);
-            }
-
-            if(g_strcmp0(dbus_error_name, "org.blade.Blconf.Error.PropertyNotFound") != 0
-               && g_strcmp0(dbus_error_name, "org.blade.Blconf.Error.ChannelNotFound") != 0)
-            {
+            if(tmp_error) {
                 /* this is bad... */
                 g_propagate_error(error, tmp_error);
                 blconf_cache_mutex_unlock(cache);
@@ -777,10 +1726,9 @@ blconf_cache_set(BlconfCache *cache,
             }
 
             /* prop just doesn't exist; continue */
-            g_error_free(tmp_error);
         } else {
             g_value_unset(&tmp_val);
-            item = g_tree_lookup(cache->properties, property);
+            item = g_hash_table_lookup(cache->properties, property);
         }
     }
 
@@ -792,6 +1740,25 @@ blconf_cache_set(BlconfCache *cache,
         }
     }
 
+    if(cache->batch_depth > 0) {
+        /* held back until blconf_cache_commit_batch() */
+        BlconfCacheBatchItem *batch_item = g_hash_table_lookup(cache->batch,
+                                                               property);
+
+        if(!batch_item) {
+            batch_item = g_slice_new0(BlconfCacheBatchItem);
+            if(item)
+                batch_item->old_item = blconf_cache_item_new(item->value, FALSE);
+            g_hash_table_insert(cache->batch, g_strdup(property), batch_item);
+        } else
+            g_value_unset(&batch_item->value);
+
+        g_value_init(&batch_item->value, G_VALUE_TYPE(value));
+        g_value_copy(value, &batch_item->value);
+
+        goto update_item;
+    }
+
     old_item = g_hash_table_lookup(cache->old_properties, property);
     if(old_item) {
         /* if we have an old item, it means that a previous set
@@ -823,13 +1790,17 @@ blconf_cache_set(BlconfCache *cache,
                                              G_TYPE_INVALID);
     g_hash_table_insert(cache->pending_calls, old_item->call, old_item);
 
+update_item:
     if(item)
         blconf_cache_item_update(item, value);
     else {
         item = blconf_cache_item_new(value, FALSE);
-        g_tree_insert(cache->properties, g_strdup(property), item);
+        blconf_cache_insert_item(cache, g_strdup(property), item);
+        blconf_cache_unset_absent(cache, property);
     }
 
+    blconf_cache_evict_locked(cache);
+
     blconf_cache_mutex_unlock(cache);
 
     g_signal_emit(G_OBJECT(cache), signals[SIG_PROPERTY_CHANGED], 0,
@@ -838,25 +1809,129 @@ blconf_cache_set(BlconfCache *cache,
     return TRUE;
 }
 
-typedef struct
+void
+blconf_cache_begin_batch(BlconfCache *cache)
 {
-    gchar *property_base;
-    gsize property_base_len;
-    GSList *matches;
-} BlconfCacheRecurseData;
+    blconf_cache_mutex_lock(cache);
 
-static gboolean
-blconf_cache_collect_properties_recursive(gpointer key,
-                                          gpointer value,
-                                          gpointer user_data)
+    if(cache->batch_depth++ == 0) {
+        cache->batch = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                             (GDestroyNotify)g_free,
+                                             (GDestroyNotify)blconf_cache_batch_item_free);
+    }
+
+    blconf_cache_mutex_unlock(cache);
+}
+
+/* puts back the values the properties in |batch| had before the batch
+ * and lets everyone know, after the daemon has refused it.  called with
+ * the lock held. */
+static void
+blconf_cache_batch_revert(BlconfCache *cache,
+                          GHashTable *batch)
 {
-    gchar *property_name = key;
-    BlconfCacheRecurseData *rdata = user_data;
+    GHashTableIter iter;
+    gpointer property, batch_item;
+
+    g_hash_table_iter_init(&iter, batch);
+    while(g_hash_table_iter_next(&iter, &property, &batch_item)) {
+        BlconfCacheItem *old_item = ((BlconfCacheBatchItem *)batch_item)->old_item;
+        BlconfCacheItem *item;
+        GValue value = { 0, };
+
+        /* a write made while the batch was on its way has the last word */
+        if(g_hash_table_lookup(cache->old_properties, property))
+            continue;
+
+        item = g_hash_table_lookup(cache->properties, property);
+        if(old_item && item)
+            blconf_cache_item_update(item, old_item->value);
+        else if(old_item) {
+            item = blconf_cache_item_new(old_item->value, FALSE);
+            blconf_cache_insert_item(cache, g_strdup(property), item);
+        } else {
+            g_hash_table_remove(cache->properties, property);
+            item = NULL;
+        }
 
-    if(!g_ascii_strncasecmp(rdata->property_base, property_name, rdata->property_base_len))
-        rdata->matches = g_slist_prepend(rdata->matches, property_name);
+        /* the item may be gone once the lock is dropped */
+        if(item) {
+            g_value_init(&value, G_VALUE_TYPE(item->value));
+            g_value_copy(item->value, &value);
+        }
 
-    return FALSE;
+        /* we need to drop the lock when running the signal handlers */
+        blconf_cache_mutex_unlock(cache);
+        g_signal_emit(G_OBJECT(cache), signals[SIG_PROPERTY_CHANGED],
+                      g_quark_from_string(property),
+                      cache->channel_name, property, &value);
+        blconf_cache_mutex_lock(cache);
+
+        if(G_IS_VALUE(&value))
+            g_value_unset(&value);
+    }
+}
+
+gboolean
+blconf_cache_commit_batch(BlconfCache *cache,
+                          GError **error)
+{
+    DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
+    GHashTable *batch, *values;
+    GHashTableIter iter;
+    gpointer property, batch_item;
+    gboolean ret;
+
+    blconf_cache_mutex_lock(cache);
+
+    if(G_UNLIKELY(cache->batch_depth == 0)) {
+        blconf_cache_mutex_unlock(cache);
+        g_critical("blconf_cache_commit_batch() called without a batch (libblconf bug?)");
+        return FALSE;
+    }
+
+    /* only the outermost commit sends anything */
+    if(--cache->batch_depth > 0) {
+        blconf_cache_mutex_unlock(cache);
+        return TRUE;
+    }
+
+    batch = cache->batch;
+    cache->batch = NULL;
+
+    if(g_hash_table_size(batch) == 0) {
+        g_hash_table_destroy(batch);
+        blconf_cache_mutex_unlock(cache);
+        return TRUE;
+    }
+
+    values = g_hash_table_new(g_str_hash, g_str_equal);
+    g_hash_table_iter_init(&iter, batch);
+    while(g_hash_table_iter_next(&iter, &property, &batch_item))
+        g_hash_table_insert(values, property, &((BlconfCacheBatchItem *)batch_item)->value);
+
+    /* nobody else touches |batch|, but the properties in it stay pinned
+     * while we're waiting */
+    cache->committing = g_slist_prepend(cache->committing, batch);
+    blconf_cache_mutex_unlock(cache);
+
+    /* this has to be sync: the caller wants to know if it worked.  other
+     * threads can use the cache in the meantime. */
+    ret = blconf_client_set_properties(proxy, cache->channel_name, values,
+                                       error);
+
+    blconf_cache_mutex_lock(cache);
+    cache->committing = g_slist_remove(cache->committing, batch);
+
+    if(!ret)
+        blconf_cache_batch_revert(cache, batch);
+
+    g_hash_table_destroy(values);
+    g_hash_table_destroy(batch);
+
+    blconf_cache_mutex_unlock(cache);
+
+    return ret;
 }
 
 gboolean
@@ -908,29 +1983,38 @@ blconf_cache_reset(BlconfCache *cache,
 
     if(ret) {
         /* here we just evict the entry from the cache if we have one.
-         * unfortunately i think it's the best we can do here.  this is
-         * pretty slow because we have to traverse the entire tree if
-         * recursive==TRUE. */
+         * unfortunately i think it's the best we can do here. */
+
+        if(!recursive)
+            g_hash_table_remove(cache->properties, property_base);
 
-        g_tree_remove(cache->properties, property_base);
+        /* a reset can bring back a default value without the daemon
+         * telling us (if the value doesn't change), so we don't know
+         * anymore what doesn't exist.  resets are rare enough to not
+         * bother with anything finer than this. */
+        blconf_cache_forget_absent(cache);
 
         if(recursive) {
-            BlconfCacheRecurseData rdata;
-            GSList *l;
+            BlconfCacheNode *node;
+            GSList *items = NULL, *l;
 
-            rdata.property_base = g_strdup_printf("%s/", property_base);
-            rdata.property_base_len = strlen(rdata.property_base);
-            rdata.matches = NULL;
+            /* only the subtree is looked at.  "/" is the whole channel */
+            if(property_base[0] == '/' && !property_base[1])
+                node = cache->root;
+            else
+                node = blconf_cache_node_lookup(cache->root, property_base, FALSE);
 
-            g_tree_foreach(cache->properties,
-                           blconf_cache_collect_properties_recursive,
-                           &rdata);
+            if(node)
+                blconf_cache_node_collect_items(node, &items);
 
-            for(l = rdata.matches; l; l = l->next)
-                g_tree_remove(cache->properties, l->data);
+            /* removing an item can free its now unused nodes, but not
+             * those of the items that are still there */
+            for(l = items; l; l = l->next) {
+                BlconfCacheItem *item = l->data;
 
-            g_free(rdata.property_base);
-            g_slist_free(rdata.matches);
+                g_hash_table_remove(cache->properties, item->property);
+            }
+            g_slist_free(items);
         }
     }
 #endif
@@ -940,14 +2024,46 @@ blconf_cache_reset(BlconfCache *cache,
     return ret;
 }
 
-#if 0
+void
+blconf_cache_pin(BlconfCache *cache,
+                 const gchar *property)
+{
+    gint pins;
+
+    g_return_if_fail(BLCONF_IS_CACHE(cache) && property);
+
+    blconf_cache_mutex_lock(cache);
+    pins = GPOINTER_TO_INT(g_hash_table_lookup(cache->pins, property));
+    g_hash_table_replace(cache->pins, g_strdup(property),
+                         GINT_TO_POINTER(pins + 1));
+    blconf_cache_mutex_unlock(cache);
+}
+
+void
+blconf_cache_unpin(BlconfCache *cache,
+                   const gchar *property)
+{
+    gint pins;
+
+    g_return_if_fail(BLCONF_IS_CACHE(cache) && property);
+
+    blconf_cache_mutex_lock(cache);
+    pins = GPOINTER_TO_INT(g_hash_table_lookup(cache->pins, property));
+    if(G_LIKELY(pins > 1)) {
+        g_hash_table_replace(cache->pins, g_strdup(property),
+                             GINT_TO_POINTER(pins - 1));
+    } else
+        g_hash_table_remove(cache->pins, property);
+    blconf_cache_mutex_unlock(cache);
+}
+
 void
 blconf_cache_set_max_entries(BlconfCache *cache,
                              gint max_entries)
 {
     blconf_cache_mutex_lock(cache);
     cache->max_entries = max_entries;
-    /* TODO: check tree for eviction */
+    blconf_cache_evict_locked(cache);
     blconf_cache_mutex_unlock(cache);
 }
 
@@ -962,8 +2078,23 @@ blconf_cache_set_max_age(BlconfCache *cache,
                          gint max_age)
 {
     blconf_cache_mutex_lock(cache);
+
     cache->max_age = max_age;
-    /* TODO: check tree for eviction */
+    blconf_cache_evict_locked(cache);
+
+    /* unused entries also have to go if nobody looks at the cache, so
+     * check for them every |max_age| seconds; an entry then lives at
+     * most twice that long without being used */
+    if(cache->evict_source_id) {
+        g_source_remove(cache->evict_source_id);
+        cache->evict_source_id = 0;
+    }
+    if(max_age > 0) {
+        cache->evict_source_id = g_timeout_add_seconds(max_age,
+                                                       blconf_cache_evict_timeout,
+                                                       cache);
+    }
+
     blconf_cache_mutex_unlock(cache);
 }
 
@@ -972,4 +2103,3 @@ blconf_cache_get_max_age(BlconfCache *cache)
 {
     return cache->max_age;
 }
-#endif
@@ -30,10 +30,18 @@
 #define BLCONF_IS_CACHE_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), BLCONF_TYPE_CACHE))
 #define BLCONF_CACHE_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS((obj), BLCONF_TYPE_CACHE, BlconfCacheClass))
 
+#define BLCONF_CACHE_DEFAULT_MAX_ENTRIES  -1  /* no limit */
+#define BLCONF_CACHE_DEFAULT_MAX_AGE      0  /* no limit */
+
 G_BEGIN_DECLS
 
 typedef struct _BlconfCache         BlconfCache;
 
+typedef void (*BlconfCacheFetchFunc)(BlconfCache *cache,
+                                     gconstpointer result,
+                                     const GError *error,
+                                     gpointer user_data);
+
 G_GNUC_INTERNAL
 GType blconf_cache_get_type(void) G_GNUC_CONST;
 
@@ -51,18 +59,55 @@ gboolean blconf_cache_lookup(BlconfCache *cache,
                              GValue *value,
                              GError **error);
 
+G_GNUC_INTERNAL
+gboolean blconf_cache_lookup_many(BlconfCache *cache,
+                                  const gchar * const *properties,
+                                  GValue *values,
+                                  GError **error);
+
+G_GNUC_INTERNAL
+gboolean blconf_cache_fetch(BlconfCache *cache,
+                            const gchar *property,
+                            BlconfCacheFetchFunc func,
+                            gpointer user_data);
+
+G_GNUC_INTERNAL
+void blconf_cache_fetch_all(BlconfCache *cache,
+                            const gchar *property_base,
+                            BlconfCacheFetchFunc func,
+                            gpointer user_data);
+
+G_GNUC_INTERNAL
+gboolean blconf_cache_fetch_abandon(BlconfCache *cache,
+                                    BlconfCacheFetchFunc func,
+                                    gpointer user_data);
+
 G_GNUC_INTERNAL
 gboolean blconf_cache_set(BlconfCache *cache,
                           const gchar *property,
                           const GValue *value,
                           GError **error);
 
+G_GNUC_INTERNAL
+void blconf_cache_begin_batch(BlconfCache *cache);
+
+G_GNUC_INTERNAL
+gboolean blconf_cache_commit_batch(BlconfCache *cache,
+                                   GError **error);
+
 G_GNUC_INTERNAL
 gboolean blconf_cache_reset(BlconfCache *cache,
                             const gchar *property_base,
                             gboolean recursive,
                             GError **error);
-#if 0
+
+G_GNUC_INTERNAL
+void blconf_cache_pin(BlconfCache *cache,
+                      const gchar *property);
+G_GNUC_INTERNAL
+void blconf_cache_unpin(BlconfCache *cache,
+                        const gchar *property);
+
 G_GNUC_INTERNAL
 void blconf_cache_set_max_entries(BlconfCache *cache,
                                   gint max_entries);
@@ -74,7 +119,7 @@ void blconf_cache_set_max_age(BlconfCache *cache,
                               gint max_age);
 G_GNUC_INTERNAL
 gint blconf_cache_get_max_age(BlconfCache *cache);
-#endif
+
 G_END_DECLS
 
 #endif  /* __BLCONF_CACHE_H__ */
@@ -26,6 +26,12 @@
 #include <string.h>
 #endif
 
+#ifdef GETTEXT_PACKAGE
+#include <glib/gi18n-lib.h>
+#else
+#include <glib/gi18n.h>
+#endif
+
 #include "blconf-channel.h"
 #include "blconf-cache.h"
 #include "blconf-dbus-bindings.h"
@@ -85,6 +91,8 @@ enum
     PROP_CHANNEL_NAME,
     PROP_PROPERTY_BASE,
     PROP_IS_SINGLETON,
+    PROP_MAX_CACHE_ENTRIES,
+    PROP_MAX_CACHE_AGE,
 };
 
 static GObject *blconf_channel_constructor(GType type,
@@ -203,6 +211,53 @@ blconf_channel_class_init(BlconfChannelClass *klass)
                                                          | G_PARAM_STATIC_NAME
                                                          | G_PARAM_STATIC_NICK
                                                          | G_PARAM_STATIC_BLURB));
+
+    /**
+     * BlconfChannel::max-cache-entries:
+     *
+     * The maximum number of property values the channel keeps cached,
+     * or -1 for no limit.  When there are more, the least recently used
+     * ones are dropped.  Values of bound properties (see
+     * blconf_g_property_bind()) and values that are still being written
+     * are never dropped.  The channel also remembers up to this many
+     * properties that turned out not to exist.  Note that singleton
+     * channels are shared by everyone in the process using the same
+     * channel name.
+     *
+     * Since: 4.13.0
+     **/
+    g_object_class_install_property(object_class, PROP_MAX_CACHE_ENTRIES,
+                                    g_param_spec_int("max-cache-entries",
+                                                     "Maximum cache entries",
+                                                     "Maximum number of property values to keep cached, or -1 for no limit",
+                                                     -1, G_MAXINT,
+                                                     BLCONF_CACHE_DEFAULT_MAX_ENTRIES,
+                                                     G_PARAM_READWRITE
+                                                     | G_PARAM_STATIC_NAME
+                                                     | G_PARAM_STATIC_NICK
+                                                     | G_PARAM_STATIC_BLURB));
+
+    /**
+     * BlconfChannel::max-cache-age:
+     *
+     * The time in seconds a cached property value can go unused before
+     * it's dropped, or 0 to keep values until the channel goes away.
+     * The same values as for #BlconfChannel:max-cache-entries are never
+     * dropped.  Properties remembered not to exist are forgotten the
+     * same way.
+     *
+     * Since: 4.13.0
+     **/
+    g_object_class_install_property(object_class, PROP_MAX_CACHE_AGE,
+                                    g_param_spec_int("max-cache-age",
+                                                     "Maximum cache age",
+                                                     "Maximum time in seconds a cached property value can go unused, or 0 for no limit",
+                                                     0, G_MAXINT,
+                                                     BLCONF_CACHE_DEFAULT_MAX_AGE,
+                                                     G_PARAM_READWRITE
+                                                     | G_PARAM_STATIC_NAME
+                                                     | G_PARAM_STATIC_NICK
+                                                     | G_PARAM_STATIC_BLURB));
 }
 
 static void
@@ -290,6 +345,15 @@ blconf_channel_set_g_property(GObject *object,
             channel->is_singleton = g_value_get_boolean(value);
             break;
 
+        case PROP_MAX_CACHE_ENTRIES:
+            blconf_cache_set_max_entries(channel->cache,
+                                         g_value_get_int(value));
+            break;
+
+        case PROP_MAX_CACHE_AGE:
+            blconf_cache_set_max_age(channel->cache, g_value_get_int(value));
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -315,6 +379,15 @@ blconf_channel_get_g_property(GObject *object,
 
         case PROP_IS_SINGLETON:
             g_value_set_boolean(value, channel->is_singleton);
+            break;
+
+        case PROP_MAX_CACHE_ENTRIES:
+            g_value_set_int(value, blconf_cache_get_max_entries(channel->cache));
+            break;
+
+        case PROP_MAX_CACHE_AGE:
+            g_value_set_int(value, blconf_cache_get_max_age(channel->cache));
+            break;
 
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
@@ -366,6 +439,36 @@ _blconf_channel_shutdown(void)
     G_UNLOCK(__singletons);
 }
 
+/* keeps the value of |property| cached while it's bound to an object
+ * property */
+void
+_blconf_channel_pin_property(BlconfChannel *channel,
+                             const gchar *property)
+{
+    gchar *real_property = REAL_PROP(channel, property);
+
+    blconf_cache_pin(channel->cache, real_property);
+
+    if(real_property != property)
+        g_free(real_property);
+}
+
+void
+_blconf_channel_unpin_property(BlconfChannel *channel,
+                               const gchar *property)
+{
+    gchar *real_property;
+
+    /* the cache is gone, and with it the pins */
+    if(channel->disposed)
+        return;
+
+    real_property = REAL_PROP(channel, property);
+    blconf_cache_unpin(channel->cache, real_property);
+    if(real_property != property)
+        g_free(real_property);
+}
+
 
 static void
 blconf_channel_property_changed(BlconfCache *cache,
@@ -536,6 +639,51 @@ blconf_transform_array(GPtrArray *arr_src,
     return arr_dest;
 }
 
+/* stores |src| in |value|, converting it if |value| is initialised to
+ * a different type, the way blconf_channel_get_property() documents */
+static gboolean
+blconf_channel_convert_value(const gchar *property,
+                             const GValue *src,
+                             GValue *value)
+{
+    gboolean ret = TRUE;
+
+    if(G_VALUE_TYPE(value) != G_TYPE_INVALID
+       && G_VALUE_TYPE(value) != G_VALUE_TYPE(src))
+    {
+        /* caller wants to convert the returned value into a diff type */
+
+        if(G_VALUE_TYPE(src) == BLCONF_TYPE_G_VALUE_ARRAY) {
+            /* we got an array back, so let's convert each item in
+             * the array to the target type */
+            GPtrArray *arr = blconf_transform_array(g_value_get_boxed(src),
+                                                    G_VALUE_TYPE(value));
+
+            if(arr) {
+                g_value_unset(value);
+                g_value_init(value, BLCONF_TYPE_G_VALUE_ARRAY);
+                g_value_take_boxed(value, arr);
+            } else
+                ret = FALSE;
+        } else {
+            ret = g_value_transform(src, value);
+            if(!ret) {
+                g_warning("Unable to convert property \"%s\" from type \"%s\" to type \"%s\"",
+                          property, G_VALUE_TYPE_NAME(src),
+                          G_VALUE_TYPE_NAME(value));
+            }
+        }
+    } else {
+        /* either the caller wants the native type, or specified the
+         * native type to convert to */
+        if(G_VALUE_TYPE(value) == G_VALUE_TYPE(src))
+            g_value_unset(value);
+        g_value_copy(src, g_value_init(value, G_VALUE_TYPE(src)));
+    }
+
+    return ret;
+}
+
 
 
 /**
@@ -723,6 +871,60 @@ blconf_channel_reset_property(BlconfChannel *channel,
         g_free(real_property_base);
 }
 
+/**
+ * blconf_channel_begin_batch:
+ * @channel: An #BlconfChannel.
+ *
+ * Starts collecting property changes on @channel instead of sending
+ * each one to the configuration store right away.  The new values are
+ * visible through @channel (and #BlconfChannel::property-changed is
+ * emitted) immediately, but nobody else sees them until
+ * blconf_channel_commit_batch() is called.
+ *
+ * Batches can be nested; only the outermost commit sends the changes.
+ * Resets are not part of the batch and happen immediately.
+ *
+ * Since: 4.13.0
+ **/
+void
+blconf_channel_begin_batch(BlconfChannel *channel)
+{
+    g_return_if_fail(BLCONF_IS_CHANNEL(channel));
+
+    blconf_cache_begin_batch(channel->cache);
+}
+
+/**
+ * blconf_channel_commit_batch:
+ * @channel: An #BlconfChannel.
+ *
+ * Ends a batch started with blconf_channel_begin_batch().  If this ends
+ * the outermost batch, all the properties set since then are sent to the
+ * configuration store in one call, and other clients are notified of all
+ * of them at once.  Either all of them are set, or, if any of them can't
+ * be (because it's locked, for example), none are, and the properties on
+ * @channel go back to their previous values.
+ *
+ * Returns: %TRUE if the properties were set successfully, %FALSE
+ *          otherwise.
+ *
+ * Since: 4.13.0
+ **/
+gboolean
+blconf_channel_commit_batch(BlconfChannel *channel)
+{
+    gboolean ret;
+    ERROR_DEFINE;
+
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel), FALSE);
+
+    ret = blconf_cache_commit_batch(channel->cache, ERROR);
+    if(!ret)
+        ERROR_CHECK;
+
+    return ret;
+}
+
 /**
  * blconf_channel_get_properties:
  * @channel: An #BlconfChannel.
@@ -773,6 +975,452 @@ blconf_channel_get_properties(BlconfChannel *channel,
     return properties;
 }
 
+/**
+ * blconf_channel_get_many:
+ * @channel: An #BlconfChannel.
+ * @properties: A %NULL-terminated array of property names.
+ *
+ * Retrieves the values of all of @properties from @channel.  This is
+ * the same as calling blconf_channel_get_property() for each of them,
+ * except that all the values that aren't cached yet are fetched from
+ * the configuration store at once.  Use it when starting up to read
+ * the properties you need in one go.
+ *
+ * Returns: A newly-allocated #GHashTable, with the property names as
+ *          keys and #GValue<!-- -->s as values, which should be freed
+ *          with g_hash_table_destroy() when no longer needed.  Properties
+ *          that don't exist are not in the table.
+ *
+ * Since: 4.13.0
+ **/
+GHashTable *
+blconf_channel_get_many(BlconfChannel *channel,
+                        const gchar * const *properties)
+{
+    GHashTable *result;
+    gchar **real_properties;
+    GValue *values;
+    guint i, n_properties;
+    ERROR_DEFINE;
+
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && properties, NULL);
+
+    n_properties = g_strv_length((gchar **)properties);
+    real_properties = g_new0(gchar *, n_properties + 1);
+    for(i = 0; i < n_properties; ++i)
+        real_properties[i] = REAL_PROP(channel, properties[i]);
+
+    values = g_new0(GValue, n_properties);
+    if(!blconf_cache_lookup_many(channel->cache,
+                                 (const gchar * const *)real_properties,
+                                 values, ERROR))
+    {
+        ERROR_CHECK;
+    }
+
+    result = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                   (GDestroyNotify)g_free,
+                                   (GDestroyNotify)_blconf_gvalue_free);
+    for(i = 0; i < n_properties; ++i) {
+        if(G_IS_VALUE(&values[i])) {
+            GValue *value = g_new0(GValue, 1);
+
+            /* hand the contents over as-is */
+            *value = values[i];
+            g_hash_table_replace(result, g_strdup(properties[i]), value);
+        }
+
+        if(real_properties[i] != properties[i])
+            g_free(real_properties[i]);
+    }
+
+    g_free(values);
+    g_free(real_properties);
+
+    return result;
+}
+
+/* an asynchronous read; the task data of its GTask */
+typedef struct
+{
+    gchar *property;       /* as the caller named it */
+    gboolean all;          /* blconf_channel_get_properties_async() */
+    gboolean exists_only;  /* blconf_channel_has_property_async() */
+    gulong cancelled_id;
+} BlconfChannelRead;
+
+static void
+blconf_channel_read_free(BlconfChannelRead *read)
+{
+    g_free(read->property);
+    g_slice_free(BlconfChannelRead, read);
+}
+
+static void
+blconf_channel_read_copy_ht(gpointer key,
+                            gpointer value,
+                            gpointer user_data)
+{
+    GValue *value_copy = g_new0(GValue, 1);
+
+    g_value_init(value_copy, G_VALUE_TYPE(value));
+    g_value_copy(value, value_copy);
+    g_hash_table_insert(user_data, g_strdup(key), value_copy);
+}
+
+static void
+blconf_channel_read_fetched(BlconfCache *cache,
+                            gconstpointer result,
+                            const GError *error,
+                            gpointer user_data)
+{
+    GTask *task = user_data;
+    BlconfChannelRead *read = g_task_get_task_data(task);
+
+    if(read->cancelled_id) {
+        g_cancellable_disconnect(g_task_get_cancellable(task),
+                                 read->cancelled_id);
+        read->cancelled_id = 0;
+    }
+
+    if(error)
+        g_task_return_error(task, g_error_copy(error));
+    else if(read->all) {
+        GHashTable *properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                       (GDestroyNotify)g_free,
+                                                       (GDestroyNotify)_blconf_gvalue_free);
+
+        g_hash_table_foreach((GHashTable *)result,
+                             blconf_channel_read_copy_ht, properties);
+        g_task_return_pointer(task, properties,
+                              (GDestroyNotify)g_hash_table_destroy);
+    } else if(read->exists_only)
+        g_task_return_boolean(task, result != NULL);
+    else if(result) {
+        GValue *value = g_new0(GValue, 1);
+
+        g_value_init(value, G_VALUE_TYPE(result));
+        g_value_copy(result, value);
+        g_task_return_pointer(task, value,
+                              (GDestroyNotify)_blconf_gvalue_free);
+    } else {
+        BlconfChannel *channel = g_task_get_source_object(task);
+
+        g_task_return_new_error(task, BLCONF_ERROR,
+                                BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                                _("Property \"%s\" does not exist on channel \"%s\""),
+                                read->property, channel->channel_name);
+    }
+
+    /* drop the fetch's reference */
+    g_object_unref(task);
+}
+
+static gboolean
+blconf_channel_read_cancel_idled(gpointer user_data)
+{
+    GTask *task = user_data;
+    BlconfChannel *channel = g_task_get_source_object(task);
+    BlconfChannelRead *read = g_task_get_task_data(task);
+
+    /* if the reply is already being handled, it'll return the
+     * cancellation error for us */
+    if(blconf_cache_fetch_abandon(channel->cache,
+                                  blconf_channel_read_fetched, task))
+    {
+        g_cancellable_disconnect(g_task_get_cancellable(task),
+                                 read->cancelled_id);
+        read->cancelled_id = 0;
+        g_task_return_error_if_cancelled(task);
+        g_object_unref(task);
+    }
+
+    return FALSE;
+}
+
+static void
+blconf_channel_read_cancelled(GCancellable *cancellable,
+                              gpointer user_data)
+{
+    GSource *source;
+
+    /* this can run in any thread, and we can't disconnect from
+     * the cancellable in here, so finish up in the task's context */
+    source = g_idle_source_new();
+    g_source_set_callback(source, blconf_channel_read_cancel_idled,
+                          g_object_ref(user_data), g_object_unref);
+    g_source_attach(source, g_task_get_context(user_data));
+    g_source_unref(source);
+}
+
+static void
+blconf_channel_read_start(BlconfChannel *channel,
+                          const gchar *real_property,
+                          BlconfChannelRead *read,
+                          GCancellable *cancellable,
+                          GAsyncReadyCallback callback,
+                          gpointer user_data,
+                          gpointer source_tag)
+{
+    GTask *task;
+
+    task = g_task_new(channel, cancellable, callback, user_data);
+    g_task_set_source_tag(task, source_tag);
+    g_task_set_task_data(task, read, (GDestroyNotify)blconf_channel_read_free);
+
+    if(!g_task_return_error_if_cancelled(task)) {
+        if(cancellable) {
+            read->cancelled_id = g_cancellable_connect(cancellable,
+                                                       G_CALLBACK(blconf_channel_read_cancelled),
+                                                       task, NULL);
+        }
+
+        /* the fetch keeps a reference until it's done or abandoned */
+        g_object_ref(task);
+        if(read->all) {
+            blconf_cache_fetch_all(channel->cache, real_property,
+                                   blconf_channel_read_fetched, task);
+        } else {
+            blconf_cache_fetch(channel->cache, real_property,
+                               blconf_channel_read_fetched, task);
+        }
+    }
+
+    g_object_unref(task);
+}
+
+/**
+ * blconf_channel_get_property_async:
+ * @channel: An #BlconfChannel.
+ * @property: A string property name.
+ * @cancellable: (allow-none): A #GCancellable, or %NULL.
+ * @callback: A #GAsyncReadyCallback to call when the value is available.
+ * @user_data: Data to pass to @callback.
+ *
+ * Asynchronously gets a property on @channel.  If the property is cached,
+ * @callback is called from the next main loop iteration; otherwise the
+ * value is fetched from the configuration store without blocking.  All
+ * reads of the same property that miss the cache at the same time are
+ * served by a single request.
+ *
+ * When the value is available, @callback is called in the thread-default
+ * main context of the thread this function was called from.  It should
+ * then call blconf_channel_get_property_finish() to get the value.
+ *
+ * Since: 4.13.0
+ **/
+void
+blconf_channel_get_property_async(BlconfChannel *channel,
+                                  const gchar *property,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data)
+{
+    BlconfChannelRead *read;
+    gchar *real_property;
+
+    g_return_if_fail(BLCONF_IS_CHANNEL(channel) && property);
+    g_return_if_fail(!cancellable || G_IS_CANCELLABLE(cancellable));
+
+    read = g_slice_new0(BlconfChannelRead);
+    read->property = g_strdup(property);
+
+    real_property = REAL_PROP(channel, property);
+    blconf_channel_read_start(channel, real_property, read,
+                              cancellable, callback, user_data,
+                              blconf_channel_get_property_async);
+    if(real_property != property)
+        g_free(real_property);
+}
+
+/**
+ * blconf_channel_get_property_finish:
+ * @channel: An #BlconfChannel.
+ * @result: The #GAsyncResult passed to the callback.
+ * @value: A #GValue.
+ * @error: (allow-none): Return location for a #GError, or %NULL.
+ *
+ * Finishes a read started with blconf_channel_get_property_async(), and
+ * stores the value in @value, converting it like
+ * blconf_channel_get_property() does.  If the property doesn't exist,
+ * @error is set to %BLCONF_ERROR_PROPERTY_NOT_FOUND; if the read was
+ * cancelled, to %G_IO_ERROR_CANCELLED.
+ *
+ * Returns: %TRUE if the property was retrieved successfully,
+ *          %FALSE otherwise.
+ *
+ * Since: 4.13.0
+ **/
+gboolean
+blconf_channel_get_property_finish(BlconfChannel *channel,
+                                   GAsyncResult *result,
+                                   GValue *value,
+                                   GError **error)
+{
+    BlconfChannelRead *read;
+    GValue *val;
+    gboolean ret;
+
+    g_return_val_if_fail(g_task_is_valid(result, channel) && value, FALSE);
+    g_return_val_if_fail(g_task_get_source_tag(G_TASK(result))
+                         == blconf_channel_get_property_async, FALSE);
+
+    val = g_task_propagate_pointer(G_TASK(result), error);
+    if(!val)
+        return FALSE;
+
+    read = g_task_get_task_data(G_TASK(result));
+    ret = blconf_channel_convert_value(read->property, val, value);
+    if(!ret && error) {
+        g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_UNKNOWN,
+                    _("Unable to convert property \"%s\" from type \"%s\" to type \"%s\""),
+                    read->property, G_VALUE_TYPE_NAME(val),
+                    G_VALUE_TYPE_NAME(value));
+    }
+    _blconf_gvalue_free(val);
+
+    return ret;
+}
+
+/**
+ * blconf_channel_has_property_async:
+ * @channel: An #BlconfChannel.
+ * @property: A property name.
+ * @cancellable: (allow-none): A #GCancellable, or %NULL.
+ * @callback: A #GAsyncReadyCallback to call when the answer is available.
+ * @user_data: Data to pass to @callback.
+ *
+ * Asynchronously checks to see if @property exists on @channel.  This
+ * shares requests with blconf_channel_get_property_async().  @callback
+ * should call blconf_channel_has_property_finish() to get the result.
+ *
+ * Since: 4.13.0
+ **/
+void
+blconf_channel_has_property_async(BlconfChannel *channel,
+                                  const gchar *property,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data)
+{
+    BlconfChannelRead *read;
+    gchar *real_property;
+
+    g_return_if_fail(BLCONF_IS_CHANNEL(channel) && property);
+    g_return_if_fail(!cancellable || G_IS_CANCELLABLE(cancellable));
+
+    read = g_slice_new0(BlconfChannelRead);
+    read->property = g_strdup(property);
+    read->exists_only = TRUE;
+
+    real_property = REAL_PROP(channel, property);
+    blconf_channel_read_start(channel, real_property, read,
+                              cancellable, callback, user_data,
+                              blconf_channel_has_property_async);
+    if(real_property != property)
+        g_free(real_property);
+}
+
+/**
+ * blconf_channel_has_property_finish:
+ * @channel: An #BlconfChannel.
+ * @result: The #GAsyncResult passed to the callback.
+ * @error: (allow-none): Return location for a #GError, or %NULL.
+ *
+ * Finishes a check started with blconf_channel_has_property_async().
+ *
+ * Returns: %TRUE if the property exists, %FALSE if it doesn't or if
+ *          @error is set.
+ *
+ * Since: 4.13.0
+ **/
+gboolean
+blconf_channel_has_property_finish(BlconfChannel *channel,
+                                   GAsyncResult *result,
+                                   GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, channel), FALSE);
+    g_return_val_if_fail(g_task_get_source_tag(G_TASK(result))
+                         == blconf_channel_has_property_async, FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/**
+ * blconf_channel_get_properties_async:
+ * @channel: An #BlconfChannel.
+ * @property_base: The base property name of properties to retrieve.
+ * @cancellable: (allow-none): A #GCancellable, or %NULL.
+ * @callback: A #GAsyncReadyCallback to call when the properties are
+ *            available.
+ * @user_data: Data to pass to @callback.
+ *
+ * Asynchronous version of blconf_channel_get_properties().  Concurrent
+ * calls for the same @property_base are served by a single request.
+ * @callback should call blconf_channel_get_properties_finish() to get
+ * the properties.
+ *
+ * Since: 4.13.0
+ **/
+void
+blconf_channel_get_properties_async(BlconfChannel *channel,
+                                    const gchar *property_base,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data)
+{
+    BlconfChannelRead *read;
+    gchar *real_property_base;
+
+    g_return_if_fail(BLCONF_IS_CHANNEL(channel));
+    g_return_if_fail(!cancellable || G_IS_CANCELLABLE(cancellable));
+
+    if(!property_base || (property_base[0] == '/' && !property_base[1]))
+        real_property_base = channel->property_base;
+    else
+        real_property_base = REAL_PROP(channel, property_base);
+
+    read = g_slice_new0(BlconfChannelRead);
+    read->property = g_strdup(property_base);
+    read->all = TRUE;
+
+    blconf_channel_read_start(channel, real_property_base, read,
+                              cancellable, callback, user_data,
+                              blconf_channel_get_properties_async);
+
+    if(real_property_base != property_base
+       && real_property_base != channel->property_base)
+    {
+        g_free(real_property_base);
+    }
+}
+
+/**
+ * blconf_channel_get_properties_finish:
+ * @channel: An #BlconfChannel.
+ * @result: The #GAsyncResult passed to the callback.
+ * @error: (allow-none): Return location for a #GError, or %NULL.
+ *
+ * Finishes a read started with blconf_channel_get_properties_async().
+ *
+ * Returns: A newly-allocated #GHashTable like the one
+ *          blconf_channel_get_properties() returns, or %NULL if @error
+ *          is set.
+ *
+ * Since: 4.13.0
+ **/
+GHashTable *
+blconf_channel_get_properties_finish(BlconfChannel *channel,
+                                     GAsyncResult *result,
+                                     GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, channel), NULL);
+    g_return_val_if_fail(g_task_get_source_tag(G_TASK(result))
+                         == blconf_channel_get_properties_async, NULL);
+
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
+
 /**
  * blconf_channel_get_string:
  * @channel: An #BlconfChannel.
@@ -1256,42 +1904,8 @@ blconf_channel_get_property(BlconfChannel *channel,
                          FALSE);
 
     ret = blconf_channel_get_internal(channel, property, &val1);
-
-    if(ret) {
-        if(G_VALUE_TYPE(value) != G_TYPE_INVALID
-           && G_VALUE_TYPE(value) != G_VALUE_TYPE(&val1))
-        {
-            /* caller wants to convert the returned value into a diff type */
-
-            if(G_VALUE_TYPE(&val1) == BLCONF_TYPE_G_VALUE_ARRAY) {
-                /* we got an array back, so let's convert each item in
-                 * the array to the target type */
-                GPtrArray *arr = blconf_transform_array(g_value_get_boxed(&val1),
-                                                        G_VALUE_TYPE(value));
-
-                if(arr) {
-                    g_value_unset(value);
-                    g_value_init(value, BLCONF_TYPE_G_VALUE_ARRAY);
-                    g_value_take_boxed(value, arr);
-                } else
-                    ret = FALSE;
-            } else {
-                ret = g_value_transform(&val1, value);
-                if(!ret) {
-                    g_warning("Unable to convert property \"%s\" from type \"%s\" to type \"%s\"",
-                              property, G_VALUE_TYPE_NAME(&val1),
-                              G_VALUE_TYPE_NAME(value));
-                }
-            }
-        } else {
-            /* either the caller wants the native type, or specified the
-             * native type to convert to */
-            if(G_VALUE_TYPE(value) == G_VALUE_TYPE(&val1))
-                g_value_unset(value);
-            g_value_copy(&val1, g_value_init(value, G_VALUE_TYPE(&val1)));
-            ret = TRUE;
-        }
-    }
+    if(ret)
+        ret = blconf_channel_convert_value(property, &val1, value);
 
     if(G_VALUE_TYPE(&val1))
         g_value_unset(&val1);
@@ -26,6 +26,7 @@
 #endif
 
 #include <glib-object.h>
+#include <gio/gio.h>
 
 #define BLCONF_TYPE_CHANNEL             (blconf_channel_get_type())
 #define BLCONF_CHANNEL(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), BLCONF_TYPE_CHANNEL, BlconfChannel))
@@ -57,9 +58,45 @@ void blconf_channel_reset_property(BlconfChannel *channel,
                                    const gchar *property_base,
                                    gboolean recursive);
 
+void blconf_channel_begin_batch(BlconfChannel *channel);
+gboolean blconf_channel_commit_batch(BlconfChannel *channel);
+
 GHashTable *blconf_channel_get_properties(BlconfChannel *channel,
                                           const gchar *property_base) G_GNUC_WARN_UNUSED_RESULT;
 
+GHashTable *blconf_channel_get_many(BlconfChannel *channel,
+                                    const gchar * const *properties) G_GNUC_WARN_UNUSED_RESULT;
+
+/* asynchronous reads */
+
+void blconf_channel_get_property_async(BlconfChannel *channel,
+                                       const gchar *property,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data);
+gboolean blconf_channel_get_property_finish(BlconfChannel *channel,
+                                            GAsyncResult *result,
+                                            GValue *value,
+                                            GError **error);
+
+void blconf_channel_has_property_async(BlconfChannel *channel,
+                                       const gchar *property,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data);
+gboolean blconf_channel_has_property_finish(BlconfChannel *channel,
+                                            GAsyncResult *result,
+                                            GError **error);
+
+void blconf_channel_get_properties_async(BlconfChannel *channel,
+                                         const gchar *property_base,
+                                         GCancellable *cancellable,
+                                         GAsyncReadyCallback callback,
+                                         gpointer user_data);
+GHashTable *blconf_channel_get_properties_finish(BlconfChannel *channel,
+                                                 GAsyncResult *result,
+                                                 GError **error) G_GNUC_WARN_UNUSED_RESULT;
+
 /* basic types */
 
 gchar *blconf_channel_get_string(BlconfChannel *channel,
@@ -192,14 +229,6 @@ gboolean blconf_channel_set_structv(BlconfChannel *channel,
                                     guint n_members,
                                     GType *member_types);
 
-#if 0  /* future (maybe) */
-
-//gboolean blconf_channel_begin_transaction(BlconfChannel *channel);
-//gboolean blconf_channel_commit_transaction(BlconfChannel *channel);
-//void blconf_channel_cancel_transaction(BlconfChannel *channel);
-
-#endif
-
 G_END_DECLS
 
 #endif  /* __BLCONF_CHANNEL_H__ */
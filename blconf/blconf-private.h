@@ -57,6 +57,10 @@ BlconfNamedStruct *_blconf_named_struct_lookup(const gchar *struct_name);
 void _blconf_channel_shutdown(void);
 const gchar *_blconf_channel_get_name(BlconfChannel *channel);
 const gchar *_blconf_channel_get_property_base(BlconfChannel *channel);
+void _blconf_channel_pin_property(BlconfChannel *channel,
+                                  const gchar *property);
+void _blconf_channel_unpin_property(BlconfChannel *channel,
+                                    const gchar *property);
 
 void _blconf_g_bindings_shutdown(void);
 
@@ -32,6 +32,7 @@
 
 #include "blconf.h"
 #include "common/blconf-marshal.h"
+#include "common/blconf-common-private.h"
 #include "blconf-private.h"
 #include "common/blconf-alias.h"
 
@@ -100,6 +101,12 @@ blconf_static_dbus_init(void)
                                           G_TYPE_STRING,
                                           G_TYPE_STRING,
                                           G_TYPE_INVALID);
+        dbus_g_object_register_marshaller(_blconf_marshal_VOID__STRING_BOXED_BOXED,
+                                          G_TYPE_NONE,
+                                          G_TYPE_STRING,
+                                          BLCONF_TYPE_G_STRING_VALUE_HASHTABLE,
+                                          G_TYPE_STRV,
+                                          G_TYPE_INVALID);
 
         static_dbus_inited = TRUE;
     }
@@ -148,6 +155,11 @@ blconf_init(GError **error)
     dbus_g_proxy_add_signal(dbus_proxy, "PropertyRemoved",
                             G_TYPE_STRING, G_TYPE_STRING,
                             G_TYPE_INVALID);
+    dbus_g_proxy_add_signal(dbus_proxy, "PropertiesChanged",
+                            G_TYPE_STRING,
+                            BLCONF_TYPE_G_STRING_VALUE_HASHTABLE,
+                            G_TYPE_STRV,
+                            G_TYPE_INVALID);
 
     ++blconf_refcnt;
     return TRUE;
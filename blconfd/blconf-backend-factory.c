@@ -21,10 +21,15 @@
 #include <config.h>
 #endif
 
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
 #include <libbladeutil/libbladeutil.h>
 
 #include "blconf-backend-factory.h"
 #include "blconf-backend.h"
+#include "common/blconf-gvaluefuncs.h"
 
 /* i'm not sure i like this method.  perhaps each backend could be a
  * GTypeModule.  i also want the ability to multiplex multiple backends.
@@ -38,6 +43,7 @@
 #endif
 
 static GHashTable *backends = NULL;
+static gchar **backend_options = NULL;
 
 static void
 blconf_backend_factory_ensure_backends(void)
@@ -59,6 +65,61 @@ blconf_backend_factory_ensure_backends(void)
 #endif
 }
 
+/* applies the NAME=VALUE options given on the command line to the
+ * backend's GObject properties.  options the backend doesn't know about
+ * are skipped, as they may be meant for another backend. */
+static gboolean
+blconf_backend_factory_apply_options(BlconfBackend *backend,
+                                     GError **error)
+{
+    GObjectClass *klass = G_OBJECT_GET_CLASS(backend);
+    gint i;
+
+    for(i = 0; backend_options && backend_options[i]; ++i) {
+        gchar *name = g_strdup(backend_options[i]);
+        gchar *str_value = strchr(name, '=');
+        GParamSpec *pspec;
+        GValue value = { 0, };
+
+        if(str_value)
+            *str_value++ = 0;
+
+        pspec = g_object_class_find_property(klass, name);
+        if(!pspec || !(pspec->flags & G_PARAM_WRITABLE)) {
+            DBG("backend %s has no option \"%s\"",
+                G_OBJECT_TYPE_NAME(backend), name);
+            g_free(name);
+            continue;
+        }
+
+        g_value_init(&value, G_PARAM_SPEC_VALUE_TYPE(pspec));
+        if(!str_value || !_blconf_gvalue_from_string(&value, str_value)) {
+            if(error) {
+                g_set_error(error, BLCONF_ERROR, 0,
+                            _("Invalid value for backend option \"%s\""),
+                            name);
+            }
+            g_value_unset(&value);
+            g_free(name);
+            return FALSE;
+        }
+
+        g_object_set_property(G_OBJECT(backend), name, &value);
+
+        g_value_unset(&value);
+        g_free(name);
+    }
+
+    return TRUE;
+}
+
+
+void
+blconf_backend_factory_set_options(gchar **options)
+{
+    g_strfreev(backend_options);
+    backend_options = g_strdupv(options);
+}
 
 BlconfBackend *
 blconf_backend_factory_get_backend(const gchar *type,
@@ -80,7 +141,9 @@ blconf_backend_factory_get_backend(const gchar *type,
     }
     
     backend = g_object_new(*backend_gtype, NULL);
-    if(!blconf_backend_initialize(backend, error)) {
+    if(!blconf_backend_factory_apply_options(backend, error)
+       || !blconf_backend_initialize(backend, error))
+    {
         g_object_unref(G_OBJECT(backend));
         return NULL;
     }
@@ -96,4 +159,7 @@ blconf_backend_factory_cleanup (void)
       g_hash_table_destroy(backends);
       backends = NULL;
   }
+
+  g_strfreev(backend_options);
+  backend_options = NULL;
 }
@@ -26,6 +26,8 @@
 
 G_BEGIN_DECLS
 
+void blconf_backend_factory_set_options(gchar **options);
+
 BlconfBackend *blconf_backend_factory_get_backend(const gchar *type,
                                                   GError **error);
 
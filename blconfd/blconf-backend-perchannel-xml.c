@@ -51,12 +51,17 @@
 #include <fcntl.h>
 #endif
 
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
 #include <libbladeutil/libbladeutil.h>
 #include <dbus/dbus-glib.h>
 
 #include "blconf-backend-perchannel-xml.h"
 #include "blconf-backend.h"
 #include "blconf-locking-utils.h"
+#include "blconf-string-pool.h"
 #include "common/blconf-gvaluefuncs.h"
 #include "blconf/blconf-types.h"
 #include "common/blconf-common-private.h"
@@ -69,18 +74,139 @@
 #define CONFIG_DIR_STEM  "xfce4/blconf/" BLCONF_BACKEND_PERCHANNEL_XML_TYPE_ID "/"
 #define CONFIG_FILE_FMT  CONFIG_DIR_STEM "%s.xml"
 #define CACHE_TIMEOUT    (20*60*1000)  /* 20 minutes */
-#define WRITE_TIMEOUT    (5)  /* 5 seconds */
+#define EVICT_INTERVAL   (60)  /* 1 minute */
+#define SAVE_DELAY_DEFAULT      (5*1000)  /* 5 seconds */
+#define MAX_SAVE_DELAY_DEFAULT  (30*1000)  /* 30 seconds */
 #define MAX_PROP_PATH    (4096)
 
+#define SNAPSHOT_FILE_FMT         "%s/%s.snapshot"
+#define SNAPSHOT_MAGIC            "BLCS"
+#define SNAPSHOT_VERSION          (2)
+#define SNAPSHOT_CHECKSUM_OFFSET  (8)
+#define SNAPSHOT_NULL_STRING      (G_MAXUINT32)
+#define SNAPSHOT_MAX_DEPTH        (MAX_PROP_PATH / 2)
+#define SNAPSHOT_CHANNEL_LOCKED   (1 << 0)
+#define SNAPSHOT_PROPERTY_LOCKED  (1 << 0)
+
+#define JOURNAL_FILE_FMT          "%s/%s.journal"
+#define JOURNAL_OLD_SUFFIX        ".old"
+#define JOURNAL_MAGIC             "BLCJ"
+#define JOURNAL_VERSION           (1)
+#define JOURNAL_HEADER_LEN        (8)
+#define JOURNAL_RECORD_HEADER_LEN (8)
+#define JOURNAL_COMPACT_SIZE      (64*1024)  /* 64 KiB */
+
+/* nodes with at least this many children get a name -> child index, so
+ * wide branches (panel plugins, keyboard shortcuts, ...) don't need a
+ * linear scan of their siblings on every lookup */
+#define PROPTREE_INDEX_MIN_CHILDREN  (8)
+
+/* property nodes are carved out of per-tree blocks of this size */
+#define PROPTREE_ARENA_BLOCK_SIZE  (4096)
+/* a tree is copied into a fresh arena once removed nodes take up more
+ * than this, and more than the live ones */
+#define PROPTREE_ARENA_COMPACT_MIN  (PROPTREE_ARENA_BLOCK_SIZE * 4)
+
+/* at most this many channel writes are handed to the writer thread at
+ * once; beyond that, we wait for the oldest one */
+#define WRITE_QUEUE_MAX  (8)
+
+/* editors tend to write files in several steps, so changes to the config
+ * directories are only acted upon once they've settled for this long */
+#define RELOAD_DELAY     (250)  /* milliseconds */
+
+/* channels used within this many seconds of startup are remembered, and
+ * read in ahead of time by PRELOAD_THREADS threads on the next start */
+#define PRELOAD_TIME_DEFAULT  (10)
+#define PRELOAD_THREADS       (4)
+#define PRELOAD_FILE_FMT      "%s/preload"
+
+/* the resolved files cache is simply dropped when it gets this big, so
+ * clients asking for lots of made-up channel names can't bloat it */
+#define RESOLVE_CACHE_MAX     (256)
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+#define blconf_backend_perchannel_xml_write_lock(xbpx)    g_mutex_lock (&(xbpx)->write_lock)
+#define blconf_backend_perchannel_xml_write_unlock(xbpx)  g_mutex_unlock (&(xbpx)->write_lock)
+#define blconf_backend_perchannel_xml_write_wait(xbpx)    g_cond_wait (&(xbpx)->write_cond, &(xbpx)->write_lock)
+#define blconf_backend_perchannel_xml_write_signal(xbpx)  g_cond_broadcast (&(xbpx)->write_cond)
+#else
+#define blconf_backend_perchannel_xml_write_lock(xbpx)    g_mutex_lock ((xbpx)->write_lock)
+#define blconf_backend_perchannel_xml_write_unlock(xbpx)  g_mutex_unlock ((xbpx)->write_lock)
+#define blconf_backend_perchannel_xml_write_wait(xbpx)    g_cond_wait ((xbpx)->write_cond, (xbpx)->write_lock)
+#define blconf_backend_perchannel_xml_write_signal(xbpx)  g_cond_broadcast ((xbpx)->write_cond)
+#endif
+
 struct _BlconfBackendPerchannelXml
 {
     GObject parent;
 
     gchar *config_save_path;
+    gchar *cache_save_path;
 
     GHashTable *channels;
 
-    guint save_id;
+    guint save_delay;
+    guint max_save_delay;
+
+    /* channel eviction; the timeout and budget are 0 for "never" */
+    guint cache_timeout;
+    guint64 memory_budget;
+    guint64 memory_usage;
+    guint64 n_idle_evictions;
+    guint64 n_budget_evictions;
+    guint evict_id;
+    guint evict_idle_id;
+
+    /* channel files are written, and journals synced, by a separate
+     * thread, so the main loop doesn't block on the disk.  |write_jobs|
+     * is only touched by the main thread; the jobs' results and
+     * |write_done_id| are protected by |write_lock|, as are those of the
+     * preload jobs below. */
+    GThread *writer;
+    GAsyncQueue *write_queue;
+    GSList *write_jobs;
+    guint n_write_jobs;
+    guint write_done_id;
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    GMutex write_lock;
+    GCond write_cond;
+#else
+    GMutex *write_lock;
+    GCond *write_cond;
+#endif
+
+    /* channels being read in by |preload_pool|, keyed by lowercased
+     * name; and the channels used so far during the first |preload_time|
+     * seconds (lowercased name -> name as requested) */
+    guint preload_time;
+    GThreadPool *preload_pool;
+    GHashTable *preloads;
+    guint preload_done_id;
+    GHashTable *preload_record;
+    guint preload_record_id;
+
+    /* channel name -> BlconfResolvedFiles; only kept while the config
+     * directories are monitored, as that's what invalidates it.  only
+     * used on the main thread; the preload threads get their files
+     * resolved up front. */
+    GHashTable *resolved;
+
+#ifdef HAVE_SYS_INOTIFY_H
+    /* watches on all config directories, and the names of the loaded
+     * channels whose files changed since the last reload */
+    gint inotify_fd;
+    guint inotify_watch_id;
+    GHashTable *watch_dirs;
+    GHashTable *reload_channels;
+    guint reload_id;
+
+    /* what ListChannels returns, as channel name -> number of files
+     * backing it, and those files (path -> channel name).  built on first
+     * use and then kept up to date by the monitor. */
+    GHashTable *registry;
+    GHashTable *registry_files;
+#endif
 
     BlconfPropertyChangedFunc prop_changed_func;
     gpointer prop_changed_data;
@@ -91,21 +217,190 @@ typedef struct _BlconfBackendPerchannelXmlClass
     GObjectClass parent;
 } BlconfBackendPerchannelXmlClass;
 
+typedef struct _BlconfWriteJob BlconfWriteJob;
+
 typedef struct
 {
+    BlconfBackendPerchannelXml *xbpx;
+    gchar *name;
+
     GNode *properties;
     gboolean locked;
     gboolean dirty;
+
+    /* pending save; monotonic times of the first and the latest change
+     * since the channel was last written out */
+    guint save_id;
+    gint64 dirty_since;
+    gint64 last_change;
+
+    /* changes not yet folded into the xml file are appended here */
+    gint journal_fd;
+    gsize journal_size;
+
+    /* for eviction: monotonic time of the last access, and a rough
+     * estimate of the memory held by the proptree */
+    gint64 last_used;
+    gsize mem_size;
+    gboolean mem_size_stale;
+
+    /* the files this channel was merged from (SnapshotSource), as they
+     * were when it was loaded; these key the on-disk snapshot */
+    GArray *sources;
+    /* the lock expressions evaluated while merging them: expression ->
+     * GINT_TO_POINTER(1) if the user matched, -1 if not.  a snapshot is
+     * only used if they all still come out the same */
+    GHashTable *lock_lists;
+    /* the snapshot to write once the channel was read from the xml files;
+     * handed to the writer thread by whoever takes the channel */
+    BlconfWriteJob *snapshot_job;
+
+    /* the write in progress, if any, and whether the channel changed
+     * again and needs another one once it completes */
+    BlconfWriteJob *write_job;
+    gboolean flush_pending;
+    /* the same for syncing the journal */
+    BlconfWriteJob *sync_job;
+    gboolean sync_pending;
 } BlconfChannel;
 
+/* a copy of everything needed to write out a channel, so the writer
+ * thread never looks at the live tree */
+struct _BlconfWriteJob
+{
+    BlconfChannel *channel;
+    gchar *channel_name;
+    gchar *filename;
+    gchar *snapshot_filename;
+    GNode *properties;
+    GArray *sources;
+    GHashTable *lock_lists;
+    gboolean locked;
+    /* set for jobs that only sync the journal, on a descriptor of their
+     * own that the writer closes */
+    gboolean journal_sync;
+    gint journal_fd;
+
+    /* filled in by the writer thread */
+    gboolean done;
+    gboolean success;
+    GError *error;
+};
+
+/* pushed to tell the writer thread to exit */
+static BlconfWriteJob writer_quit_job;
+
+/* where a channel's files are, as found by xfce_resource_*() */
 typedef struct
 {
-    gchar *name;
+    gchar **filenames;
+    gchar *user_file;
+    /* there's no file at all for the channel, not even a journal */
+    gboolean missing;
+} BlconfResolvedFiles;
+
+typedef struct
+{
+    gchar *channel_name;
+    /* resolved on the main thread before the job is queued */
+    gboolean found;
+    gchar **filenames;
+    gchar *user_file;
+
+    /* filled in by the preload thread */
+    gboolean done;
+    BlconfChannel *channel;
+} BlconfPreloadJob;
+
+typedef struct
+{
+    gchar *path;
+    gint64 mtime;  /* in ns */
+    gint64 size;  /* -1 if the file doesn't exist */
+    guint64 inode;
+} SnapshotSource;
+
+/* type tags for values in the binary snapshot; never renumber these
+ * without bumping SNAPSHOT_VERSION */
+typedef enum
+{
+    SNAPSHOT_TYPE_NONE = 0,
+    SNAPSHOT_TYPE_STRING,
+    SNAPSHOT_TYPE_UCHAR,
+    SNAPSHOT_TYPE_CHAR,
+    SNAPSHOT_TYPE_UINT16,
+    SNAPSHOT_TYPE_INT16,
+    SNAPSHOT_TYPE_UINT,
+    SNAPSHOT_TYPE_INT,
+    SNAPSHOT_TYPE_UINT64,
+    SNAPSHOT_TYPE_INT64,
+    SNAPSHOT_TYPE_FLOAT,
+    SNAPSHOT_TYPE_DOUBLE,
+    SNAPSHOT_TYPE_BOOLEAN,
+    SNAPSHOT_TYPE_ARRAY,
+} SnapshotValueType;
+
+typedef struct
+{
+    const gchar *p;
+    const gchar *end;
+} SnapshotReader;
+
+typedef enum
+{
+    JOURNAL_OP_SET = 'S',
+    JOURNAL_OP_RESET = 'R',
+    JOURNAL_OP_RESET_RECURSIVE = 'T',
+} JournalOp;
+
+/* a property and its tree node live in a single allocation: the GNode is
+ * embedded, with node.data pointing back at the property.  nodes are
+ * allocated from the tree's arena (see BlconfProptreeArena) with
+ * blconf_proptree_node_new(), and are never freed one by one: use
+ * blconf_proptree_remove() and blconf_proptree_destroy(), never
+ * g_node_new() or g_node_destroy().
+ *
+ * names come from the string pool, so siblings can be told apart by
+ * pointer; so do top-level string values (see
+ * blconf_property_value_pool()). */
+typedef struct
+{
+    GNode node;
+    const gchar *name;
+
     GValue value;
-    GValue system_value;
+    /* only allocated when a system file sets a value; most properties
+     * don't have one */
+    GValue *system_value;
+
+    /* child GNodes keyed by their name; only created for wide nodes.
+     * the GNode child list still defines the (file) order */
+    GHashTable *children;
+
     gboolean locked;
 } BlconfProperty;
 
+/* the allocator behind a property tree.  it sits right in front of the
+ * root node, so it travels with the tree when the tree is handed from
+ * one channel to another.  blocks are only ever released all at once,
+ * when the whole tree is destroyed. */
+typedef struct
+{
+    GSList *blocks;
+    gchar *pos;
+    gsize left;
+
+    gsize used;  /* bytes handed out to nodes */
+    gsize dead;  /* bytes of nodes removed from the tree since */
+} BlconfProptreeArena;
+
+#define PROPTREE_ARENA_HEADER_SIZE \
+    ((sizeof(BlconfProptreeArena) + G_MEM_ALIGN - 1) & ~(gsize)(G_MEM_ALIGN - 1))
+#define PROPTREE_ARENA(proptree) \
+    ((BlconfProptreeArena *)((gchar *)(proptree)->data - PROPTREE_ARENA_HEADER_SIZE))
+#define PROPTREE_NODE_SIZE \
+    ((sizeof(BlconfProperty) + G_MEM_ALIGN - 1) & ~(gsize)(G_MEM_ALIGN - 1))
+
 typedef enum
 {
     ELEM_NONE = 0,
@@ -130,6 +425,27 @@ typedef struct
     GValue *list_value;
 } XmlParserState;
 
+enum
+{
+    PROP0 = 0,
+    PROP_SAVE_DELAY,
+    PROP_MAX_SAVE_DELAY,
+    PROP_CACHE_TIMEOUT,
+    PROP_MEMORY_BUDGET,
+    PROP_MEMORY_USAGE,
+    PROP_IDLE_EVICTIONS,
+    PROP_BUDGET_EVICTIONS,
+    PROP_PRELOAD_TIME,
+};
+
+static void blconf_backend_perchannel_xml_set_g_property(GObject *object,
+                                                         guint property_id,
+                                                         const GValue *value,
+                                                         GParamSpec *pspec);
+static void blconf_backend_perchannel_xml_get_g_property(GObject *object,
+                                                         guint property_id,
+                                                         GValue *value,
+                                                         GParamSpec *pspec);
 static void blconf_backend_perchannel_xml_finalize(GObject *obj);
 
 static void blconf_backend_perchannel_xml_backend_init(BlconfBackendInterface *iface);
@@ -141,11 +457,21 @@ static gboolean blconf_backend_perchannel_xml_set(BlconfBackend *backend,
                                                   const gchar *property,
                                                   const GValue *value,
                                                   GError **error);
+static gboolean blconf_backend_perchannel_xml_set_many(BlconfBackend *backend,
+                                                       const gchar *channel_name,
+                                                       GHashTable *properties,
+                                                       GError **error);
 static gboolean blconf_backend_perchannel_xml_get(BlconfBackend *backend,
                                                   const gchar *channel_name,
                                                   const gchar *property,
                                                   GValue *value,
                                                   GError **error);
+static gboolean blconf_backend_perchannel_xml_get_all_foreach(BlconfBackend *backend,
+                                                             const gchar *channel_name,
+                                                             const gchar *property_base,
+                                                             BlconfPropertyVisitFunc func,
+                                                             gpointer user_data,
+                                                             GError **error);
 static gboolean blconf_backend_perchannel_xml_get_all(BlconfBackend *backend,
                                                       const gchar *channel_name,
                                                       const gchar *property_base,
@@ -161,6 +487,21 @@ static gboolean blconf_backend_perchannel_xml_reset(BlconfBackend *backend,
                                                     const gchar *property,
                                                     gboolean recursive,
                                                     GError **error);
+static gboolean blconf_backend_perchannel_xml_get_many(BlconfBackend *backend,
+                                                       const gchar *channel_name,
+                                                       const gchar * const *properties,
+                                                       GHashTable *values,
+                                                       GError **error);
+static gboolean blconf_backend_perchannel_xml_reset_many(BlconfBackend *backend,
+                                                         const gchar *channel_name,
+                                                         const gchar * const *properties,
+                                                         gboolean recursive,
+                                                         GError **error);
+static gboolean blconf_backend_perchannel_xml_can_reset(BlconfBackend *backend,
+                                                        const gchar *channel_name,
+                                                        const gchar *property,
+                                                        gboolean recursive,
+                                                        GError **error);
 static gboolean blconf_backend_perchannel_xml_list_channels(BlconfBackend *backend,
                                                             GSList **channels,
                                                             GError **error);
@@ -178,15 +519,79 @@ static void blconf_backend_perchannel_xml_register_property_changed_func(BlconfB
 static void blconf_backend_perchannel_xml_schedule_save(BlconfBackendPerchannelXml *xbpx,
                                                         BlconfChannel *channel);
 
+static void blconf_backend_perchannel_xml_insert_channel(BlconfBackendPerchannelXml *xbpx,
+                                                         const gchar *channel_name,
+                                                         BlconfChannel *channel);
+static BlconfChannel *blconf_backend_perchannel_xml_lookup_channel(BlconfBackendPerchannelXml *xbpx,
+                                                                   const gchar *channel_name);
 static BlconfChannel *blconf_backend_perchannel_xml_create_channel(BlconfBackendPerchannelXml *xbpx,
                                                                    const gchar *channel_name);
 static BlconfChannel *blconf_backend_perchannel_xml_load_channel(BlconfBackendPerchannelXml *xbpx,
                                                                  const gchar *channel_name,
                                                                  GError **error);
-static gboolean blconf_backend_perchannel_xml_flush_channel(BlconfBackendPerchannelXml *xbpx,
+static void blconf_backend_perchannel_xml_flush_channel(BlconfBackendPerchannelXml *xbpx,
+                                                        BlconfChannel *channel);
+static BlconfChannel *blconf_backend_perchannel_xml_read_channel(BlconfBackendPerchannelXml *xbpx,
+                                                                 const gchar *channel_name,
+                                                                 GError **error);
+static gboolean blconf_backend_perchannel_xml_resolve_files(BlconfBackendPerchannelXml *xbpx,
                                                             const gchar *channel_name,
-                                                            GError **error);
+                                                            gchar ***filenames,
+                                                            gchar **user_file);
+static void blconf_backend_perchannel_xml_invalidate_resolved(BlconfBackendPerchannelXml *xbpx,
+                                                              const gchar *channel_name);
+static void blconf_backend_perchannel_xml_registry_update(BlconfBackendPerchannelXml *xbpx,
+                                                          const gchar *channel_name,
+                                                          const gchar *suffix,
+                                                          gboolean added);
+#ifdef HAVE_SYS_INOTIFY_H
+static void blconf_backend_perchannel_xml_watch_dirs(BlconfBackendPerchannelXml *xbpx);
+#endif
 
+static void blconf_backend_perchannel_xml_start_preload(BlconfBackendPerchannelXml *xbpx);
+static BlconfChannel *blconf_backend_perchannel_xml_take_preload(BlconfBackendPerchannelXml *xbpx,
+                                                                 const gchar *channel_name);
+static void blconf_backend_perchannel_xml_preload_record(BlconfBackendPerchannelXml *xbpx,
+                                                         const gchar *channel_name);
+static gboolean blconf_backend_perchannel_xml_preload_record_timeout(gpointer data);
+static gboolean blconf_backend_perchannel_xml_finish_write(BlconfBackendPerchannelXml *xbpx,
+                                                           BlconfWriteJob *job,
+                                                           GError **error);
+static void blconf_write_job_free(BlconfWriteJob *job);
+
+static gchar *blconf_backend_perchannel_xml_snapshot_filename(BlconfBackendPerchannelXml *xbpx,
+                                                              const gchar *channel_name);
+static BlconfChannel *blconf_backend_perchannel_xml_load_snapshot(BlconfBackendPerchannelXml *xbpx,
+                                                                  const gchar *channel_name,
+                                                                  GArray *sources);
+static BlconfWriteJob *blconf_backend_perchannel_xml_snapshot_job(BlconfBackendPerchannelXml *xbpx,
+                                                                  const gchar *channel_name,
+                                                                  BlconfChannel *channel);
+static void blconf_backend_perchannel_xml_submit_write(BlconfBackendPerchannelXml *xbpx,
+                                                       BlconfWriteJob *job);
+
+static gchar *blconf_backend_perchannel_xml_journal_filename(BlconfBackendPerchannelXml *xbpx,
+                                                             const gchar *channel_name);
+static void blconf_journal_put_record(GByteArray *buf,
+                                      JournalOp op,
+                                      const gchar *property,
+                                      const GValue *value);
+static void blconf_backend_perchannel_xml_log_changes(BlconfBackendPerchannelXml *xbpx,
+                                                      BlconfChannel *channel,
+                                                      GByteArray *records);
+static void blconf_backend_perchannel_xml_journal_sync(BlconfBackendPerchannelXml *xbpx,
+                                                       BlconfChannel *channel);
+static void blconf_backend_perchannel_xml_journal_replay(BlconfBackendPerchannelXml *xbpx,
+                                                         const gchar *channel_name,
+                                                         BlconfChannel *channel);
+static void blconf_backend_perchannel_xml_journal_rotate(BlconfBackendPerchannelXml *xbpx,
+                                                         BlconfChannel *channel);
+static gboolean blconf_backend_perchannel_xml_journal_remove_old(BlconfBackendPerchannelXml *xbpx,
+                                                                 const gchar *channel_name);
+
+static GNode *blconf_proptree_new(void);
+static GNode *blconf_proptree_node_new(GNode *proptree,
+                                       const gchar *name);
 static GNode *blconf_proptree_add_property(GNode *proptree,
                                            const gchar *name,
                                            const GValue *value,
@@ -196,6 +601,15 @@ static BlconfProperty *blconf_proptree_lookup(GNode *proptree,
                                               const gchar *name);
 static GNode *blconf_proptree_lookup_node(GNode *proptree,
                                           const gchar *name);
+static GNode *blconf_proptree_lookup_child(GNode *parent,
+                                           const gchar *name);
+static void blconf_proptree_append_child(GNode *parent,
+                                         GNode *child);
+static void blconf_proptree_unlink(GNode *node);
+static void blconf_proptree_remove(GNode *node);
+static GNode *blconf_proptree_copy(GNode *proptree,
+                                   gboolean with_index);
+static GNode *blconf_proptree_compact(GNode *proptree);
 static gboolean blconf_proptree_reset(GNode *proptree,
                                       const gchar *name);
 static void blconf_proptree_destroy(GNode *proptree);
@@ -203,8 +617,15 @@ static gchar *blconf_proptree_build_propname(GNode *prop_node,
                                              gchar *buf,
                                              gsize buflen);
 
+static BlconfChannel *blconf_channel_new(GNode *properties);
 static void blconf_channel_destroy(BlconfChannel *channel);
 static void blconf_property_free(BlconfProperty *property);
+static GValue *blconf_property_get_value(BlconfProperty *prop);
+static GValue *blconf_property_init_system_value(BlconfProperty *prop,
+                                                 GType type);
+static void blconf_property_clear_system_value(BlconfProperty *prop);
+static void blconf_property_value_pool(GValue *value);
+static void blconf_property_value_unset(GValue *value);
 
 
 G_DEFINE_TYPE_WITH_CODE(BlconfBackendPerchannelXml, blconf_backend_perchannel_xml, G_TYPE_OBJECT,
@@ -217,7 +638,107 @@ blconf_backend_perchannel_xml_class_init(BlconfBackendPerchannelXmlClass *klass)
 {
     GObjectClass *object_class = (GObjectClass *)klass;
 
+    object_class->set_property = blconf_backend_perchannel_xml_set_g_property;
+    object_class->get_property = blconf_backend_perchannel_xml_get_g_property;
     object_class->finalize = blconf_backend_perchannel_xml_finalize;
+
+    /* how long a channel has to be left alone after a change before it
+     * gets written out, in milliseconds */
+    g_object_class_install_property(object_class, PROP_SAVE_DELAY,
+                                    g_param_spec_uint("save-delay",
+                                                      "Save Delay",
+                                                      "Idle time before a changed channel is saved (ms)",
+                                                      0, G_MAXUINT,
+                                                      SAVE_DELAY_DEFAULT,
+                                                      G_PARAM_READWRITE
+                                                      | G_PARAM_STATIC_NAME
+                                                      | G_PARAM_STATIC_NICK
+                                                      | G_PARAM_STATIC_BLURB));
+
+    /* upper bound on how long a change may stay unsaved while the channel
+     * keeps changing, in milliseconds */
+    g_object_class_install_property(object_class, PROP_MAX_SAVE_DELAY,
+                                    g_param_spec_uint("max-save-delay",
+                                                      "Maximum Save Delay",
+                                                      "Maximum time a change can stay unsaved (ms)",
+                                                      0, G_MAXUINT,
+                                                      MAX_SAVE_DELAY_DEFAULT,
+                                                      G_PARAM_READWRITE
+                                                      | G_PARAM_STATIC_NAME
+                                                      | G_PARAM_STATIC_NICK
+                                                      | G_PARAM_STATIC_BLURB));
+
+    /* channels that haven't been accessed for this long are dropped from
+     * memory, in milliseconds; 0 keeps them forever */
+    g_object_class_install_property(object_class, PROP_CACHE_TIMEOUT,
+                                    g_param_spec_uint("cache-timeout",
+                                                      "Cache Timeout",
+                                                      "Idle time before a channel is evicted (ms)",
+                                                      0, G_MAXUINT,
+                                                      CACHE_TIMEOUT,
+                                                      G_PARAM_READWRITE
+                                                      | G_PARAM_STATIC_NAME
+                                                      | G_PARAM_STATIC_NICK
+                                                      | G_PARAM_STATIC_BLURB));
+
+    /* least recently used channels are evicted while the loaded channels
+     * are estimated to take more than this, in bytes; 0 is unlimited */
+    g_object_class_install_property(object_class, PROP_MEMORY_BUDGET,
+                                    g_param_spec_uint64("memory-budget",
+                                                        "Memory Budget",
+                                                        "Memory loaded channels may use (bytes)",
+                                                        0, G_MAXUINT64,
+                                                        0,
+                                                        G_PARAM_READWRITE
+                                                        | G_PARAM_STATIC_NAME
+                                                        | G_PARAM_STATIC_NICK
+                                                        | G_PARAM_STATIC_BLURB));
+
+    g_object_class_install_property(object_class, PROP_MEMORY_USAGE,
+                                    g_param_spec_uint64("memory-usage",
+                                                        "Memory Usage",
+                                                        "Estimated memory used by loaded channels (bytes)",
+                                                        0, G_MAXUINT64,
+                                                        0,
+                                                        G_PARAM_READABLE
+                                                        | G_PARAM_STATIC_NAME
+                                                        | G_PARAM_STATIC_NICK
+                                                        | G_PARAM_STATIC_BLURB));
+
+    g_object_class_install_property(object_class, PROP_IDLE_EVICTIONS,
+                                    g_param_spec_uint64("idle-evictions",
+                                                        "Idle Evictions",
+                                                        "Channels evicted for being idle",
+                                                        0, G_MAXUINT64,
+                                                        0,
+                                                        G_PARAM_READABLE
+                                                        | G_PARAM_STATIC_NAME
+                                                        | G_PARAM_STATIC_NICK
+                                                        | G_PARAM_STATIC_BLURB));
+
+    g_object_class_install_property(object_class, PROP_BUDGET_EVICTIONS,
+                                    g_param_spec_uint64("budget-evictions",
+                                                        "Budget Evictions",
+                                                        "Channels evicted to stay within the memory budget",
+                                                        0, G_MAXUINT64,
+                                                        0,
+                                                        G_PARAM_READABLE
+                                                        | G_PARAM_STATIC_NAME
+                                                        | G_PARAM_STATIC_NICK
+                                                        | G_PARAM_STATIC_BLURB));
+
+    /* how long after startup channels are recorded for preloading on
+     * the next start, in seconds; 0 disables preloading */
+    g_object_class_install_property(object_class, PROP_PRELOAD_TIME,
+                                    g_param_spec_uint("preload-time",
+                                                      "Preload Time",
+                                                      "Startup period whose channels are preloaded next time (s)",
+                                                      0, G_MAXUINT,
+                                                      PRELOAD_TIME_DEFAULT,
+                                                      G_PARAM_READWRITE
+                                                      | G_PARAM_STATIC_NAME
+                                                      | G_PARAM_STATIC_NICK
+                                                      | G_PARAM_STATIC_BLURB));
 }
 
 static void
@@ -226,6 +747,104 @@ blconf_backend_perchannel_xml_init(BlconfBackendPerchannelXml *instance)
     instance->channels = g_hash_table_new_full(g_str_hash, g_str_equal,
                                                (GDestroyNotify)g_free,
                                                 (GDestroyNotify)blconf_channel_destroy);
+    instance->save_delay = SAVE_DELAY_DEFAULT;
+    instance->max_save_delay = MAX_SAVE_DELAY_DEFAULT;
+    instance->cache_timeout = CACHE_TIMEOUT;
+    instance->preload_time = PRELOAD_TIME_DEFAULT;
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_init(&instance->write_lock);
+    g_cond_init(&instance->write_cond);
+#else
+    instance->write_lock = g_mutex_new();
+    instance->write_cond = g_cond_new();
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+    instance->inotify_fd = -1;
+#endif
+}
+
+static void
+blconf_backend_perchannel_xml_set_g_property(GObject *object,
+                                             guint property_id,
+                                             const GValue *value,
+                                             GParamSpec *pspec)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(object);
+
+    switch(property_id) {
+        case PROP_SAVE_DELAY:
+            xbpx->save_delay = g_value_get_uint(value);
+            break;
+
+        case PROP_MAX_SAVE_DELAY:
+            xbpx->max_save_delay = g_value_get_uint(value);
+            break;
+
+        case PROP_CACHE_TIMEOUT:
+            xbpx->cache_timeout = g_value_get_uint(value);
+            break;
+
+        case PROP_MEMORY_BUDGET:
+            xbpx->memory_budget = g_value_get_uint64(value);
+            break;
+
+        case PROP_PRELOAD_TIME:
+            xbpx->preload_time = g_value_get_uint(value);
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+            break;
+    }
+}
+
+static void
+blconf_backend_perchannel_xml_get_g_property(GObject *object,
+                                             guint property_id,
+                                             GValue *value,
+                                             GParamSpec *pspec)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(object);
+
+    switch(property_id) {
+        case PROP_SAVE_DELAY:
+            g_value_set_uint(value, xbpx->save_delay);
+            break;
+
+        case PROP_MAX_SAVE_DELAY:
+            g_value_set_uint(value, xbpx->max_save_delay);
+            break;
+
+        case PROP_CACHE_TIMEOUT:
+            g_value_set_uint(value, xbpx->cache_timeout);
+            break;
+
+        case PROP_MEMORY_BUDGET:
+            g_value_set_uint64(value, xbpx->memory_budget);
+            break;
+
+        case PROP_MEMORY_USAGE:
+            g_value_set_uint64(value, xbpx->memory_usage);
+            break;
+
+        case PROP_IDLE_EVICTIONS:
+            g_value_set_uint64(value, xbpx->n_idle_evictions);
+            break;
+
+        case PROP_BUDGET_EVICTIONS:
+            g_value_set_uint64(value, xbpx->n_budget_evictions);
+            break;
+
+        case PROP_PRELOAD_TIME:
+            g_value_set_uint(value, xbpx->preload_time);
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+            break;
+    }
 }
 
 static void
@@ -233,15 +852,66 @@ blconf_backend_perchannel_xml_finalize(GObject *obj)
 {
     BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(obj);
 
-    if(xbpx->save_id) {
-        g_source_remove(xbpx->save_id);
-        xbpx->save_id = 0;
-        blconf_backend_perchannel_xml_flush(BLCONF_BACKEND(xbpx), NULL);
+    if(xbpx->evict_id)
+        g_source_remove(xbpx->evict_id);
+    if(xbpx->evict_idle_id)
+        g_source_remove(xbpx->evict_idle_id);
+
+    /* channels still queued for preloading aren't needed anymore */
+    if(xbpx->preload_pool)
+        g_thread_pool_free(xbpx->preload_pool, TRUE, TRUE);
+    if(xbpx->preloads)
+        g_hash_table_destroy(xbpx->preloads);
+    if(xbpx->preload_done_id)
+        g_source_remove(xbpx->preload_done_id);
+    if(xbpx->preload_record_id) {
+        g_source_remove(xbpx->preload_record_id);
+        blconf_backend_perchannel_xml_preload_record_timeout(xbpx);
+    }
+
+#ifdef HAVE_SYS_INOTIFY_H
+    if(xbpx->inotify_watch_id)
+        g_source_remove(xbpx->inotify_watch_id);
+    if(xbpx->inotify_fd >= 0)
+        close(xbpx->inotify_fd);
+    if(xbpx->reload_id)
+        g_source_remove(xbpx->reload_id);
+    if(xbpx->reload_channels)
+        g_hash_table_destroy(xbpx->reload_channels);
+    if(xbpx->watch_dirs)
+        g_hash_table_destroy(xbpx->watch_dirs);
+    if(xbpx->registry) {
+        g_hash_table_destroy(xbpx->registry);
+        g_hash_table_destroy(xbpx->registry_files);
+    }
+#endif
+    if(xbpx->resolved)
+        g_hash_table_destroy(xbpx->resolved);
+
+    /* write out anything that still has a save pending */
+    blconf_backend_perchannel_xml_flush(BLCONF_BACKEND(xbpx), NULL);
+
+    if(xbpx->writer) {
+        g_async_queue_push(xbpx->write_queue, &writer_quit_job);
+        g_thread_join(xbpx->writer);
     }
+    if(xbpx->write_queue)
+        g_async_queue_unref(xbpx->write_queue);
+    if(xbpx->write_done_id)
+        g_source_remove(xbpx->write_done_id);
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_clear(&xbpx->write_lock);
+    g_cond_clear(&xbpx->write_cond);
+#else
+    g_mutex_free(xbpx->write_lock);
+    g_cond_free(xbpx->write_cond);
+#endif
 
     g_hash_table_destroy(xbpx->channels);
 
     g_free(xbpx->config_save_path);
+    g_free(xbpx->cache_save_path);
 
     G_OBJECT_CLASS(blconf_backend_perchannel_xml_parent_class)->finalize(obj);
 }
@@ -252,9 +922,14 @@ blconf_backend_perchannel_xml_backend_init(BlconfBackendInterface *iface)
     iface->initialize = blconf_backend_perchannel_xml_initialize;
     iface->set = blconf_backend_perchannel_xml_set;
     iface->get = blconf_backend_perchannel_xml_get;
+    iface->get_many = blconf_backend_perchannel_xml_get_many;
     iface->get_all = blconf_backend_perchannel_xml_get_all;
+    iface->get_all_foreach = blconf_backend_perchannel_xml_get_all_foreach;
     iface->exists = blconf_backend_perchannel_xml_exists;
     iface->reset = blconf_backend_perchannel_xml_reset;
+    iface->set_many = blconf_backend_perchannel_xml_set_many;
+    iface->reset_many = blconf_backend_perchannel_xml_reset_many;
+    iface->can_reset = blconf_backend_perchannel_xml_can_reset;
     iface->list_channels = blconf_backend_perchannel_xml_list_channels;
     iface->is_property_locked = blconf_backend_perchannel_xml_is_property_locked;
     iface->flush = blconf_backend_perchannel_xml_flush;
@@ -283,19 +958,35 @@ blconf_backend_perchannel_xml_initialize(BlconfBackend *backend,
 
     backend_px->config_save_path = path;
 
+    /* snapshots are only an optimisation, so we can live without them */
+    path = xfce_resource_save_location(XFCE_RESOURCE_CACHE,
+                                       CONFIG_DIR_STEM,
+                                       TRUE);
+    if(path && g_file_test(path, G_FILE_TEST_IS_DIR))
+        backend_px->cache_save_path = path;
+    else {
+        g_warning("Unable to create cache directory \"%s\", channel snapshots are disabled",
+                  path);
+        g_free(path);
+    }
+
+#ifdef HAVE_SYS_INOTIFY_H
+    blconf_backend_perchannel_xml_watch_dirs(backend_px);
+#endif
+
+    if(backend_px->cache_save_path && backend_px->preload_time)
+        blconf_backend_perchannel_xml_start_preload(backend_px);
+
     return TRUE;
 }
 
-static gboolean
-blconf_backend_perchannel_xml_set(BlconfBackend *backend,
-                                  const gchar *channel_name,
-                                  const gchar *property,
-                                  const GValue *value,
-                                  GError **error)
+/* the channel to write to, creating it if it doesn't exist yet */
+static BlconfChannel *
+blconf_backend_perchannel_xml_channel_for_write(BlconfBackendPerchannelXml *xbpx,
+                                                const gchar *channel_name,
+                                                GError **error)
 {
-    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
-    BlconfProperty *cur_prop;
+    BlconfChannel *channel = blconf_backend_perchannel_xml_lookup_channel(xbpx, channel_name);
 
     if(!channel) {
         channel = blconf_backend_perchannel_xml_load_channel(xbpx, channel_name,
@@ -313,40 +1004,133 @@ blconf_backend_perchannel_xml_set(BlconfBackend *backend,
         }
     }
 
-    cur_prop = blconf_proptree_lookup(channel->properties, property);
-    if(cur_prop) {
-        if(cur_prop->locked) {
-            if(error) {
-                g_set_error(error, BLCONF_ERROR,
-                            BLCONF_ERROR_PERMISSION_DENIED,
-                            _("Permission denied while modifying property \"%s\" on channel \"%s\""),
-                            property, channel_name);
-            }
-            return FALSE;
+    return channel;
+}
+
+/* makes sure |property| may be written */
+static gboolean
+blconf_backend_perchannel_xml_set_check(BlconfChannel *channel,
+                                        const gchar *channel_name,
+                                        const gchar *property,
+                                        GError **error)
+{
+    BlconfProperty *cur_prop = blconf_proptree_lookup(channel->properties,
+                                                      property);
+
+    if(cur_prop && cur_prop->locked) {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR,
+                        BLCONF_ERROR_PERMISSION_DENIED,
+                        _("Permission denied while modifying property \"%s\" on channel \"%s\""),
+                        property, channel_name);
         }
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* sets |property|, which must pass blconf_backend_perchannel_xml_set_check(),
+ * and adds the journal record for it to |records| if the value changed */
+static void
+blconf_backend_perchannel_xml_set_one(BlconfBackendPerchannelXml *xbpx,
+                                      BlconfChannel *channel,
+                                      const gchar *channel_name,
+                                      const gchar *property,
+                                      const GValue *value,
+                                      GByteArray *records)
+{
+    BlconfProperty *cur_prop;
 
-        if(_blconf_gvalue_is_equal(G_VALUE_TYPE(&cur_prop->value)
-                                   ? &cur_prop->value
-                                   : &cur_prop->system_value, value))
+    cur_prop = blconf_proptree_lookup(channel->properties, property);
+    if(cur_prop) {
+        if(_blconf_gvalue_is_equal(blconf_property_get_value(cur_prop),
+                                   value))
         {
-            return TRUE;
+            return;
         }
 
         if(G_VALUE_TYPE(&cur_prop->value))
-            g_value_unset(&cur_prop->value);
+            blconf_property_value_unset(&cur_prop->value);
         g_value_copy(value, g_value_init(&cur_prop->value,
                                          G_VALUE_TYPE(value)));
-
-        if(xbpx->prop_changed_func)
-            xbpx->prop_changed_func(backend, channel_name, property, xbpx->prop_changed_data);
+        blconf_property_value_pool(&cur_prop->value);
     } else {
         blconf_proptree_add_property(channel->properties, property, value,
                                      NULL, FALSE);
-        if(xbpx->prop_changed_func)
-            xbpx->prop_changed_func(backend, channel_name, property, xbpx->prop_changed_data);
     }
 
-    blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+    if(xbpx->prop_changed_func)
+        xbpx->prop_changed_func(BLCONF_BACKEND(xbpx), channel_name, property, xbpx->prop_changed_data);
+
+    blconf_journal_put_record(records, JOURNAL_OP_SET, property, value);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_set(BlconfBackend *backend,
+                                  const gchar *channel_name,
+                                  const gchar *property,
+                                  const GValue *value,
+                                  GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfChannel *channel;
+    GByteArray *records;
+
+    channel = blconf_backend_perchannel_xml_channel_for_write(xbpx, channel_name,
+                                                              error);
+
+    if(!blconf_backend_perchannel_xml_set_check(channel, channel_name,
+                                                property, error))
+    {
+        return FALSE;
+    }
+
+    records = g_byte_array_sized_new(128);
+    blconf_backend_perchannel_xml_set_one(xbpx, channel, channel_name,
+                                          property, value, records);
+    if(records->len)
+        blconf_backend_perchannel_xml_log_changes(xbpx, channel, records);
+    g_byte_array_free(records, TRUE);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_perchannel_xml_set_many(BlconfBackend *backend,
+                                       const gchar *channel_name,
+                                       GHashTable *properties,
+                                       GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfChannel *channel;
+    GByteArray *records;
+    GHashTableIter iter;
+    gpointer property, value;
+
+    channel = blconf_backend_perchannel_xml_channel_for_write(xbpx, channel_name,
+                                                              error);
+
+    /* don't touch anything unless every property can be written */
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &property, NULL)) {
+        if(!blconf_backend_perchannel_xml_set_check(channel, channel_name,
+                                                    property, error))
+        {
+            return FALSE;
+        }
+    }
+
+    /* all the changes go into the journal with one write */
+    records = g_byte_array_new();
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &property, &value)) {
+        blconf_backend_perchannel_xml_set_one(xbpx, channel, channel_name,
+                                              property, value, records);
+    }
+    if(records->len)
+        blconf_backend_perchannel_xml_log_changes(xbpx, channel, records);
+    g_byte_array_free(records, TRUE);
 
     return TRUE;
 }
@@ -359,7 +1143,7 @@ blconf_backend_perchannel_xml_get(BlconfBackend *backend,
                                   GError **error)
 {
     BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
+    BlconfChannel *channel = blconf_backend_perchannel_xml_lookup_channel(xbpx, channel_name);
     BlconfProperty *cur_prop;
     GValue *value_to_get = NULL;
 
@@ -373,12 +1157,8 @@ blconf_backend_perchannel_xml_get(BlconfBackend *backend,
     }
 
     cur_prop = blconf_proptree_lookup(channel->properties, property);
-    if(cur_prop) {
-        if(G_VALUE_TYPE(&cur_prop->value))
-            value_to_get = &cur_prop->value;
-        else if(G_VALUE_TYPE(&cur_prop->system_value))
-            value_to_get = &cur_prop->system_value;
-    }
+    if(cur_prop)
+        value_to_get = blconf_property_get_value(cur_prop);
 
     if(!value_to_get) {
         if(error) {
@@ -395,18 +1175,51 @@ blconf_backend_perchannel_xml_get(BlconfBackend *backend,
     return TRUE;
 }
 
+static gboolean
+blconf_backend_perchannel_xml_get_many(BlconfBackend *backend,
+                                       const gchar *channel_name,
+                                       const gchar * const *properties,
+                                       GHashTable *values,
+                                       GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfChannel *channel = blconf_backend_perchannel_xml_lookup_channel(xbpx, channel_name);
+    gint i;
+
+    if(!channel) {
+        channel = blconf_backend_perchannel_xml_load_channel(xbpx, channel_name,
+                                                             error);
+        if(!channel)
+            return FALSE;
+    }
+
+    for(i = 0; properties[i]; ++i) {
+        BlconfProperty *prop;
+        GValue *value_to_get, *value;
+
+        if(g_hash_table_lookup(values, properties[i]))
+            continue;
+
+        prop = blconf_proptree_lookup(channel->properties, properties[i]);
+        value_to_get = prop ? blconf_property_get_value(prop) : NULL;
+        if(!value_to_get)
+            continue;
+
+        value = g_new0(GValue, 1);
+        g_value_copy(value_to_get, g_value_init(value, G_VALUE_TYPE(value_to_get)));
+        g_hash_table_insert(values, g_strdup(properties[i]), value);
+    }
+
+    return TRUE;
+}
+
 static void
 blconf_proptree_node_to_hash_table(GNode *node,
                                    GHashTable *props_hash,
                                    gchar cur_path[MAX_PROP_PATH])
 {
     BlconfProperty *prop = node->data;
-    GValue *value_to_get = NULL;
-
-    if(G_VALUE_TYPE(&prop->value))
-        value_to_get = &prop->value;
-    else if(G_VALUE_TYPE(&prop->system_value))
-        value_to_get = &prop->system_value;
+    GValue *value_to_get = blconf_property_get_value(prop);
 
     if(value_to_get) {
         GValue *value = g_new0(GValue, 1);
@@ -441,50 +1254,135 @@ blconf_proptree_node_to_hash_table(GNode *node,
 }
 
 static gboolean
-blconf_backend_perchannel_xml_get_all(BlconfBackend *backend,
-                                      const gchar *channel_name,
-                                      const gchar *property_base,
-                                      GHashTable *properties,
-                                      GError **error)
+blconf_proptree_node_foreach(GNode *node,
+                             BlconfPropertyVisitFunc func,
+                             gpointer user_data,
+                             gchar cur_path[MAX_PROP_PATH])
 {
-    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
-    GNode *props_tree;
-    gchar cur_path[MAX_PROP_PATH], *p;
+    BlconfProperty *prop = node->data;
+    GValue *value_to_get = blconf_property_get_value(prop);
+    gboolean ret = TRUE;
 
-    if(!channel) {
-        channel = blconf_backend_perchannel_xml_load_channel(xbpx, channel_name,
-                                                             error);
-        if(!channel)
-            return FALSE;
-    }
+    if(value_to_get) {
+        gchar fullprop[MAX_PROP_PATH];
 
-    if(property_base[0] && property_base[1]) {
-        /* it's not "" or "/" */
-        props_tree = blconf_proptree_lookup_node(channel->properties,
-                                                 property_base);
-        if(!props_tree) {
-            if(error) {
-                g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_PROPERTY_NOT_FOUND,
-                             _("Property \"%s\" does not exist on channel \"%s\""),
-                             property_base, channel_name);
-            }
+        g_snprintf(fullprop, sizeof(fullprop), "%s/%s", cur_path, prop->name);
+        if(!func(fullprop, value_to_get, user_data))
             return FALSE;
-        }
+    }
 
-        g_strlcpy(cur_path, property_base, sizeof(cur_path));
-        p = g_strrstr(cur_path, "/");  /* guaranteed to succeed */
+    if(node->children) {
+        GNode *cur;
+        gchar *p;
+
+        if(prop->name[0] != '/') {
+            g_strlcat(cur_path, "/", MAX_PROP_PATH);
+            g_strlcat(cur_path, prop->name, MAX_PROP_PATH);
+        }
+
+        for(cur = g_node_first_child(node);
+            cur && ret;
+            cur = g_node_next_sibling(cur))
+        {
+            ret = blconf_proptree_node_foreach(cur, func, user_data, cur_path);
+        }
+
+        p = strrchr(cur_path, '/');
+        if(p)
+            *p = 0;
+    }
+
+    return ret;
+}
+
+/* finds the node |property_base| refers to, and the path of its parent */
+static GNode *
+blconf_backend_perchannel_xml_get_subtree(BlconfBackendPerchannelXml *xbpx,
+                                          const gchar *channel_name,
+                                          const gchar *property_base,
+                                          gchar cur_path[MAX_PROP_PATH],
+                                          GError **error)
+{
+    BlconfChannel *channel = blconf_backend_perchannel_xml_lookup_channel(xbpx, channel_name);
+    GNode *props_tree;
+    gchar *p;
+
+    if(!channel) {
+        channel = blconf_backend_perchannel_xml_load_channel(xbpx, channel_name,
+                                                             error);
+        if(!channel)
+            return NULL;
+    }
+
+    if(property_base[0] && property_base[1]) {
+        /* it's not "" or "/" */
+        props_tree = blconf_proptree_lookup_node(channel->properties,
+                                                 property_base);
+        if(!props_tree) {
+            if(error) {
+                g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                             _("Property \"%s\" does not exist on channel \"%s\""),
+                             property_base, channel_name);
+            }
+            return NULL;
+        }
+
+        g_strlcpy(cur_path, property_base, MAX_PROP_PATH);
+        p = g_strrstr(cur_path, "/");  /* guaranteed to succeed */
         *p = 0;
     } else {
         props_tree = channel->properties;
         cur_path[0] = 0;
     }
 
+    return props_tree;
+}
+
+static gboolean
+blconf_backend_perchannel_xml_get_all(BlconfBackend *backend,
+                                      const gchar *channel_name,
+                                      const gchar *property_base,
+                                      GHashTable *properties,
+                                      GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    GNode *props_tree;
+    gchar cur_path[MAX_PROP_PATH];
+
+    props_tree = blconf_backend_perchannel_xml_get_subtree(xbpx, channel_name,
+                                                           property_base,
+                                                           cur_path, error);
+    if(!props_tree)
+        return FALSE;
+
     blconf_proptree_node_to_hash_table(props_tree, properties, cur_path);
 
     return TRUE;
 }
 
+static gboolean
+blconf_backend_perchannel_xml_get_all_foreach(BlconfBackend *backend,
+                                              const gchar *channel_name,
+                                              const gchar *property_base,
+                                              BlconfPropertyVisitFunc func,
+                                              gpointer user_data,
+                                              GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    GNode *props_tree;
+    gchar cur_path[MAX_PROP_PATH];
+
+    props_tree = blconf_backend_perchannel_xml_get_subtree(xbpx, channel_name,
+                                                           property_base,
+                                                           cur_path, error);
+    if(!props_tree)
+        return FALSE;
+
+    blconf_proptree_node_foreach(props_tree, func, user_data, cur_path);
+
+    return TRUE;
+}
+
 static gboolean
 blconf_backend_perchannel_xml_exists(BlconfBackend *backend,
                                      const gchar *channel_name,
@@ -493,7 +1391,7 @@ blconf_backend_perchannel_xml_exists(BlconfBackend *backend,
                                      GError **error)
 {
     BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
+    BlconfChannel *channel = blconf_backend_perchannel_xml_lookup_channel(xbpx, channel_name);
     BlconfProperty *prop;
 
     if(!channel) {
@@ -514,17 +1412,60 @@ blconf_backend_perchannel_xml_exists(BlconfBackend *backend,
     }
 
     prop = blconf_proptree_lookup(channel->properties, property);
-    *exists = (prop && (G_VALUE_TYPE(&prop->value)
-                        || G_VALUE_TYPE(&prop->system_value))
-               ? TRUE : FALSE);
+    *exists = (prop && blconf_property_get_value(prop) ? TRUE : FALSE);
+
+    return TRUE;
+}
+
+/* like _blconf_gvalue_is_equal(), but compares arrays element-wise */
+static gboolean
+blconf_gvalue_is_equal_deep(const GValue *value1,
+                            const GValue *value2)
+{
+    GPtrArray *arr1, *arr2;
+    guint i;
+
+    if(G_VALUE_TYPE(value1) != BLCONF_TYPE_G_VALUE_ARRAY
+       || G_VALUE_TYPE(value2) != BLCONF_TYPE_G_VALUE_ARRAY)
+    {
+        return _blconf_gvalue_is_equal(value1, value2);
+    }
+
+    arr1 = g_value_get_boxed(value1);
+    arr2 = g_value_get_boxed(value2);
+    if(!arr1 || !arr2)
+        return arr1 == arr2;
+    if(arr1->len != arr2->len)
+        return FALSE;
+
+    for(i = 0; i < arr1->len; ++i) {
+        if(!blconf_gvalue_is_equal_deep(g_ptr_array_index(arr1, i),
+                                        g_ptr_array_index(arr2, i)))
+        {
+            return FALSE;
+        }
+    }
 
     return TRUE;
 }
 
+/* whether resetting |prop| leaves its effective value as it is, i.e. it
+ * has no value of its own or that value is the same as the system one */
+static gboolean
+blconf_property_reset_is_noop(BlconfProperty *prop)
+{
+    if(!G_VALUE_TYPE(&prop->value))
+        return TRUE;
+
+    return prop->system_value
+           && blconf_gvalue_is_equal_deep(&prop->value, prop->system_value);
+}
+
 typedef struct
 {
     BlconfBackendPerchannelXml *xbpx;
     const gchar *channel_name;
+    gboolean reset_any;
 } PropChangeData;
 
 static gboolean
@@ -535,12 +1476,18 @@ nodes_do_prop_reset(GNode *node,
     BlconfProperty *prop = node->data;
     gchar prop_fullname[MAX_PROP_PATH];
 
-
-    /* we don't signal if |value| isn't set but |system_value| is,
-     * because we're not actually changing anything by definition */
     if(G_VALUE_TYPE(&prop->value)) {
-        g_value_unset(&prop->value);
-        if(pdata->xbpx->prop_changed_func) {
+        /* nobody needs to hear about it if the value falls back to a
+         * system default that's the same */
+        gboolean notify = !blconf_property_reset_is_noop(prop);
+
+        blconf_property_value_unset(&prop->value);
+
+        if(!pdata)
+            return FALSE;
+        pdata->reset_any = TRUE;
+
+        if(notify && pdata->xbpx->prop_changed_func) {
             pdata->xbpx->prop_changed_func(BLCONF_BACKEND(pdata->xbpx),
                                            pdata->channel_name,
                                            blconf_proptree_build_propname(node,
@@ -562,10 +1509,9 @@ nodes_clean_up(GNode *node,
     /* clean up dangling nodes in tree without system defaults */
     if(!node->children
        && !G_VALUE_TYPE(&prop->value)
-       && !G_VALUE_TYPE(&prop->system_value)
+       && !prop->system_value
        && !prop->locked) {
-        g_node_unlink(node);
-        blconf_proptree_destroy(node);
+        blconf_proptree_remove(node);
     }
 
     return FALSE;
@@ -578,23 +1524,47 @@ do_reset_channel(BlconfBackend *backend,
                  GError **error)
 {
     BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    gchar *filename;
+    BlconfChannel *channel;
+    gchar *lower, *filename;
+    gboolean journal_removed;
     PropChangeData pdata;
 
+    /* a write that's still in progress would bring the files back */
+    channel = g_hash_table_lookup(xbpx->channels, channel_name);
+    if(channel && channel->write_job) {
+        channel->flush_pending = FALSE;
+        blconf_backend_perchannel_xml_finish_write(xbpx, channel->write_job,
+                                                   NULL);
+    }
+
     pdata.xbpx = xbpx;
     pdata.channel_name = channel_name;
+    pdata.reset_any = FALSE;
     g_node_traverse(properties, G_POST_ORDER, G_TRAVERSE_ALL, -1,
                     nodes_do_prop_reset, &pdata);
 
+    blconf_backend_perchannel_xml_invalidate_resolved(xbpx, channel_name);
+
     /* we could probably prune the existing proptree, or even just leave
      * it as-is, but it's easier to just kill it.  it'll get reloaded later
      * from the system file (if any) if needed. */
     g_hash_table_remove(xbpx->channels, channel_name);
 
+    /* any changes that were never compacted go away as well; a channel
+     * that only ever lived in its journal has no user file to remove */
+    journal_removed = blconf_backend_perchannel_xml_journal_remove_old(xbpx,
+                                                                       channel_name);
+    filename = blconf_backend_perchannel_xml_journal_filename(xbpx, channel_name);
+    if(!unlink(filename))
+        journal_removed = TRUE;
+    g_free(filename);
+
     /* regardless of whether or not we have a system file, we don't need
-     * the user file anymore */
-    filename = g_strdup_printf("%s/%s.xml", xbpx->config_save_path, channel_name);
-    if(unlink(filename)) {
+     * the user file anymore.  the files on disk (and so the registry) are
+     * always named after the lowercased channel name. */
+    lower = g_ascii_strdown(channel_name, -1);
+    filename = g_strdup_printf("%s/%s.xml", xbpx->config_save_path, lower);
+    if(unlink(filename) && !(errno == ENOENT && journal_removed)) {
         if(error) {
             g_set_error(error, BLCONF_ERROR,
                         BLCONF_ERROR_WRITE_FAILURE,
@@ -602,22 +1572,132 @@ do_reset_channel(BlconfBackend *backend,
                         channel_name, strerror(errno));
         }
         g_free(filename);
+        g_free(lower);
         return FALSE;
     }
     g_free(filename);
 
+    blconf_backend_perchannel_xml_registry_update(xbpx, lower, ".journal",
+                                                  FALSE);
+    blconf_backend_perchannel_xml_registry_update(xbpx, lower,
+                                                  ".journal" JOURNAL_OLD_SUFFIX,
+                                                  FALSE);
+    blconf_backend_perchannel_xml_registry_update(xbpx, lower, ".xml",
+                                                  FALSE);
+    g_free(lower);
+
+    if(xbpx->cache_save_path) {
+        filename = blconf_backend_perchannel_xml_snapshot_filename(xbpx,
+                                                                   channel_name);
+        unlink(filename);
+        g_free(filename);
+    }
+
+    return TRUE;
+}
+
+/* makes sure a reset of |property| would succeed */
+static gboolean
+blconf_backend_perchannel_xml_reset_check(BlconfChannel *channel,
+                                          const gchar *channel_name,
+                                          const gchar *property,
+                                          gboolean recursive,
+                                          GError **error)
+{
+    gboolean exists;
+
+    if(recursive)
+        exists = blconf_proptree_lookup_node(channel->properties, property) != NULL;
+    else {
+        BlconfProperty *prop = blconf_proptree_lookup(channel->properties,
+                                                      property);
+        exists = prop && G_IS_VALUE(&prop->value);
+    }
+
+    if(!exists) {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR,
+                        BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                        _("Property \"%s\" does not exist on channel \"%s\""),
+                        property, channel_name);
+        }
+        return FALSE;
+    }
+
     return TRUE;
 }
 
+/* resets |property|, which must pass blconf_backend_perchannel_xml_reset_check(),
+ * and adds the journal record for it to |records| if anything changed.
+ * resets of the whole channel are handled by do_reset_channel(). */
+static void
+blconf_backend_perchannel_xml_reset_one(BlconfBackendPerchannelXml *xbpx,
+                                        BlconfChannel *channel,
+                                        const gchar *channel_name,
+                                        const gchar *property,
+                                        gboolean recursive,
+                                        GByteArray *records)
+{
+    if(!recursive) {
+        BlconfProperty *prop = blconf_proptree_lookup(channel->properties,
+                                                      property);
+        gboolean notify = prop && !blconf_property_reset_is_noop(prop);
+
+        blconf_proptree_reset(channel->properties, property);
+
+        if(notify && xbpx->prop_changed_func)
+            xbpx->prop_changed_func(BLCONF_BACKEND(xbpx), channel_name, property, xbpx->prop_changed_data);
+
+        blconf_journal_put_record(records, JOURNAL_OP_RESET, property, NULL);
+    } else {
+        GNode *top = blconf_proptree_lookup_node(channel->properties, property);
+        PropChangeData pdata;
+
+        pdata.xbpx = xbpx;
+        pdata.channel_name = channel_name;
+        pdata.reset_any = FALSE;
+        g_node_traverse(top, G_POST_ORDER, G_TRAVERSE_ALL, -1,
+                        nodes_do_prop_reset, &pdata);
+
+        /* nothing in the subtree had a value of its own, so there's
+         * nothing to clean up or write out */
+        if(!pdata.reset_any)
+            return;
+
+        /* clean up dangling nodes in tree without system defaults */
+        g_node_traverse(top, G_POST_ORDER, G_TRAVERSE_ALL, -1,
+                        nodes_clean_up, NULL);
+
+        blconf_journal_put_record(records, JOURNAL_OP_RESET_RECURSIVE,
+                                  property, NULL);
+    }
+}
+
 static gboolean
 blconf_backend_perchannel_xml_reset(BlconfBackend *backend,
                                     const gchar *channel_name,
                                     const gchar *property,
                                     gboolean recursive,
                                     GError **error)
+{
+    const gchar *properties[2] = { property, NULL };
+
+    return blconf_backend_perchannel_xml_reset_many(backend, channel_name,
+                                                    properties, recursive,
+                                                    error);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_reset_many(BlconfBackend *backend,
+                                         const gchar *channel_name,
+                                         const gchar * const *properties,
+                                         gboolean recursive,
+                                         GError **error)
 {
     BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
+    BlconfChannel *channel = blconf_backend_perchannel_xml_lookup_channel(xbpx, channel_name);
+    GByteArray *records;
+    gint i;
 
     if(!channel) {
         channel = blconf_backend_perchannel_xml_load_channel(xbpx, channel_name,
@@ -626,61 +1706,186 @@ blconf_backend_perchannel_xml_reset(BlconfBackend *backend,
             return FALSE;
     }
 
-    if(!recursive) {
-        if(!blconf_proptree_reset(channel->properties, property)) {
-            if(error) {
-                g_set_error(error, BLCONF_ERROR,
-                            BLCONF_ERROR_PROPERTY_NOT_FOUND,
-                            _("Property \"%s\" does not exist on channel \"%s\""),
-                            property, channel_name);
-            }
-            return FALSE;
+    for(i = 0; properties[i]; ++i) {
+        if(recursive && !(properties[i][0] && properties[i][1])) {
+            /* it's "" or "/": remove the entire channel, which covers
+             * everything else as well */
+            return do_reset_channel(backend, channel_name,
+                                    channel->properties, error);
         }
+    }
 
-        if(xbpx->prop_changed_func)  /* FIXME: this could fire spuriously */
-            xbpx->prop_changed_func(backend, channel_name, property, xbpx->prop_changed_data);
-    } else {
-        GNode *top;
-        
-        if(property[0] && property[1]) {
-            PropChangeData pdata;
-
-            /* it's not "" or "/" */
-            top = blconf_proptree_lookup_node(channel->properties, property);
-            if(!top) {
-                if(error) {
-                    g_set_error(error, BLCONF_ERROR,
-                                BLCONF_ERROR_PROPERTY_NOT_FOUND,
-                                _("Property \"%s\" does not exist on channel \"%s\""),
-                                property, channel_name);
-                }
-                return FALSE;
-            }
+    /* don't touch anything unless every reset can be done */
+    for(i = 0; properties[i]; ++i) {
+        if(!blconf_backend_perchannel_xml_reset_check(channel, channel_name,
+                                                      properties[i],
+                                                      recursive, error))
+        {
+            return FALSE;
+        }
+    }
 
-            pdata.xbpx = xbpx;
-            pdata.channel_name = channel_name;
-            g_node_traverse(top, G_POST_ORDER, G_TRAVERSE_ALL, -1,
-                            nodes_do_prop_reset, &pdata);
+    records = g_byte_array_new();
 
-            /* clean up dangling nodes in tree without system defaults */
-            g_node_traverse(top, G_POST_ORDER, G_TRAVERSE_ALL, -1,
-                            nodes_clean_up, NULL);
-        } else {
-            /* remove the entire channel */
-            return do_reset_channel(backend, channel_name,
-                                    channel->properties, error);
+    for(i = 0; properties[i]; ++i) {
+        /* an earlier recursive reset may have taken this one with it */
+        if(i > 0 && !blconf_backend_perchannel_xml_reset_check(channel,
+                                                               channel_name,
+                                                               properties[i],
+                                                               recursive,
+                                                               NULL))
+        {
+            continue;
         }
+
+        blconf_backend_perchannel_xml_reset_one(xbpx, channel, channel_name,
+                                                properties[i], recursive,
+                                                records);
+    }
+
+    if(records->len) {
+        blconf_backend_perchannel_xml_log_changes(xbpx, channel, records);
+        channel->properties = blconf_proptree_compact(channel->properties);
     }
 
-    blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+    g_byte_array_free(records, TRUE);
 
     return TRUE;
 }
 
 static gboolean
-blconf_backend_perchannel_xml_list_channels(BlconfBackend *backend,
-                                            GSList **channels,
-                                            GError **error)
+blconf_backend_perchannel_xml_can_reset(BlconfBackend *backend,
+                                        const gchar *channel_name,
+                                        const gchar *property,
+                                        gboolean recursive,
+                                        GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfChannel *channel = blconf_backend_perchannel_xml_lookup_channel(xbpx, channel_name);
+
+    if(!channel) {
+        channel = blconf_backend_perchannel_xml_load_channel(xbpx, channel_name,
+                                                             error);
+        if(!channel)
+            return FALSE;
+    }
+
+    /* the whole channel can always go */
+    if(recursive && !(property[0] && property[1]))
+        return TRUE;
+
+    return blconf_backend_perchannel_xml_reset_check(channel, channel_name,
+                                                     property, recursive,
+                                                     error);
+}
+
+/* returns the name of the channel |filename| belongs to, or NULL if it's
+ * not a channel file.  channels that were never compacted only have a
+ * journal, possibly one that's set aside during a write. */
+static gchar *
+blconf_channel_name_from_filename(const gchar *filename)
+{
+    gsize suffix_len = 0;
+
+    if(filename[0] == '.')
+        return NULL;
+
+    if(g_str_has_suffix(filename, ".xml"))
+        suffix_len = strlen(".xml");
+    else if(g_str_has_suffix(filename, ".journal"))
+        suffix_len = strlen(".journal");
+    else if(g_str_has_suffix(filename, ".journal" JOURNAL_OLD_SUFFIX))
+        suffix_len = strlen(".journal" JOURNAL_OLD_SUFFIX);
+
+    if(!suffix_len || strlen(filename) == suffix_len)
+        return NULL;
+
+    /* FIXME: maybe validate the files' contents a bit? */
+    return g_strndup(filename, strlen(filename) - suffix_len);
+}
+
+static void
+blconf_channel_registry_add(GHashTable *registry,
+                            GHashTable *registry_files,
+                            const gchar *dir,
+                            const gchar *filename)
+{
+    gchar *channel_name, *path;
+
+    channel_name = blconf_channel_name_from_filename(filename);
+    if(!channel_name)
+        return;
+
+    path = g_build_filename(dir, filename, NULL);
+    if(!g_hash_table_lookup(registry_files, path)) {
+        guint n_files = GPOINTER_TO_UINT(g_hash_table_lookup(registry,
+                                                             channel_name));
+
+        g_hash_table_insert(registry, g_strdup(channel_name),
+                            GUINT_TO_POINTER(n_files + 1));
+        g_hash_table_insert(registry_files, path, channel_name);
+    } else {
+        g_free(path);
+        g_free(channel_name);
+    }
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+static void
+blconf_channel_registry_remove(GHashTable *registry,
+                               GHashTable *registry_files,
+                               const gchar *dir,
+                               const gchar *filename)
+{
+    gchar *path = g_build_filename(dir, filename, NULL);
+    const gchar *channel_name = g_hash_table_lookup(registry_files, path);
+
+    if(channel_name) {
+        guint n_files = GPOINTER_TO_UINT(g_hash_table_lookup(registry,
+                                                             channel_name));
+
+        if(n_files > 1) {
+            g_hash_table_insert(registry, g_strdup(channel_name),
+                                GUINT_TO_POINTER(n_files - 1));
+        } else
+            g_hash_table_remove(registry, channel_name);
+
+        g_hash_table_remove(registry_files, path);
+    }
+
+    g_free(path);
+}
+#endif
+
+/* keeps the registry in step with the files we create and remove
+ * ourselves, rather than waiting for the monitor to tell us */
+static void
+blconf_backend_perchannel_xml_registry_update(BlconfBackendPerchannelXml *xbpx,
+                                              const gchar *channel_name,
+                                              const gchar *suffix,
+                                              gboolean added)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    gchar *filename;
+
+    if(!xbpx->registry)
+        return;
+
+    filename = g_strconcat(channel_name, suffix, NULL);
+    if(added) {
+        blconf_channel_registry_add(xbpx->registry, xbpx->registry_files,
+                                    xbpx->config_save_path, filename);
+    } else {
+        blconf_channel_registry_remove(xbpx->registry, xbpx->registry_files,
+                                       xbpx->config_save_path, filename);
+    }
+    g_free(filename);
+#endif
+}
+
+static void
+blconf_channel_registry_scan(GHashTable *registry,
+                             GHashTable *registry_files)
 {
     gchar **dirs;
     gint i;
@@ -693,23 +1898,58 @@ blconf_backend_perchannel_xml_list_channels(BlconfBackend *backend,
         if(!dir)
             continue;
 
-        while((name = g_dir_read_name(dir))) {
-            if(g_str_has_suffix(name, ".xml")) {
-                /* FIXME: maybe validate the files' contents a bit? */
-                /* FIXME: maybe temp use a hash table or gtree to avoid search */
-                gchar *channel_name = g_strndup(name, strlen(name) - 4);
-                if(!g_slist_find_custom(*channels, channel_name,
-                                        (GCompareFunc)strcmp))
-                {
-                    *channels = g_slist_prepend(*channels, channel_name);
-                } else
-                    g_free(channel_name);
-            }
-        }
+        while((name = g_dir_read_name(dir)))
+            blconf_channel_registry_add(registry, registry_files, dirs[i], name);
 
         g_dir_close(dir);
     }
     g_strfreev(dirs);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_list_channels(BlconfBackend *backend,
+                                            GSList **channels,
+                                            GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    GHashTable *registry = NULL, *registry_files = NULL;
+    GHashTableIter iter;
+    gpointer channel_name;
+
+#ifdef HAVE_SYS_INOTIFY_H
+    if(xbpx->inotify_watch_id) {
+        if(!xbpx->registry) {
+            xbpx->registry = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                   (GDestroyNotify)g_free,
+                                                   NULL);
+            xbpx->registry_files = g_hash_table_new_full(g_str_hash,
+                                                         g_str_equal,
+                                                         (GDestroyNotify)g_free,
+                                                         (GDestroyNotify)g_free);
+            blconf_channel_registry_scan(xbpx->registry, xbpx->registry_files);
+        }
+        registry = xbpx->registry;
+    }
+#endif
+
+    if(!registry) {
+        /* without the monitor, we can't know when it'd be out of date */
+        registry = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                         (GDestroyNotify)g_free, NULL);
+        registry_files = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                               (GDestroyNotify)g_free,
+                                               (GDestroyNotify)g_free);
+        blconf_channel_registry_scan(registry, registry_files);
+    }
+
+    g_hash_table_iter_init(&iter, registry);
+    while(g_hash_table_iter_next(&iter, &channel_name, NULL))
+        *channels = g_slist_prepend(*channels, g_strdup(channel_name));
+
+    if(registry_files) {
+        g_hash_table_destroy(registry);
+        g_hash_table_destroy(registry_files);
+    }
 
     return TRUE;
 }
@@ -722,7 +1962,7 @@ blconf_backend_perchannel_xml_is_property_locked(BlconfBackend *backend,
                                                  GError **error)
 {
     BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
+    BlconfChannel *channel = blconf_backend_perchannel_xml_lookup_channel(xbpx, channel_name);
     BlconfProperty *prop = NULL;
 
     if(!channel) {
@@ -746,7 +1986,7 @@ blconf_backend_perchannel_xml_flush_get_dirty(gpointer key,
     BlconfChannel *channel = value;
     GSList **dirty = user_data;
     if(channel->dirty)
-        *dirty = g_slist_prepend(*dirty, key);
+        *dirty = g_slist_prepend(*dirty, channel);
 }
 
 static gboolean
@@ -755,16 +1995,28 @@ blconf_backend_perchannel_xml_flush(BlconfBackend *backend,
 {
     BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
     GSList *dirty = NULL, *l;
+    gboolean ret = TRUE;
 
     g_hash_table_foreach(xbpx->channels, blconf_backend_perchannel_xml_flush_get_dirty, &dirty);
 
     for(l = dirty; l; l = l->next)
-        blconf_backend_perchannel_xml_flush_channel(xbpx, l->data, error);
+        blconf_backend_perchannel_xml_flush_channel(xbpx, l->data);
     g_slist_free(dirty);
 
-    TRACE("exiting, flushed all channels");
-
-    return TRUE;
+    /* and wait until all of it is on disk; finishing a write may start
+     * another one for the same channel if it changed in the meantime */
+    while(xbpx->write_jobs) {
+        if(!blconf_backend_perchannel_xml_finish_write(xbpx,
+                                                       xbpx->write_jobs->data,
+                                                       error))
+        {
+            ret = FALSE;
+        }
+    }
+
+    TRACE("exiting, flushed all channels");
+
+    return ret;
 }
 
 static void
@@ -781,40 +2033,97 @@ blconf_backend_perchannel_xml_register_property_changed_func(BlconfBackend *back
 
 
 static GNode *
-blconf_proptree_lookup_node(GNode *proptree,
-                            const gchar *name)
+blconf_proptree_lookup_child(GNode *parent,
+                             const gchar *name)
 {
-    GNode *found_node = NULL;
-    gchar **parts;
-    GNode *parent, *node;
-    gint i;
+    BlconfProperty *parent_prop = parent->data;
+    GNode *node;
 
-    g_return_val_if_fail(PROP_NAME_IS_VALID(name), NULL);
+    /* if no property anywhere has this name, there's nothing to find */
+    name = blconf_string_pool_lookup(name);
+    if(!name)
+        return NULL;
+
+    if(parent_prop->children)
+        return g_hash_table_lookup(parent_prop->children, name);
+
+    for(node = g_node_first_child(parent);
+        node;
+        node = g_node_next_sibling(node))
+    {
+        if(((BlconfProperty *)node->data)->name == name)
+            return node;
+    }
+
+    return NULL;
+}
+
+static void
+blconf_proptree_append_child(GNode *parent,
+                             GNode *child)
+{
+    BlconfProperty *parent_prop = parent->data;
 
-    parts = g_strsplit(name+1, "/", -1);
-    parent = proptree;
+    g_node_append(parent, child);
 
-    for(i = 0; parts[i]; ++i) {
+    if(parent_prop->children) {
+        g_hash_table_insert(parent_prop->children,
+                            (gpointer)((BlconfProperty *)child->data)->name,
+                            child);
+    } else if(g_node_n_children(parent) >= PROPTREE_INDEX_MIN_CHILDREN) {
+        GNode *node;
+
+        parent_prop->children = g_hash_table_new(g_direct_hash, g_direct_equal);
         for(node = g_node_first_child(parent);
             node;
             node = g_node_next_sibling(node))
         {
-            if(!strcmp(((BlconfProperty *)node->data)->name, parts[i])) {
-                if(!parts[i+1])
-                    found_node = node;
-                else
-                    parent = node;
-                break;
-            }
+            g_hash_table_insert(parent_prop->children,
+                                (gpointer)((BlconfProperty *)node->data)->name,
+                                node);
         }
+    }
+}
 
-        if(found_node || !node)
-            break;
+static void
+blconf_proptree_unlink(GNode *node)
+{
+    if(node->parent) {
+        BlconfProperty *parent_prop = node->parent->data;
+
+        if(parent_prop->children) {
+            g_hash_table_remove(parent_prop->children,
+                                ((BlconfProperty *)node->data)->name);
+        }
     }
 
-    g_strfreev(parts);
+    g_node_unlink(node);
+}
+
+static GNode *
+blconf_proptree_lookup_node(GNode *proptree,
+                            const gchar *name)
+{
+    gchar path[MAX_PROP_PATH];
+    gchar *segment, *p;
+    GNode *node = proptree;
+
+    g_return_val_if_fail(PROP_NAME_IS_VALID(name), NULL);
 
-    return found_node;
+    /* walk the path in place on a stack copy; each '/' is swapped for a
+     * NUL to terminate the current segment */
+    if(g_strlcpy(path, name + 1, sizeof(path)) >= sizeof(path))
+        return NULL;
+
+    for(segment = path; node && segment; segment = p) {
+        p = strchr(segment, '/');
+        if(p)
+            *p++ = 0;
+
+        node = blconf_proptree_lookup_child(node, segment);
+    }
+
+    return node;
 }
 
 static BlconfProperty *
@@ -839,7 +2148,7 @@ blconf_proptree_add_property(GNode *proptree,
                              const GValue *system_value,
                              gboolean locked)
 {
-    GNode *parent = NULL;
+    GNode *parent = NULL, *node;
     gchar tmp[MAX_PROP_PATH];
     gchar *p;
     BlconfProperty *prop;
@@ -857,15 +2166,18 @@ blconf_proptree_add_property(GNode *proptree,
             parent = blconf_proptree_add_property(proptree, tmp, NULL, NULL, FALSE);
     }
 
-    prop = g_slice_new0(BlconfProperty);
-    prop->name = g_strdup(strrchr(name, '/')+1);
+    node = blconf_proptree_node_new(proptree, strrchr(name, '/')+1);
+    prop = node->data;
     if(value) {
         g_value_init(&prop->value, G_VALUE_TYPE(value));
         g_value_copy(value, &prop->value);
+        blconf_property_value_pool(&prop->value);
     }
     prop->locked = locked;
 
-    return g_node_append_data(parent, prop);
+    blconf_proptree_append_child(parent, node);
+
+    return node;
 }
 
 static gboolean
@@ -878,22 +2190,21 @@ blconf_proptree_reset(GNode *proptree,
         BlconfProperty *prop = node->data;
 
         if(G_IS_VALUE(&prop->value)) {
-            if(node->children || G_VALUE_TYPE(&prop->system_value)) {
+            if(node->children || prop->system_value) {
                 /* don't remove the children; just blank out the value */
                 DBG("unsetting value at \"%s\"", prop->name);
-                g_value_unset(&prop->value);
+                blconf_property_value_unset(&prop->value);
             } else {
                 GNode *parent = node->parent;
 
-                g_node_unlink(node);
-                blconf_proptree_destroy(node);
+                blconf_proptree_remove(node);
 
                 /* remove parents without values until we find the root node or 
                  * a parent with a value or any children */
                 while(parent) {
                     prop = parent->data;
                     if(!G_IS_VALUE(&prop->value)
-                       && !G_IS_VALUE(&prop->system_value)
+                       && !prop->system_value
                        && !parent->children && strcmp(prop->name, "/"))
                     {
                         GNode *tmp = parent;
@@ -901,8 +2212,7 @@ blconf_proptree_reset(GNode *proptree,
 
                         DBG("unlinking node at \"%s\"", prop->name);
 
-                        g_node_unlink(tmp);
-                        blconf_proptree_destroy(tmp);
+                        blconf_proptree_remove(tmp);
                     } else
                         parent = NULL;
                 }
@@ -915,22 +2225,117 @@ blconf_proptree_reset(GNode *proptree,
     return FALSE;
 }
 
-static gboolean
-proptree_free_node_data(GNode *node,
-                        gpointer data)
+static GNode *
+blconf_proptree_new(void)
+{
+    BlconfProperty *root;
+
+    /* the root node isn't part of the blocks: it's allocated along with
+     * the arena, which is how PROPTREE_ARENA() finds the latter */
+    root = g_malloc0(PROPTREE_ARENA_HEADER_SIZE + sizeof(BlconfProperty));
+    root = (BlconfProperty *)((gchar *)root + PROPTREE_ARENA_HEADER_SIZE);
+    root->name = blconf_string_pool_ref("/");
+    root->node.data = root;
+
+    return &root->node;
+}
+
+static GNode *
+blconf_proptree_node_new(GNode *proptree,
+                         const gchar *name)
+{
+    BlconfProptreeArena *arena = PROPTREE_ARENA(g_node_get_root(proptree));
+    BlconfProperty *prop;
+
+    if(PROPTREE_NODE_SIZE > arena->left) {
+        arena->pos = g_malloc0(PROPTREE_ARENA_BLOCK_SIZE);
+        arena->left = PROPTREE_ARENA_BLOCK_SIZE;
+        arena->blocks = g_slist_prepend(arena->blocks, arena->pos);
+    }
+
+    prop = (BlconfProperty *)arena->pos;
+    arena->pos += PROPTREE_NODE_SIZE;
+    arena->left -= PROPTREE_NODE_SIZE;
+    arena->used += PROPTREE_NODE_SIZE;
+
+    prop->name = blconf_string_pool_ref(name);
+    prop->node.data = prop;
+
+    return &prop->node;
+}
+
+static gsize
+blconf_proptree_release(GNode *node)
 {
+    GNode *child;
+    gsize size = PROPTREE_NODE_SIZE;
+
+    for(child = node->children; child; child = child->next)
+        size += blconf_proptree_release(child);
+
     blconf_property_free((BlconfProperty *)node->data);
-    return FALSE;
+
+    return size;
+}
+
+/* takes |node| and everything below it out of the tree.  the memory
+ * stays with the arena until the tree is compacted or destroyed. */
+static void
+blconf_proptree_remove(GNode *node)
+{
+    BlconfProptreeArena *arena = PROPTREE_ARENA(g_node_get_root(node));
+
+    g_return_if_fail(node->parent);
+
+    blconf_proptree_unlink(node);
+    arena->dead += blconf_proptree_release(node);
 }
 
 static void
 blconf_proptree_destroy(GNode *proptree)
 {
-    if(G_LIKELY(proptree)) {
-        g_node_traverse(proptree, G_IN_ORDER, G_TRAVERSE_ALL, -1,
-                        proptree_free_node_data, NULL);
-        g_node_destroy(proptree);
+    BlconfProptreeArena *arena;
+    GNode *child;
+
+    if(G_UNLIKELY(!proptree))
+        return;
+
+    g_return_if_fail(!proptree->parent);
+
+    arena = PROPTREE_ARENA(proptree);
+
+    /* the nodes themselves go away with the blocks; this only drops
+     * whatever the values and child indexes hold on to */
+    for(child = proptree->children; child; child = child->next)
+        blconf_proptree_release(child);
+    blconf_property_free((BlconfProperty *)proptree->data);
+
+    g_slist_foreach(arena->blocks, (GFunc)g_free, NULL);
+    g_slist_free(arena->blocks);
+    g_free(arena);
+}
+
+/* if most of |proptree|'s arena is taken up by removed nodes, moves the
+ * tree into a fresh one.  returns the tree to use from now on. */
+static GNode *
+blconf_proptree_compact(GNode *proptree)
+{
+    BlconfProptreeArena *arena = PROPTREE_ARENA(proptree);
+    GNode *copy;
+
+    if(arena->dead < PROPTREE_ARENA_COMPACT_MIN
+       || arena->dead < arena->used - arena->dead)
+    {
+        return proptree;
     }
+
+    DBG("compacting proptree (%" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT
+        " bytes unused)", arena->dead, arena->used);
+
+    copy = blconf_proptree_copy(proptree, TRUE);
+    blconf_proptree_destroy(proptree);
+
+    return copy;
 }
 
 static gchar *
@@ -962,29 +2367,194 @@ blconf_proptree_build_propname(GNode *prop_node,
 
 
 
+static void
+blconf_snapshot_sources_free(GArray *sources)
+{
+    guint i;
+
+    if(!sources)
+        return;
+
+    for(i = 0; i < sources->len; ++i)
+        g_free(g_array_index(sources, SnapshotSource, i).path);
+    g_array_free(sources, TRUE);
+}
+
+static GArray *
+blconf_snapshot_sources_copy(GArray *sources)
+{
+    GArray *copy;
+    guint i;
+
+    if(!sources)
+        return NULL;
+
+    copy = g_array_sized_new(FALSE, TRUE, sizeof(SnapshotSource),
+                             sources->len);
+    for(i = 0; i < sources->len; ++i) {
+        SnapshotSource source = g_array_index(sources, SnapshotSource, i);
+
+        source.path = g_strdup(source.path);
+        g_array_append_val(copy, source);
+    }
+
+    return copy;
+}
+
+static BlconfChannel *
+blconf_channel_new(GNode *properties)
+{
+    BlconfChannel *channel = g_slice_new0(BlconfChannel);
+
+    if(!properties)
+        properties = blconf_proptree_new();
+
+    channel->properties = properties;
+    channel->journal_fd = -1;
+
+    return channel;
+}
+
 static void
 blconf_channel_destroy(BlconfChannel *channel)
 {
+    if(channel->save_id)
+        g_source_remove(channel->save_id);
+    if(channel->journal_fd >= 0)
+        close(channel->journal_fd);
+    if(channel->write_job)
+        channel->write_job->channel = NULL;
+    if(channel->sync_job)
+        channel->sync_job->channel = NULL;
+    if(channel->snapshot_job)
+        blconf_write_job_free(channel->snapshot_job);
+    g_free(channel->name);
+    blconf_snapshot_sources_free(channel->sources);
+    if(channel->lock_lists)
+        g_hash_table_unref(channel->lock_lists);
     blconf_proptree_destroy(channel->properties);
     g_slice_free(BlconfChannel, channel);
 }
 
+/* evaluates a lock expression for the current user, and remembers the
+ * verdict for the channel's snapshot */
+static gboolean
+blconf_channel_user_is_in_list(BlconfChannel *channel,
+                               const gchar *list)
+{
+    gboolean ret = blconf_user_is_in_list(list);
+
+    if(!channel->lock_lists) {
+        channel->lock_lists = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                    (GDestroyNotify)g_free,
+                                                    NULL);
+    }
+    g_hash_table_replace(channel->lock_lists, g_strdup(list),
+                         GINT_TO_POINTER(ret ? 1 : -1));
+
+    return ret;
+}
+
+/* drops what |property| owns; the property itself belongs to the arena */
 static void
 blconf_property_free(BlconfProperty *property)
 {
-    g_free(property->name);
+    if(property->children) {
+        g_hash_table_destroy(property->children);
+        property->children = NULL;
+    }
     if(G_VALUE_TYPE(&property->value))
-        g_value_unset(&property->value);
-    if(G_VALUE_TYPE(&property->system_value))
-        g_value_unset(&property->system_value);
-    g_slice_free(BlconfProperty, property);
+        blconf_property_value_unset(&property->value);
+    blconf_property_clear_system_value(property);
+    blconf_string_pool_unref(property->name);
+}
+
+/* the value a Get would return: the user value if there is one, the
+ * system value otherwise, or NULL if neither is set */
+static GValue *
+blconf_property_get_value(BlconfProperty *prop)
+{
+    if(G_VALUE_TYPE(&prop->value))
+        return &prop->value;
+
+    return prop->system_value;
+}
+
+static GValue *
+blconf_property_init_system_value(BlconfProperty *prop,
+                                  GType type)
+{
+    blconf_property_clear_system_value(prop);
+
+    prop->system_value = g_slice_new0(GValue);
+    g_value_init(prop->system_value, type);
+
+    return prop->system_value;
+}
+
+static void
+blconf_property_clear_system_value(BlconfProperty *prop)
+{
+    if(prop->system_value) {
+        if(G_VALUE_TYPE(prop->system_value))
+            blconf_property_value_unset(prop->system_value);
+        g_slice_free(GValue, prop->system_value);
+        prop->system_value = NULL;
+    }
+}
+
+/* swaps a string value for its pooled copy.  arrays are left alone;
+ * their strings are rarely shared, and they're rare themselves. */
+static void
+blconf_property_value_pool(GValue *value)
+{
+    const gchar *str;
+
+    if(G_VALUE_TYPE(value) != G_TYPE_STRING)
+        return;
+
+    str = g_value_get_string(value);
+    if(str && blconf_string_pool_lookup(str) != str)
+        g_value_set_static_string(value, blconf_string_pool_ref(str));
+}
+
+/* like g_value_unset(), but also gives back a pooled string */
+static void
+blconf_property_value_unset(GValue *value)
+{
+    if(G_VALUE_TYPE(value) == G_TYPE_STRING) {
+        const gchar *str = g_value_get_string(value);
+
+        /* a no-op for strings that were never pooled */
+        if(str)
+            blconf_string_pool_unref(str);
+    }
+
+    g_value_unset(value);
 }
 
 static gboolean
 blconf_backend_perchannel_xml_save_timeout(gpointer data)
 {
-    BLCONF_BACKEND_PERCHANNEL_XML(data)->save_id = 0;
-    blconf_backend_perchannel_xml_flush(BLCONF_BACKEND(data), NULL);
+    BlconfChannel *channel = data;
+    BlconfBackendPerchannelXml *xbpx = channel->xbpx;
+    gint64 now = g_get_monotonic_time();
+    gint64 due;
+
+    /* the channel may have changed again since the timer was armed; the
+     * save is due once it's been quiet for save_delay, or max_save_delay
+     * after the first unsaved change, whichever comes first */
+    due = MIN(channel->last_change + (gint64)xbpx->save_delay * 1000,
+              channel->dirty_since + (gint64)xbpx->max_save_delay * 1000);
+    if(now < due) {
+        channel->save_id = g_timeout_add((due - now + 999) / 1000,
+                                         blconf_backend_perchannel_xml_save_timeout,
+                                         channel);
+        return FALSE;
+    }
+
+    channel->save_id = 0;
+    blconf_backend_perchannel_xml_flush_channel(xbpx, channel);
 
     return FALSE;
 }
@@ -993,14 +2563,223 @@ static void
 blconf_backend_perchannel_xml_schedule_save(BlconfBackendPerchannelXml *xbpx,
                                             BlconfChannel *channel)
 {
-    if(xbpx->save_id)
-        g_source_remove(xbpx->save_id);
+    gint64 now = g_get_monotonic_time();
 
     channel->dirty = TRUE;
+    channel->last_change = now;
+
+    /* rather than restarting the timer on every change, the timeout
+     * re-arms itself if the channel changed while it was pending */
+    if(!channel->save_id) {
+        channel->dirty_since = now;
+        channel->save_id = g_timeout_add(MIN(xbpx->save_delay,
+                                             xbpx->max_save_delay),
+                                         blconf_backend_perchannel_xml_save_timeout,
+                                         channel);
+    }
+}
+
+static gsize
+blconf_gvalue_mem_size(const GValue *value)
+{
+    gsize size = 0;
+
+    if(G_VALUE_TYPE(value) == G_TYPE_STRING) {
+        const gchar *str = g_value_get_string(value);
+
+        if(str)
+            size += strlen(str) + 1;
+    } else if(G_VALUE_TYPE(value) == BLCONF_TYPE_G_VALUE_ARRAY) {
+        GPtrArray *arr = g_value_get_boxed(value);
+        guint i;
+
+        size += sizeof(GPtrArray) + arr->len * sizeof(gpointer);
+        for(i = 0; i < arr->len; ++i) {
+            size += sizeof(GValue)
+                    + blconf_gvalue_mem_size(g_ptr_array_index(arr, i));
+        }
+    }
+
+    return size;
+}
+
+static gboolean
+proptree_add_mem_size(GNode *node,
+                      gpointer data)
+{
+    BlconfProperty *prop = node->data;
+    gsize *size = data;
+
+    *size += PROPTREE_NODE_SIZE + blconf_gvalue_mem_size(&prop->value);
+    if(prop->system_value) {
+        *size += sizeof(GValue)
+                 + blconf_gvalue_mem_size(prop->system_value);
+    }
+
+    /* hash node, key and value per entry, give or take */
+    if(prop->children)
+        *size += g_hash_table_size(prop->children) * 3 * sizeof(gpointer);
+
+    return FALSE;
+}
+
+static gsize
+blconf_channel_mem_size(BlconfChannel *channel)
+{
+    /* removed nodes are still taking up space in the arena */
+    gsize size = sizeof(BlconfChannel)
+                 + PROPTREE_ARENA(channel->properties)->dead;
+
+    g_node_traverse(channel->properties, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+                    proptree_add_mem_size, &size);
+    channel->mem_size_stale = FALSE;
+
+    return size;
+}
+
+static gint
+blconf_channel_compare_last_used(gconstpointer a,
+                                 gconstpointer b)
+{
+    const BlconfChannel *channel_a = a, *channel_b = b;
+
+    if(channel_a->last_used < channel_b->last_used)
+        return -1;
+    else if(channel_a->last_used > channel_b->last_used)
+        return 1;
+
+    return 0;
+}
+
+/* drops channels that have been idle for longer than cache_timeout, and
+ * then the least recently used ones until we're within memory_budget.
+ * dirty channels are written out first, and only dropped on a later
+ * pass once that's done. */
+static void
+blconf_backend_perchannel_xml_evict_channels(BlconfBackendPerchannelXml *xbpx)
+{
+    GList *channels, *l;
+    gint64 now = g_get_monotonic_time();
+    guint64 total = 0;
+
+    channels = g_list_sort(g_hash_table_get_values(xbpx->channels),
+                           blconf_channel_compare_last_used);
+
+    for(l = channels; l; l = l->next) {
+        BlconfChannel *channel = l->data;
+
+        if(channel->mem_size_stale)
+            channel->mem_size = blconf_channel_mem_size(channel);
+        total += channel->mem_size;
+    }
+
+    for(l = channels; l; l = l->next) {
+        BlconfChannel *channel = l->data;
+        gboolean idle, over_budget;
+
+        idle = (xbpx->cache_timeout
+                && now - channel->last_used >= (gint64)xbpx->cache_timeout * 1000);
+        /* the most recently used channel always stays */
+        over_budget = (xbpx->memory_budget && total > xbpx->memory_budget
+                       && l->next);
+        if(!idle && !over_budget)
+            continue;
+
+        if(channel->write_job || channel->dirty) {
+            if(!channel->write_job)
+                blconf_backend_perchannel_xml_flush_channel(xbpx, channel);
+            continue;
+        }
+
+        DBG("evicting channel \"%s\" (%s)", channel->name,
+            idle ? "idle" : "over budget");
+
+        if(idle)
+            xbpx->n_idle_evictions++;
+        else
+            xbpx->n_budget_evictions++;
+        total -= channel->mem_size;
+
+        g_hash_table_remove(xbpx->channels, channel->name);
+    }
+
+    g_list_free(channels);
+
+    xbpx->memory_usage = total;
+}
+
+static gboolean
+blconf_backend_perchannel_xml_evict_timeout(gpointer data)
+{
+    BlconfBackendPerchannelXml *xbpx = data;
+
+    blconf_backend_perchannel_xml_evict_channels(xbpx);
+
+    if(!g_hash_table_size(xbpx->channels)) {
+        /* nothing left to watch; loading a channel restarts us */
+        xbpx->evict_id = 0;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_perchannel_xml_evict_idled(gpointer data)
+{
+    BlconfBackendPerchannelXml *xbpx = data;
+
+    xbpx->evict_idle_id = 0;
+    blconf_backend_perchannel_xml_evict_channels(xbpx);
+
+    return FALSE;
+}
 
-    xbpx->save_id = g_timeout_add_seconds(WRITE_TIMEOUT,
-                                          blconf_backend_perchannel_xml_save_timeout,
-                                          xbpx);
+static void
+blconf_backend_perchannel_xml_insert_channel(BlconfBackendPerchannelXml *xbpx,
+                                             const gchar *channel_name,
+                                             BlconfChannel *channel)
+{
+    channel->xbpx = xbpx;
+    channel->name = g_ascii_strdown(channel_name, -1);
+    channel->last_used = g_get_monotonic_time();
+    channel->mem_size = blconf_channel_mem_size(channel);
+    g_hash_table_insert(xbpx->channels, g_strdup(channel->name), channel);
+
+    if(channel->snapshot_job) {
+        blconf_backend_perchannel_xml_submit_write(xbpx, channel->snapshot_job);
+        channel->snapshot_job = NULL;
+    }
+
+    xbpx->memory_usage += channel->mem_size;
+
+    if(!xbpx->evict_id) {
+        xbpx->evict_id = g_timeout_add_seconds(EVICT_INTERVAL,
+                                               blconf_backend_perchannel_xml_evict_timeout,
+                                               xbpx);
+    }
+
+    if(xbpx->memory_budget && xbpx->memory_usage > xbpx->memory_budget
+       && !xbpx->evict_idle_id)
+    {
+        xbpx->evict_idle_id = g_idle_add(blconf_backend_perchannel_xml_evict_idled,
+                                         xbpx);
+    }
+}
+
+static BlconfChannel *
+blconf_backend_perchannel_xml_lookup_channel(BlconfBackendPerchannelXml *xbpx,
+                                             const gchar *channel_name)
+{
+    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
+
+    if(channel) {
+        channel->last_used = g_get_monotonic_time();
+        if(xbpx->preload_record)
+            blconf_backend_perchannel_xml_preload_record(xbpx, channel_name);
+    }
+
+    return channel;
 }
 
 static BlconfChannel *
@@ -1008,7 +2787,6 @@ blconf_backend_perchannel_xml_create_channel(BlconfBackendPerchannelXml *xbpx,
                                              const gchar *channel_name)
 {
     BlconfChannel *channel;
-    BlconfProperty *prop;
 
     channel = g_hash_table_lookup(xbpx->channels, channel_name);
     if(channel) {
@@ -1016,11 +2794,8 @@ blconf_backend_perchannel_xml_create_channel(BlconfBackendPerchannelXml *xbpx,
         return channel;
     }
 
-    channel = g_slice_new0(BlconfChannel);
-    prop = g_slice_new0(BlconfProperty);
-    prop->name = g_strdup("/");
-    channel->properties = g_node_new(prop);
-    g_hash_table_insert(xbpx->channels, g_ascii_strdown(channel_name, -1), channel);
+    channel = blconf_channel_new(NULL);
+    blconf_backend_perchannel_xml_insert_channel(xbpx, channel_name, channel);
 
     return channel;
 }
@@ -1096,9 +2871,11 @@ blconf_xml_handle_channel(XmlParserState *state,
         }
 
         if(unlocked && *unlocked)
-            locked_state = !blconf_user_is_in_list(unlocked);
+            locked_state = !blconf_channel_user_is_in_list(state->channel,
+                                                           unlocked);
         else if(locked && *locked)
-            locked_state = blconf_user_is_in_list(locked);
+            locked_state = blconf_channel_user_is_in_list(state->channel,
+                                                          locked);
 
         /* Policy:
          *   + If the channel was locked by a previous file, and this file
@@ -1122,13 +2899,8 @@ blconf_xml_handle_channel(XmlParserState *state,
             }
             return FALSE;
         } else if(!state->channel->locked && locked_state) {
-            BlconfProperty *prop;
-
             blconf_proptree_destroy(state->channel->properties);
-
-            prop = g_slice_new0(BlconfProperty);
-            prop->name = g_strdup("/");
-            state->channel->properties = g_node_new(prop);
+            state->channel->properties = blconf_proptree_new();
 
             state->channel->locked = TRUE;
         }
@@ -1218,9 +2990,8 @@ blconf_xml_handle_property(XmlParserState *state,
             /* when the channel is locked and we're in a system file, a new
              * property will always "win", even if it's "empty" */
             if(G_VALUE_TYPE(&prop->value))  /* shouldn't be set, but... */
-                g_value_unset(&prop->value);
-            if(G_VALUE_TYPE(&prop->system_value))
-                g_value_unset(&prop->system_value);
+                blconf_property_value_unset(&prop->value);
+            blconf_property_clear_system_value(prop);
         } else {
             GNode *pnode = blconf_proptree_add_property(state->channel->properties,
                                                         fullpath, NULL, NULL,
@@ -1238,13 +3009,12 @@ blconf_xml_handle_property(XmlParserState *state,
         if(prop) {
             /* new prop wins, regardless of previous state */
             if(G_VALUE_TYPE(&prop->value))
-                g_value_unset(&prop->value);
+                blconf_property_value_unset(&prop->value);
             if(state->is_system_file) {
                 /* we only clear this if we're in a system file.  if we're
                  * not, we want to remember the system value for reset
                  * purposes. */
-                if(G_VALUE_TYPE(&prop->system_value))
-                    g_value_unset(&prop->system_value);
+                blconf_property_clear_system_value(prop);
             }
         } else {
             GNode *pnode = blconf_proptree_add_property(state->channel->properties,
@@ -1278,9 +3048,11 @@ blconf_xml_handle_property(XmlParserState *state,
         } else {
             /* not locked already, but we have a lock/unlock directive */
             if(unlocked && *unlocked)
-                prop->locked = !blconf_user_is_in_list(unlocked);
+                prop->locked = !blconf_channel_user_is_in_list(state->channel,
+                                                               unlocked);
             else if(locked && *locked)
-                prop->locked = blconf_user_is_in_list(locked);
+                prop->locked = blconf_channel_user_is_in_list(state->channel,
+                                                              locked);
         }
     }
 
@@ -1300,13 +3072,13 @@ blconf_xml_handle_property(XmlParserState *state,
         return FALSE;
     }
 
-    if(state->is_system_file)
-        value_to_set = &prop->system_value;
-    else
-        value_to_set = &prop->value;
-
     if(G_TYPE_NONE != value_type) {
-        g_value_init(value_to_set, value_type);
+        if(state->is_system_file)
+            value_to_set = blconf_property_init_system_value(prop, value_type);
+        else {
+            value_to_set = &prop->value;
+            g_value_init(value_to_set, value_type);
+        }
         if(!_blconf_gvalue_from_string(value_to_set, value)) {
             if(error) {
                 g_set_error(error, G_MARKUP_ERROR,
@@ -1316,6 +3088,7 @@ blconf_xml_handle_property(XmlParserState *state,
             }
             return FALSE;
         }
+        blconf_property_value_pool(value_to_set);
 
         if(BLCONF_TYPE_G_VALUE_ARRAY == value_type) {
             /* FIXME: use stacks here */
@@ -1630,346 +3403,2741 @@ blconf_backend_perchannel_xml_merge_file(BlconfBackendPerchannelXml *xbpx,
     return ret;
 }
 
-static BlconfChannel *
-blconf_backend_perchannel_xml_load_channel(BlconfBackendPerchannelXml *xbpx,
-                                           const gchar *channel_name,
-                                           GError **error)
+static gint64
+blconf_stat_mtime(const struct stat *st)
 {
-    BlconfChannel *channel = NULL;
-    gchar *filename_stem, **filenames, *user_file;
-    gint i, length;
-    BlconfProperty *prop;
-
-    TRACE("entering");
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    return (gint64)st->st_mtime * G_GINT64_CONSTANT(1000000000)
+           + st->st_mtim.tv_nsec;
+#else
+    return (gint64)st->st_mtime * G_GINT64_CONSTANT(1000000000);
+#endif
+}
 
-    filename_stem = g_strdup_printf(CONFIG_FILE_FMT, channel_name);
-    filenames = xfce_resource_lookup_all(XFCE_RESOURCE_CONFIG, filename_stem);
-    user_file = xfce_resource_save_location(XFCE_RESOURCE_CONFIG,
-                                            filename_stem, FALSE);
-    g_free(filename_stem);
+static void
+blconf_snapshot_source_stat(SnapshotSource *source)
+{
+    struct stat st;
 
-    if((!filenames || !filenames[0]) && !user_file) {
-        if(error) {
-            g_set_error(error, BLCONF_ERROR,
-                        BLCONF_ERROR_CHANNEL_NOT_FOUND,
-                        _("Channel \"%s\" does not exist"), channel_name);
-        }
-        goto out;
+    if(!stat(source->path, &st)) {
+        source->mtime = blconf_stat_mtime(&st);
+        source->size = st.st_size;
+        source->inode = st.st_ino;
+    } else {
+        source->mtime = -1;
+        source->size = -1;
+        source->inode = 0;
     }
+}
+
+static void
+blconf_snapshot_sources_add(GArray *sources,
+                            const gchar *path)
+{
+    SnapshotSource source;
 
-    channel = g_slice_new0(BlconfChannel);
-    prop = g_slice_new0(BlconfProperty);
-    prop->name = g_strdup("/");
-    channel->properties = g_node_new(prop);
+    source.path = g_strdup(path);
+    blconf_snapshot_source_stat(&source);
+    g_array_append_val(sources, source);
+}
+
+/* returns the channel's source files in merge order, with the user file
+ * (if any) last */
+static GArray *
+blconf_snapshot_sources_new(gchar **filenames,
+                            const gchar *user_file)
+{
+    GArray *sources = g_array_new(FALSE, TRUE, sizeof(SnapshotSource));
+    gint i;
 
-    /* read in system files, we do this in reversed order to properly 
-     * follow the xdg spec, see bug #6079 for more information */
-    length = g_strv_length(filenames);
-    for(i = length - 1; i >= 0; --i) {
+    for(i = (filenames ? g_strv_length(filenames) : 0) - 1; i >= 0; --i) {
         if(!g_strcmp0(user_file, filenames[i]))
             continue;
-        blconf_backend_perchannel_xml_merge_file(xbpx, filenames[i], TRUE,
-                                                 channel, NULL);
+        blconf_snapshot_sources_add(sources, filenames[i]);
     }
 
-    if(!channel->locked && user_file) {
-        /* read in user file */
-        blconf_backend_perchannel_xml_merge_file(xbpx, user_file, FALSE,
-                                                 channel, NULL);
+    if(user_file)
+        blconf_snapshot_sources_add(sources, user_file);
+
+    return sources;
+}
+
+static gboolean
+blconf_snapshot_sources_equal(GArray *sources1,
+                              GArray *sources2)
+{
+    guint i;
+
+    if(!sources1 || !sources2 || sources1->len != sources2->len)
+        return FALSE;
+
+    for(i = 0; i < sources1->len; ++i) {
+        SnapshotSource *source1 = &g_array_index(sources1, SnapshotSource, i);
+        SnapshotSource *source2 = &g_array_index(sources2, SnapshotSource, i);
+
+        if(strcmp(source1->path, source2->path)
+           || source1->mtime != source2->mtime
+           || source1->size != source2->size
+           || source1->inode != source2->inode)
+        {
+            return FALSE;
+        }
     }
 
-    g_hash_table_insert(xbpx->channels, g_ascii_strdown(channel_name, -1), channel);
+    return TRUE;
+}
 
-out:
-    g_strfreev(filenames);
-    g_free(user_file);
+static guint32
+blconf_snapshot_checksum(const gchar *data,
+                         gsize length)
+{
+    /* 32-bit FNV-1a; we only need to catch truncated or torn files */
+    guint32 hash = 2166136261U;
 
-    return channel;
+    while(length--) {
+        hash ^= (guchar)*data++;
+        hash *= 16777619U;
+    }
+
+    return hash;
 }
 
-static gboolean
-blconf_format_xml_tag(GString *elem_str,
-                      GValue *value,
-                      gboolean is_array_value,
-                      gchar spaces[MAX_PROP_PATH],
-                      gboolean *is_array)
+static void
+blconf_snapshot_put_uint32(GByteArray *buf,
+                           guint32 val)
 {
-    gchar *tmp;
+    g_byte_array_append(buf, (const guint8 *)&val, sizeof(val));
+}
+
+static void
+blconf_snapshot_put_string(GByteArray *buf,
+                           const gchar *str)
+{
+    if(!str)
+        blconf_snapshot_put_uint32(buf, SNAPSHOT_NULL_STRING);
+    else {
+        guint32 len = strlen(str);
+
+        blconf_snapshot_put_uint32(buf, len);
+        g_byte_array_append(buf, (const guint8 *)str, len);
+    }
+}
+
+static void
+blconf_snapshot_put_value(GByteArray *buf,
+                          const GValue *value)
+{
+    union
+    {
+        guint8 u8;
+        guint16 u16;
+        guint32 u32;
+        guint64 u64;
+        gfloat f;
+        gdouble d;
+    } v;
+    guint8 tag;
+    gsize len;
 
     switch(G_VALUE_TYPE(value)) {
         case G_TYPE_STRING:
-            tmp = g_markup_escape_text(g_value_get_string(value), -1);
-            g_string_append_printf(elem_str, " type=\"string\" value=\"%s\"",
-                                   tmp);
-            g_free(tmp);
-            break;
+            tag = SNAPSHOT_TYPE_STRING;
+            g_byte_array_append(buf, &tag, 1);
+            blconf_snapshot_put_string(buf, g_value_get_string(value));
+            return;
 
         case G_TYPE_UCHAR:
-            g_string_append_printf(elem_str, " type=\"uchar\" value=\"%hhu\"",
-                                   g_value_get_uchar(value));
+            tag = SNAPSHOT_TYPE_UCHAR;
+            v.u8 = g_value_get_uchar(value);
+            len = sizeof(v.u8);
             break;
 
         case G_TYPE_CHAR:
-            g_string_append_printf(elem_str, " type=\"char\" value=\"%hhd\"",
-                                   g_value_get_uchar(value));
+            tag = SNAPSHOT_TYPE_CHAR;
+#if GLIB_CHECK_VERSION (2, 32, 0)
+            v.u8 = (guint8)g_value_get_schar(value);
+#else
+            v.u8 = (guint8)g_value_get_char(value);
+#endif
+            len = sizeof(v.u8);
             break;
 
         case G_TYPE_UINT:
-            g_string_append_printf(elem_str, " type=\"uint\" value=\"%u\"",
-                                   g_value_get_uint(value));
+            tag = SNAPSHOT_TYPE_UINT;
+            v.u32 = g_value_get_uint(value);
+            len = sizeof(v.u32);
             break;
 
         case G_TYPE_INT:
-            g_string_append_printf(elem_str, " type=\"int\" value=\"%d\"",
-                                   g_value_get_int(value));
+            tag = SNAPSHOT_TYPE_INT;
+            v.u32 = (guint32)g_value_get_int(value);
+            len = sizeof(v.u32);
             break;
 
         case G_TYPE_UINT64:
-            g_string_append_printf(elem_str, " type=\"uint64\" value=\"%" G_GUINT64_FORMAT "\"",
-                                   g_value_get_uint64(value));
+            tag = SNAPSHOT_TYPE_UINT64;
+            v.u64 = g_value_get_uint64(value);
+            len = sizeof(v.u64);
             break;
 
         case G_TYPE_INT64:
-            g_string_append_printf(elem_str, " type=\"int64\" value=\"%" G_GINT64_FORMAT "\"",
-                                   g_value_get_int64(value));
+            tag = SNAPSHOT_TYPE_INT64;
+            v.u64 = (guint64)g_value_get_int64(value);
+            len = sizeof(v.u64);
             break;
 
         case G_TYPE_FLOAT:
-            g_string_append_printf(elem_str, " type=\"float\" value=\"%f\"",
-                                   (gdouble)g_value_get_float(value));
+            tag = SNAPSHOT_TYPE_FLOAT;
+            v.f = g_value_get_float(value);
+            len = sizeof(v.f);
             break;
 
         case G_TYPE_DOUBLE:
-            g_string_append_printf(elem_str, " type=\"double\" value=\"%f\"",
-                                   g_value_get_double(value));
+            tag = SNAPSHOT_TYPE_DOUBLE;
+            v.d = g_value_get_double(value);
+            len = sizeof(v.d);
             break;
 
         case G_TYPE_BOOLEAN:
-            g_string_append_printf(elem_str, " type=\"bool\" value=\"%s\"",
-                                   g_value_get_boolean(value) ? "true" : "false");
+            tag = SNAPSHOT_TYPE_BOOLEAN;
+            v.u8 = g_value_get_boolean(value) ? 1 : 0;
+            len = sizeof(v.u8);
             break;
 
         default:
-            if(G_VALUE_TYPE(value) == G_TYPE_STRV) {
-                gchar **strlist;
-                gint i;
-
-                /* we shouldn't get here anymore, i think */
-                g_critical("Got G_TYPE_STRV.  Shouldn't happen anymore, right?");
-
-                if(is_array_value)
-                    return FALSE;
-
-                g_string_append(elem_str, " type=\"array\">\n");
-
-                strlist = g_value_get_boxed(value);
-                for(i = 0; strlist[i]; ++i) {
-                    gchar *value_str = g_markup_escape_text(strlist[i], -1);
-                    g_string_append_printf(elem_str,
-                                           "%s  <value type=\"string\" value=\"%s\"/>\n",
-                                           spaces, value_str);
-                    g_free(value_str);
-                }
-
-                *is_array = TRUE;
-            } else if(BLCONF_TYPE_G_VALUE_ARRAY == G_VALUE_TYPE(value)) {
-                GPtrArray *arr;
+            if(G_VALUE_TYPE(value) == BLCONF_TYPE_UINT16) {
+                tag = SNAPSHOT_TYPE_UINT16;
+                v.u16 = blconf_g_value_get_uint16(value);
+                len = sizeof(v.u16);
+            } else if(G_VALUE_TYPE(value) == BLCONF_TYPE_INT16) {
+                tag = SNAPSHOT_TYPE_INT16;
+                v.u16 = (guint16)blconf_g_value_get_int16(value);
+                len = sizeof(v.u16);
+            } else if(G_VALUE_TYPE(value) == BLCONF_TYPE_G_VALUE_ARRAY) {
+                GPtrArray *arr = g_value_get_boxed(value);
                 guint i;
-                
-                if(is_array_value)
-                    return FALSE;
-
-                g_string_append(elem_str, " type=\"array\">\n");
-
-                arr = g_value_get_boxed(value);
-                for(i = 0; i < arr->len; ++i) {
-                    GValue *value1 = g_ptr_array_index(arr, i);
-                    gboolean dummy;
 
-                    g_string_append_printf(elem_str, "%s  <value", spaces);
-                    if(!blconf_format_xml_tag(elem_str, value1, TRUE, spaces,
-                                              &dummy))
-                    {
-                        return FALSE;
-                    }
-                    g_string_append(elem_str, "/>\n");
+                tag = SNAPSHOT_TYPE_ARRAY;
+                g_byte_array_append(buf, &tag, 1);
+                blconf_snapshot_put_uint32(buf, arr->len);
+                for(i = 0; i < arr->len; ++i)
+                    blconf_snapshot_put_value(buf, g_ptr_array_index(arr, i));
+                return;
+            } else if(G_VALUE_TYPE(value) == G_TYPE_STRV) {
+                gchar **strlist = g_value_get_boxed(value);
+                guint i, n = strlist ? g_strv_length(strlist) : 0;
+
+                /* the xml writer turns these into an array of strings,
+                 * so store it the way it'll come back after a reload */
+                tag = SNAPSHOT_TYPE_ARRAY;
+                g_byte_array_append(buf, &tag, 1);
+                blconf_snapshot_put_uint32(buf, n);
+                for(i = 0; i < n; ++i) {
+                    tag = SNAPSHOT_TYPE_STRING;
+                    g_byte_array_append(buf, &tag, 1);
+                    blconf_snapshot_put_string(buf, strlist[i]);
                 }
-
-                *is_array = TRUE;
+                return;
             } else {
-                if(is_array_value)
-                    return FALSE;
-
-                if(G_VALUE_TYPE(value) != G_TYPE_INVALID) {
-                    g_warning("Unknown value type %d (\"%s\"), treating as branch",
-                              (int)G_VALUE_TYPE(value), G_VALUE_TYPE_NAME(value));
-                    g_value_unset(value);
-                }
-
-                is_array = FALSE;
-                g_string_append(elem_str, " type=\"empty\"");
+                /* empty, or something the xml writer would treat as a
+                 * branch as well */
+                tag = SNAPSHOT_TYPE_NONE;
+                len = 0;
             }
             break;
     }
 
-    return TRUE;
+    g_byte_array_append(buf, &tag, 1);
+    if(len)
+        g_byte_array_append(buf, (const guint8 *)&v, len);
 }
 
-static gboolean
-blconf_backend_perchannel_xml_write_node(BlconfBackendPerchannelXml *xbpx,
-                                         FILE *fp,
-                                         GNode *node,
-                                         gint depth,
-                                         GError **error)
+static void
+blconf_snapshot_put_node(GByteArray *buf,
+                         GNode *node)
 {
     BlconfProperty *prop = node->data;
-    GValue *value = &prop->value;
-    GString *elem_str;
-    gchar spaces[MAX_PROP_PATH];
+    guint8 flags = prop->locked ? SNAPSHOT_PROPERTY_LOCKED : 0;
+    GValue no_value = { 0, };
     GNode *child;
-    gchar *escaped_name;
-    gboolean is_array = FALSE;
-    
-    if(depth * 2 > (gint) sizeof(spaces) + 1)
-        depth = sizeof(spaces) / 2 - 1;
-
-    memset(spaces, ' ', depth * 2);
-    spaces[depth * 2] = 0;
-
-    escaped_name = g_markup_escape_text(prop->name, strlen(prop->name));
-
-    elem_str = g_string_sized_new(128);
-    g_string_append_printf(elem_str, "%s<property name=\"%s\"", spaces,
-                           escaped_name);
 
-    g_free (escaped_name);
-
-    if(!blconf_format_xml_tag(elem_str, value, FALSE, spaces, &is_array)) {
-        /* _flush_channel() will handle |error| */
-        g_string_free(elem_str, TRUE);
-        return FALSE;
-    }
+    blconf_snapshot_put_string(buf, prop->name);
+    g_byte_array_append(buf, &flags, 1);
+    blconf_snapshot_put_value(buf, &prop->value);
+    blconf_snapshot_put_value(buf, prop->system_value ? prop->system_value
+                                                      : &no_value);
+    blconf_snapshot_put_uint32(buf, g_node_n_children(node));
 
-    child = g_node_first_child(node);
-    if(!is_array) {
-        if(child)
-            g_string_append(elem_str, ">\n");
-        else
-            g_string_append(elem_str, "/>\n");
+    for(child = g_node_first_child(node);
+        child;
+        child = g_node_next_sibling(child))
+    {
+        blconf_snapshot_put_node(buf, child);
     }
+}
 
-    if(fputs(elem_str->str, fp) == EOF) {
-        /* _flush_channel() will handle |error| */
-        g_string_free(elem_str, TRUE);
+static gboolean
+blconf_snapshot_get(SnapshotReader *reader,
+                    gpointer dest,
+                    gsize len)
+{
+    if((gsize)(reader->end - reader->p) < len)
         return FALSE;
-    }
-    g_string_free(elem_str, TRUE);
-
-    for(; child; child = g_node_next_sibling(child)) {
-        if(!blconf_backend_perchannel_xml_write_node(xbpx, fp, child,
-                                                     depth + 1, error))
-        {
-            /* _flush_channel() will handle |error| */
-            return FALSE;
-        }
-    }
 
-    if(is_array || g_node_first_child(node)) {
-        if(fputs(spaces, fp) == EOF || fputs("</property>\n", fp) == EOF) {
-            /* _flush_channel() will handle |error| */
-            return FALSE;
-        }
-    }
+    memcpy(dest, reader->p, len);
+    reader->p += len;
 
     return TRUE;
 }
 
 static gboolean
-blconf_backend_perchannel_xml_flush_channel(BlconfBackendPerchannelXml *xbpx,
-                                            const gchar *channel_name,
-                                            GError **error)
+blconf_snapshot_get_uint32(SnapshotReader *reader,
+                           guint32 *val)
 {
-    gboolean ret = FALSE;
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
-    GNode *child;
-    gchar *filename = NULL, *filename_tmp = NULL;
-    FILE *fp = NULL;
+    return blconf_snapshot_get(reader, val, sizeof(*val));
+}
 
-    DBG("Flushed dirty channel \"%s\"", channel_name);
+static gboolean
+blconf_snapshot_get_string(SnapshotReader *reader,
+                           gchar **str)
+{
+    guint32 len;
 
-    if(!channel) {
-        if(error) {
-            g_set_error(error, BLCONF_ERROR,
-                        BLCONF_ERROR_CHANNEL_NOT_FOUND,
-                        _("Channel \"%s\" does not exist"), channel_name);
-        }
+    if(!blconf_snapshot_get_uint32(reader, &len))
         return FALSE;
+
+    if(len == SNAPSHOT_NULL_STRING) {
+        *str = NULL;
+        return TRUE;
     }
 
-    filename = g_strdup_printf("%s/%s.xml", xbpx->config_save_path, channel_name);
-    filename_tmp = g_strconcat(filename, ".new", NULL);
+    if((gsize)(reader->end - reader->p) < len)
+        return FALSE;
 
-    fp = fopen(filename_tmp, "w");
-    if(!fp)
-        goto out;
+    *str = g_strndup(reader->p, len);
+    reader->p += len;
 
-    if(fputs("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\n", fp) == EOF
-       || fprintf(fp, "<channel name=\"%s\" version=\"%s.%s\">\n", channel_name,
-                  FILE_VERSION_MAJOR, FILE_VERSION_MINOR) < 0)
-    {
-        goto out;
-    }
+    return TRUE;
+}
 
-    for(child = g_node_first_child(channel->properties);
-        child;
-        child = g_node_next_sibling(child))
+/* on failure, |value| is left unset */
+static gboolean
+blconf_snapshot_get_value(SnapshotReader *reader,
+                          GValue *value,
+                          gboolean is_array_value)
+{
+    union
     {
-        if(!blconf_backend_perchannel_xml_write_node(xbpx, fp, child, 1, error))
-            goto out;
-    }
+        guint8 u8;
+        guint16 u16;
+        guint32 u32;
+        guint64 u64;
+        gfloat f;
+        gdouble d;
+    } v;
+    guint8 tag;
+
+    if(!blconf_snapshot_get(reader, &tag, 1))
+        return FALSE;
 
-    if(fputs("</channel>\n", fp) == EOF)
-        goto out;
+    switch(tag) {
+        case SNAPSHOT_TYPE_NONE:
+            /* array elements always have a value */
+            return !is_array_value;
 
-    if(fflush(fp))
-        goto out;
+        case SNAPSHOT_TYPE_STRING: {
+            gchar *str;
 
-#if defined(HAVE_FDATASYNC)
-    if(fdatasync(fileno(fp)))
-        goto out;
-#elif defined(HAVE_FSYNC)
-    if(fsync(fileno(fp)))
+            if(!blconf_snapshot_get_string(reader, &str))
+                return FALSE;
+            g_value_init(value, G_TYPE_STRING);
+            g_value_take_string(value, str);
+            return TRUE;
+        }
+
+        case SNAPSHOT_TYPE_UCHAR:
+            if(!blconf_snapshot_get(reader, &v.u8, sizeof(v.u8)))
+                return FALSE;
+            g_value_set_uchar(g_value_init(value, G_TYPE_UCHAR), v.u8);
+            return TRUE;
+
+        case SNAPSHOT_TYPE_CHAR:
+            if(!blconf_snapshot_get(reader, &v.u8, sizeof(v.u8)))
+                return FALSE;
+#if GLIB_CHECK_VERSION (2, 32, 0)
+            g_value_set_schar(g_value_init(value, G_TYPE_CHAR), (gint8)v.u8);
+#else
+            g_value_set_char(g_value_init(value, G_TYPE_CHAR), (gchar)v.u8);
+#endif
+            return TRUE;
+
+        case SNAPSHOT_TYPE_UINT16:
+            if(!blconf_snapshot_get(reader, &v.u16, sizeof(v.u16)))
+                return FALSE;
+            blconf_g_value_set_uint16(g_value_init(value, BLCONF_TYPE_UINT16),
+                                      v.u16);
+            return TRUE;
+
+        case SNAPSHOT_TYPE_INT16:
+            if(!blconf_snapshot_get(reader, &v.u16, sizeof(v.u16)))
+                return FALSE;
+            blconf_g_value_set_int16(g_value_init(value, BLCONF_TYPE_INT16),
+                                     (gint16)v.u16);
+            return TRUE;
+
+        case SNAPSHOT_TYPE_UINT:
+            if(!blconf_snapshot_get(reader, &v.u32, sizeof(v.u32)))
+                return FALSE;
+            g_value_set_uint(g_value_init(value, G_TYPE_UINT), v.u32);
+            return TRUE;
+
+        case SNAPSHOT_TYPE_INT:
+            if(!blconf_snapshot_get(reader, &v.u32, sizeof(v.u32)))
+                return FALSE;
+            g_value_set_int(g_value_init(value, G_TYPE_INT), (gint32)v.u32);
+            return TRUE;
+
+        case SNAPSHOT_TYPE_UINT64:
+            if(!blconf_snapshot_get(reader, &v.u64, sizeof(v.u64)))
+                return FALSE;
+            g_value_set_uint64(g_value_init(value, G_TYPE_UINT64), v.u64);
+            return TRUE;
+
+        case SNAPSHOT_TYPE_INT64:
+            if(!blconf_snapshot_get(reader, &v.u64, sizeof(v.u64)))
+                return FALSE;
+            g_value_set_int64(g_value_init(value, G_TYPE_INT64), (gint64)v.u64);
+            return TRUE;
+
+        case SNAPSHOT_TYPE_FLOAT:
+            if(!blconf_snapshot_get(reader, &v.f, sizeof(v.f)))
+                return FALSE;
+            g_value_set_float(g_value_init(value, G_TYPE_FLOAT), v.f);
+            return TRUE;
+
+        case SNAPSHOT_TYPE_DOUBLE:
+            if(!blconf_snapshot_get(reader, &v.d, sizeof(v.d)))
+                return FALSE;
+            g_value_set_double(g_value_init(value, G_TYPE_DOUBLE), v.d);
+            return TRUE;
+
+        case SNAPSHOT_TYPE_BOOLEAN:
+            if(!blconf_snapshot_get(reader, &v.u8, sizeof(v.u8)))
+                return FALSE;
+            g_value_set_boolean(g_value_init(value, G_TYPE_BOOLEAN), v.u8 != 0);
+            return TRUE;
+
+        case SNAPSHOT_TYPE_ARRAY: {
+            GPtrArray *arr;
+            guint32 n, i;
+
+            /* arrays don't nest, and each element takes at least a byte */
+            if(is_array_value
+               || !blconf_snapshot_get_uint32(reader, &v.u32)
+               || v.u32 > (gsize)(reader->end - reader->p))
+            {
+                return FALSE;
+            }
+            n = v.u32;
+
+            arr = g_ptr_array_sized_new(n);
+            g_value_init(value, BLCONF_TYPE_G_VALUE_ARRAY);
+            g_value_take_boxed(value, arr);
+
+            for(i = 0; i < n; ++i) {
+                GValue *val = g_new0(GValue, 1);
+
+                if(!blconf_snapshot_get_value(reader, val, TRUE)) {
+                    g_free(val);
+                    g_value_unset(value);
+                    return FALSE;
+                }
+                g_ptr_array_add(arr, val);
+            }
+
+            return TRUE;
+        }
+
+        default:
+            return FALSE;
+    }
+}
+
+/* reads a node into |parent|, or into the root of |proptree| if |parent|
+ * is NULL.  nodes are linked in as soon as they're created, so on failure
+ * the caller only has to destroy |proptree|. */
+static gboolean
+blconf_snapshot_get_node(SnapshotReader *reader,
+                         GNode *proptree,
+                         GNode *parent,
+                         gint depth)
+{
+    BlconfProperty *prop;
+    GNode *node;
+    gchar *name = NULL;
+    GValue system_value = { 0, };
+    guint8 flags;
+    guint32 n_children, i;
+
+    if(depth > SNAPSHOT_MAX_DEPTH)
+        return FALSE;
+
+    if(!blconf_snapshot_get_string(reader, &name) || !name)
+        return FALSE;
+
+    if(!parent) {
+        if(strcmp(name, "/")) {
+            g_free(name);
+            return FALSE;
+        }
+        node = proptree;
+    } else {
+        node = blconf_proptree_node_new(proptree, name);
+        blconf_proptree_append_child(parent, node);
+    }
+    prop = node->data;
+    g_free(name);
+
+    if(!blconf_snapshot_get(reader, &flags, 1)
+       || !blconf_snapshot_get_value(reader, &prop->value, FALSE)
+       || !blconf_snapshot_get_value(reader, &system_value, FALSE)
+       || !blconf_snapshot_get_uint32(reader, &n_children))
+    {
+        if(G_VALUE_TYPE(&system_value))
+            g_value_unset(&system_value);
+        return FALSE;
+    }
+
+    blconf_property_value_pool(&prop->value);
+    if(G_VALUE_TYPE(&system_value)) {
+        /* hand the value over as is, without copying it */
+        prop->system_value = g_slice_new(GValue);
+        *prop->system_value = system_value;
+        blconf_property_value_pool(prop->system_value);
+    }
+
+    prop->locked = (flags & SNAPSHOT_PROPERTY_LOCKED) ? TRUE : FALSE;
+
+    for(i = 0; i < n_children; ++i) {
+        if(!blconf_snapshot_get_node(reader, proptree, node, depth + 1))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* |snapshot_mtime| is when the snapshot was written.  a file modified in
+ * that same instant might have changed again right after the snapshot
+ * took its stat() of it, without anything we look at changing, so such a
+ * file never matches (the snapshot is racily clean, as git calls it) */
+static gboolean
+blconf_snapshot_source_matches(SnapshotReader *reader,
+                               const SnapshotSource *source,
+                               gint64 snapshot_mtime)
+{
+    gchar *path = NULL;
+    gint64 mtime, size;
+    guint64 inode;
+    gboolean ret;
+
+    ret = (blconf_snapshot_get_string(reader, &path)
+           && path && !strcmp(path, source->path)
+           && blconf_snapshot_get(reader, &mtime, sizeof(mtime))
+           && blconf_snapshot_get(reader, &size, sizeof(size))
+           && blconf_snapshot_get(reader, &inode, sizeof(inode))
+           && mtime == source->mtime
+           && size == source->size
+           && inode == source->inode
+           && (size < 0 || mtime < snapshot_mtime));
+    g_free(path);
+
+    return ret;
+}
+
+/* group membership can come from anywhere NSS looks (LDAP and such), so
+ * rather than trying to tell whether it changed, every lock expression
+ * the snapshot's verdicts depend on is evaluated again.  the verdicts are
+ * added to |lock_lists| as they're read. */
+static gboolean
+blconf_snapshot_lock_lists_match(SnapshotReader *reader,
+                                 GHashTable *lock_lists)
+{
+    guint32 n_lock_lists, i;
+
+    if(!blconf_snapshot_get_uint32(reader, &n_lock_lists))
+        return FALSE;
+
+    for(i = 0; i < n_lock_lists; ++i) {
+        gchar *list = NULL;
+        guint8 verdict;
+
+        if(!blconf_snapshot_get_string(reader, &list) || !list
+           || !blconf_snapshot_get(reader, &verdict, 1)
+           || !!verdict != !!blconf_user_is_in_list(list))
+        {
+            g_free(list);
+            return FALSE;
+        }
+
+        g_hash_table_replace(lock_lists, list,
+                             GINT_TO_POINTER(verdict ? 1 : -1));
+    }
+
+    return TRUE;
+}
+
+static gchar *
+blconf_backend_perchannel_xml_snapshot_filename(BlconfBackendPerchannelXml *xbpx,
+                                                const gchar *channel_name)
+{
+    gchar *lower = g_ascii_strdown(channel_name, -1);
+    gchar *filename = g_strdup_printf(SNAPSHOT_FILE_FMT,
+                                      xbpx->cache_save_path, lower);
+
+    g_free(lower);
+
+    return filename;
+}
+
+/* maps the channel's snapshot and rebuilds the proptree from it, as long
+ * as it was written from exactly |sources|.  returns NULL (and the caller
+ * should fall back to the xml files) if there's no usable snapshot. */
+static BlconfChannel *
+blconf_backend_perchannel_xml_load_snapshot(BlconfBackendPerchannelXml *xbpx,
+                                            const gchar *channel_name,
+                                            GArray *sources)
+{
+    BlconfChannel *channel = NULL;
+    GMappedFile *mmap_file;
+    SnapshotReader reader;
+    gchar *filename, magic[4];
+    guint32 version, checksum, flags, n_sources, i;
+    GNode *properties;
+    GHashTable *lock_lists = NULL;
+    struct stat st;
+
+    if(!xbpx->cache_save_path)
+        return NULL;
+
+    filename = blconf_backend_perchannel_xml_snapshot_filename(xbpx,
+                                                               channel_name);
+    if(stat(filename, &st)) {
+        g_free(filename);
+        return NULL;
+    }
+    mmap_file = g_mapped_file_new(filename, FALSE, NULL);
+    g_free(filename);
+    if(!mmap_file)
+        return NULL;
+
+    reader.p = g_mapped_file_get_contents(mmap_file);
+    reader.end = reader.p + g_mapped_file_get_length(mmap_file);
+
+    /* the version is stored in host byte order, so this also rejects
+     * snapshots written on a machine with a different endianness */
+    if(!blconf_snapshot_get(&reader, magic, sizeof(magic))
+       || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic))
+       || !blconf_snapshot_get_uint32(&reader, &version)
+       || version != SNAPSHOT_VERSION
+       || !blconf_snapshot_get_uint32(&reader, &checksum)
+       || checksum != blconf_snapshot_checksum(reader.p, reader.end - reader.p)
+       || !blconf_snapshot_get_uint32(&reader, &flags)
+       || !blconf_snapshot_get_uint32(&reader, &n_sources)
+       || n_sources != sources->len)
+    {
+        DBG("snapshot for channel \"%s\" is invalid", channel_name);
+        goto out;
+    }
+
+    for(i = 0; i < n_sources; ++i) {
+        if(!blconf_snapshot_source_matches(&reader,
+                                           &g_array_index(sources,
+                                                          SnapshotSource, i),
+                                           blconf_stat_mtime(&st)))
+        {
+            DBG("snapshot for channel \"%s\" is stale", channel_name);
+            goto out;
+        }
+    }
+
+    lock_lists = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       (GDestroyNotify)g_free, NULL);
+    if(!blconf_snapshot_lock_lists_match(&reader, lock_lists)) {
+        DBG("locks of channel \"%s\" changed since its snapshot",
+            channel_name);
+        goto out;
+    }
+
+    properties = blconf_proptree_new();
+    if(!blconf_snapshot_get_node(&reader, properties, NULL, 0)
+       || reader.p != reader.end)
+    {
+        blconf_proptree_destroy(properties);
         goto out;
+    }
+
+    channel = blconf_channel_new(properties);
+    channel->locked = (flags & SNAPSHOT_CHANNEL_LOCKED) ? TRUE : FALSE;
+    if(g_hash_table_size(lock_lists)) {
+        channel->lock_lists = lock_lists;
+        lock_lists = NULL;
+    }
+
+out:
+    if(lock_lists)
+        g_hash_table_unref(lock_lists);
+    g_mapped_file_unref(mmap_file);
+
+    return channel;
+}
+
+/* |user_file| is the user file that was just rewritten, if any; its new
+ * stat info replaces the one recorded in |sources|.  this only touches
+ * its arguments, so the writer thread can use it. */
+static void
+blconf_snapshot_write(const gchar *filename,
+                      GArray *sources,
+                      gboolean locked,
+                      GHashTable *lock_lists,
+                      GNode *properties,
+                      const gchar *user_file)
+{
+    GByteArray *buf;
+    guint32 checksum;
+    guint i;
+    GError *error = NULL;
+
+    if(!sources) {
+        unlink(filename);
+        return;
+    }
+
+    if(user_file) {
+        SnapshotSource *source = &g_array_index(sources, SnapshotSource,
+                                                sources->len - 1);
+        struct stat st;
+
+        blconf_snapshot_source_stat(source);
+        if(stat(user_file, &st) || source->inode != (guint64)st.st_ino) {
+            /* we wrote a file the channel wasn't loaded from, so we
+             * can't key the snapshot reliably */
+            unlink(filename);
+            return;
+        }
+    }
+
+    buf = g_byte_array_sized_new(4096);
+    g_byte_array_append(buf, (const guint8 *)SNAPSHOT_MAGIC, 4);
+    blconf_snapshot_put_uint32(buf, SNAPSHOT_VERSION);
+    blconf_snapshot_put_uint32(buf, 0);  /* checksum, filled in below */
+    blconf_snapshot_put_uint32(buf, locked ? SNAPSHOT_CHANNEL_LOCKED : 0);
+    blconf_snapshot_put_uint32(buf, sources->len);
+
+    for(i = 0; i < sources->len; ++i) {
+        SnapshotSource *source = &g_array_index(sources, SnapshotSource, i);
+
+        blconf_snapshot_put_string(buf, source->path);
+        g_byte_array_append(buf, (const guint8 *)&source->mtime,
+                            sizeof(source->mtime));
+        g_byte_array_append(buf, (const guint8 *)&source->size,
+                            sizeof(source->size));
+        g_byte_array_append(buf, (const guint8 *)&source->inode,
+                            sizeof(source->inode));
+    }
+
+    blconf_snapshot_put_uint32(buf, lock_lists ? g_hash_table_size(lock_lists) : 0);
+    if(lock_lists) {
+        GHashTableIter iter;
+        gpointer list, verdict;
+
+        g_hash_table_iter_init(&iter, lock_lists);
+        while(g_hash_table_iter_next(&iter, &list, &verdict)) {
+            guint8 matched = GPOINTER_TO_INT(verdict) > 0;
+
+            blconf_snapshot_put_string(buf, list);
+            g_byte_array_append(buf, &matched, 1);
+        }
+    }
+
+    blconf_snapshot_put_node(buf, properties);
+
+    checksum = blconf_snapshot_checksum((const gchar *)buf->data + SNAPSHOT_CHECKSUM_OFFSET + sizeof(checksum),
+                                        buf->len - SNAPSHOT_CHECKSUM_OFFSET - sizeof(checksum));
+    memcpy(buf->data + SNAPSHOT_CHECKSUM_OFFSET, &checksum, sizeof(checksum));
+
+    if(!g_file_set_contents(filename, (const gchar *)buf->data, buf->len,
+                            &error))
+    {
+        DBG("Unable to write snapshot \"%s\": %s", filename, error->message);
+        g_error_free(error);
+        unlink(filename);
+    }
+
+    g_byte_array_free(buf, TRUE);
+}
+
+/* a job that only writes the snapshot of a channel that was just read
+ * from its xml files, with the tree as it is now.  this doesn't touch
+ * anything shared, so it can be made off the main thread. */
+static BlconfWriteJob *
+blconf_backend_perchannel_xml_snapshot_job(BlconfBackendPerchannelXml *xbpx,
+                                           const gchar *channel_name,
+                                           BlconfChannel *channel)
+{
+    BlconfWriteJob *job;
+
+    if(!xbpx->cache_save_path)
+        return NULL;
+
+    job = g_slice_new0(BlconfWriteJob);
+    job->channel_name = g_ascii_strdown(channel_name, -1);
+    job->snapshot_filename = blconf_backend_perchannel_xml_snapshot_filename(xbpx,
+                                                                             channel_name);
+    job->properties = blconf_proptree_copy(channel->properties, FALSE);
+    job->sources = blconf_snapshot_sources_copy(channel->sources);
+    if(channel->lock_lists)
+        job->lock_lists = g_hash_table_ref(channel->lock_lists);
+    job->locked = channel->locked;
+
+    return job;
+}
+
+static gchar *
+blconf_backend_perchannel_xml_journal_filename(BlconfBackendPerchannelXml *xbpx,
+                                               const gchar *channel_name)
+{
+    gchar *lower = g_ascii_strdown(channel_name, -1);
+    gchar *filename = g_strdup_printf(JOURNAL_FILE_FMT,
+                                      xbpx->config_save_path, lower);
+
+    g_free(lower);
+
+    return filename;
+}
+
+static gboolean
+blconf_journal_write_all(gint fd,
+                         const guint8 *data,
+                         gsize length)
+{
+    while(length) {
+        gssize n = write(fd, data, length);
+
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            return FALSE;
+        }
+
+        data += n;
+        length -= n;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+blconf_journal_sync_fd(gint fd)
+{
+#if defined(HAVE_FDATASYNC)
+    return !fdatasync(fd);
+#elif defined(HAVE_FSYNC)
+    return !fsync(fd);
 #else
     sync();
+    return TRUE;
 #endif
+}
 
-    if(fclose(fp)) {
-        fp = NULL;
-        goto out;
+/* adds a journal record for one change to |buf| */
+static void
+blconf_journal_put_record(GByteArray *buf,
+                          JournalOp op,
+                          const gchar *property,
+                          const GValue *value)
+{
+    guint8 op_byte = op;
+    guint32 length, checksum;
+    gsize record_start;
+
+    /* record: payload length, payload checksum, then the payload */
+    record_start = buf->len;
+    blconf_snapshot_put_uint32(buf, 0);
+    blconf_snapshot_put_uint32(buf, 0);
+    g_byte_array_append(buf, &op_byte, 1);
+    blconf_snapshot_put_string(buf, property);
+    if(op == JOURNAL_OP_SET)
+        blconf_snapshot_put_value(buf, value);
+
+    length = buf->len - record_start - JOURNAL_RECORD_HEADER_LEN;
+    checksum = blconf_snapshot_checksum((const gchar *)buf->data + record_start + JOURNAL_RECORD_HEADER_LEN,
+                                        length);
+    memcpy(buf->data + record_start, &length, sizeof(length));
+    memcpy(buf->data + record_start + sizeof(length), &checksum,
+           sizeof(checksum));
+}
+
+/* appends |records| to the channel's journal with a single write.  getting
+ * them onto the disk is up to blconf_backend_perchannel_xml_journal_sync().
+ * |records| may be modified. */
+static gboolean
+blconf_backend_perchannel_xml_journal_append(BlconfBackendPerchannelXml *xbpx,
+                                             BlconfChannel *channel,
+                                             GByteArray *records)
+{
+    gboolean ret = FALSE;
+
+    if(channel->journal_fd < 0) {
+        gchar *filename = blconf_backend_perchannel_xml_journal_filename(xbpx,
+                                                                         channel->name);
+        struct stat st;
+
+        channel->journal_fd = open(filename, O_WRONLY | O_APPEND | O_CREAT,
+                                   0600);
+        g_free(filename);
+        if(channel->journal_fd < 0)
+            return FALSE;
+
+        /* the channel may have been cached as having no files */
+        blconf_backend_perchannel_xml_invalidate_resolved(xbpx, channel->name);
+        blconf_backend_perchannel_xml_registry_update(xbpx, channel->name,
+                                                      ".journal", TRUE);
+
+        if(fstat(channel->journal_fd, &st)) {
+            close(channel->journal_fd);
+            channel->journal_fd = -1;
+            return FALSE;
+        }
+        channel->journal_size = st.st_size;
     }
-    fp = NULL;
 
-    if(rename(filename_tmp, filename))
+    if(channel->journal_size == 0) {
+        guint32 version = JOURNAL_VERSION;
+        guint8 header[4 + sizeof(version)];
+
+        memcpy(header, JOURNAL_MAGIC, 4);
+        memcpy(header + 4, &version, sizeof(version));
+        g_byte_array_prepend(records, header, sizeof(header));
+    }
+
+    if(!blconf_journal_write_all(channel->journal_fd, records->data, records->len))
         goto out;
 
+    channel->journal_size += records->len;
     ret = TRUE;
 
 out:
-    if(!ret && error && !*error) {
-        g_set_error(error, BLCONF_ERROR,
-                    BLCONF_ERROR_WRITE_FAILURE,
-                    _("Unable to write channel \"%s\": %s"),
-                    channel_name, strerror(errno));
+    if(!ret) {
+        /* don't leave a partial record behind for later ones to follow */
+        if(ftruncate(channel->journal_fd, channel->journal_size))
+            g_warning("Unable to truncate journal of channel \"%s\"", channel->name);
+        close(channel->journal_fd);
+        channel->journal_fd = -1;
     }
 
-    if(fp)
-        fclose(fp);
+    return ret;
+}
 
-    g_free(filename);
-    g_free(filename_tmp);
+/* appends the records of the journal |filename| to the one at
+ * |dest_filename|, and removes |filename| */
+static gboolean
+blconf_journal_concat(const gchar *filename,
+                      const gchar *dest_filename)
+{
+    gchar *contents = NULL;
+    gsize length = 0;
+    gint fd;
+    gboolean ret = FALSE;
 
-    channel->dirty = FALSE;
+    if(!g_file_get_contents(filename, &contents, &length, NULL))
+        return FALSE;
+
+    fd = open(dest_filename, O_WRONLY | O_APPEND);
+    if(fd < 0)
+        goto out;
+
+    if(length <= JOURNAL_HEADER_LEN
+       || blconf_journal_write_all(fd, (const guint8 *)contents + JOURNAL_HEADER_LEN,
+                                   length - JOURNAL_HEADER_LEN))
+    {
+        ret = blconf_journal_sync_fd(fd);
+    }
+
+    close(fd);
+
+    if(ret)
+        unlink(filename);
+
+out:
+    g_free(contents);
 
     return ret;
 }
+
+/* called when a write of the channel's xml file is started: the current
+ * journal is set aside, to be removed once the xml file (which contains
+ * all of its changes) is safely on disk.  changes made in the meantime go
+ * to a fresh journal. */
+static void
+blconf_backend_perchannel_xml_journal_rotate(BlconfBackendPerchannelXml *xbpx,
+                                             BlconfChannel *channel)
+{
+    gchar *filename, *old_filename;
+
+    if(channel->journal_fd >= 0) {
+        close(channel->journal_fd);
+        channel->journal_fd = -1;
+    }
+    channel->journal_size = 0;
+
+    filename = blconf_backend_perchannel_xml_journal_filename(xbpx,
+                                                              channel->name);
+    old_filename = g_strconcat(filename, JOURNAL_OLD_SUFFIX, NULL);
+
+    if(g_file_test(filename, G_FILE_TEST_EXISTS)) {
+        gboolean rotated;
+
+        /* if there's still an older journal around, a previous write
+         * failed, and its records have to stay in front of ours */
+        if(g_file_test(old_filename, G_FILE_TEST_EXISTS))
+            rotated = blconf_journal_concat(filename, old_filename);
+        else
+            rotated = !rename(filename, old_filename);
+
+        /* not fatal: replaying records that are already in the xml file
+         * is harmless, they'll just stick around until the next write */
+        if(!rotated)
+            g_warning("Unable to set aside journal \"%s\"", filename);
+    }
+
+    g_free(old_filename);
+    g_free(filename);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_journal_remove_old(BlconfBackendPerchannelXml *xbpx,
+                                                 const gchar *channel_name)
+{
+    gchar *filename, *old_filename;
+    gboolean ret;
+
+    filename = blconf_backend_perchannel_xml_journal_filename(xbpx,
+                                                              channel_name);
+    old_filename = g_strconcat(filename, JOURNAL_OLD_SUFFIX, NULL);
+    ret = !unlink(old_filename);
+
+    g_free(old_filename);
+    g_free(filename);
+
+    return ret;
+}
+
+/* records changes made to the in-memory tree, given as journal records.
+ * once they're in the journal the changes are safe, and the xml file only
+ * needs to be rewritten when the journal has grown large enough to be
+ * worth compacting. */
+static void
+blconf_backend_perchannel_xml_log_changes(BlconfBackendPerchannelXml *xbpx,
+                                          BlconfChannel *channel,
+                                          GByteArray *records)
+{
+    channel->mem_size_stale = TRUE;
+
+    if(!blconf_backend_perchannel_xml_journal_append(xbpx, channel, records)) {
+        g_warning("Unable to write journal of channel \"%s\": %s",
+                  channel->name, strerror(errno));
+        blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+        return;
+    }
+
+    blconf_backend_perchannel_xml_journal_sync(xbpx, channel);
+
+    if(channel->journal_size >= JOURNAL_COMPACT_SIZE)
+        blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+    else
+        channel->dirty = TRUE;
+}
+
+/* has the writer thread sync the channel's journal to disk, so a set
+ * doesn't wait for the disk on the main loop.  while a sync is queued or
+ * running, further appends only mark another one as needed once it's
+ * done, so a burst of changes takes two syncs, not one per change. */
+static void
+blconf_backend_perchannel_xml_journal_sync(BlconfBackendPerchannelXml *xbpx,
+                                           BlconfChannel *channel)
+{
+    BlconfWriteJob *job;
+    gint fd;
+
+    if(channel->sync_job) {
+        channel->sync_pending = TRUE;
+        return;
+    }
+
+    /* the job gets its own descriptor: the channel's is closed when the
+     * journal is set aside or the channel is evicted */
+    fd = dup(channel->journal_fd);
+    if(fd < 0) {
+        if(!blconf_journal_sync_fd(channel->journal_fd)) {
+            g_warning("Unable to sync journal of channel \"%s\": %s",
+                      channel->name, strerror(errno));
+            blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+        }
+        return;
+    }
+
+    job = g_slice_new0(BlconfWriteJob);
+    job->channel = channel;
+    job->channel_name = g_strdup(channel->name);
+    job->journal_sync = TRUE;
+    job->journal_fd = fd;
+
+    channel->sync_job = job;
+
+    blconf_backend_perchannel_xml_submit_write(xbpx, job);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_journal_apply(BlconfChannel *channel,
+                                            SnapshotReader *reader)
+{
+    guint8 op;
+    gchar *property = NULL;
+    GValue value = { 0, };
+    gboolean ret = FALSE;
+
+    if(!blconf_snapshot_get(reader, &op, 1)
+       || !blconf_snapshot_get_string(reader, &property)
+       || !PROP_NAME_IS_VALID(property))
+    {
+        goto out;
+    }
+
+    switch(op) {
+        case JOURNAL_OP_SET: {
+            BlconfProperty *prop;
+
+            if(!blconf_snapshot_get_value(reader, &value, FALSE)
+               || !G_VALUE_TYPE(&value))
+            {
+                goto out;
+            }
+
+            /* a system file may have locked the property since */
+            prop = blconf_proptree_lookup(channel->properties, property);
+            if(!prop)
+                blconf_proptree_add_property(channel->properties, property,
+                                             &value, NULL, FALSE);
+            else if(!prop->locked) {
+                if(G_VALUE_TYPE(&prop->value))
+                    blconf_property_value_unset(&prop->value);
+                g_value_copy(&value, g_value_init(&prop->value,
+                                                  G_VALUE_TYPE(&value)));
+                blconf_property_value_pool(&prop->value);
+            }
+            break;
+        }
+
+        case JOURNAL_OP_RESET:
+            blconf_proptree_reset(channel->properties, property);
+            break;
+
+        case JOURNAL_OP_RESET_RECURSIVE: {
+            GNode *top = blconf_proptree_lookup_node(channel->properties,
+                                                     property);
+
+            if(top) {
+                g_node_traverse(top, G_POST_ORDER, G_TRAVERSE_ALL, -1,
+                                nodes_do_prop_reset, NULL);
+                g_node_traverse(top, G_POST_ORDER, G_TRAVERSE_ALL, -1,
+                                nodes_clean_up, NULL);
+            }
+            break;
+        }
+
+        default:
+            goto out;
+    }
+
+    ret = TRUE;
+
+out:
+    if(G_VALUE_TYPE(&value))
+        g_value_unset(&value);
+    g_free(property);
+
+    return ret;
+}
+
+/* replays one journal file on top of the channel's proptree, and returns
+ * the length of its valid part.  a torn record at the end (we crashed
+ * while appending it) and anything after it is dropped. */
+static gsize
+blconf_backend_perchannel_xml_journal_replay_file(BlconfChannel *channel,
+                                                  const gchar *filename)
+{
+    GMappedFile *mmap_file;
+    SnapshotReader reader;
+    const gchar *contents;
+    gchar magic[4];
+    guint32 version;
+    gsize valid_len = 0, length;
+
+    mmap_file = g_mapped_file_new(filename, FALSE, NULL);
+    if(!mmap_file)
+        return 0;
+
+    contents = g_mapped_file_get_contents(mmap_file);
+    length = g_mapped_file_get_length(mmap_file);
+    reader.p = contents;
+    reader.end = contents + length;
+
+    if(length > 0
+       && (!blconf_snapshot_get(&reader, magic, sizeof(magic))
+           || memcmp(magic, JOURNAL_MAGIC, sizeof(magic))
+           || !blconf_snapshot_get_uint32(&reader, &version)
+           || version != JOURNAL_VERSION))
+    {
+        gchar *invalid_filename = g_strconcat(filename, ".invalid", NULL);
+
+        /* not ours to interpret, but don't throw it away either */
+        g_warning("Journal \"%s\" has an unknown format; moving it aside to \"%s\"",
+                  filename, invalid_filename);
+        if(rename(filename, invalid_filename))
+            unlink(filename);
+        g_free(invalid_filename);
+        goto out;
+    }
+    valid_len = reader.p - contents;
+
+    while(reader.p < reader.end) {
+        guint32 record_len, checksum;
+        SnapshotReader record;
+
+        if(!blconf_snapshot_get_uint32(&reader, &record_len)
+           || !blconf_snapshot_get_uint32(&reader, &checksum)
+           || record_len > (gsize)(reader.end - reader.p)
+           || checksum != blconf_snapshot_checksum(reader.p, record_len))
+        {
+            break;
+        }
+
+        record.p = reader.p;
+        record.end = reader.p + record_len;
+        if(!blconf_backend_perchannel_xml_journal_apply(channel, &record)
+           || record.p != record.end)
+        {
+            break;
+        }
+
+        reader.p = record.end;
+        valid_len = reader.p - contents;
+    }
+
+    if(valid_len < length) {
+        g_warning("Discarding %" G_GSIZE_FORMAT " bytes of damaged journal \"%s\"",
+                  length - valid_len, filename);
+        if(truncate(filename, valid_len))
+            g_warning("Unable to truncate journal \"%s\": %s", filename,
+                      strerror(errno));
+    }
+
+out:
+    g_mapped_file_unref(mmap_file);
+
+    return valid_len;
+}
+
+/* replays the channel's journals on top of the tree loaded from the xml
+ * files: first the one set aside for a write that didn't complete, if
+ * any, then the current one */
+static void
+blconf_backend_perchannel_xml_journal_replay(BlconfBackendPerchannelXml *xbpx,
+                                             const gchar *channel_name,
+                                             BlconfChannel *channel)
+{
+    gchar *filename, *old_filename;
+    gsize old_len;
+
+    filename = blconf_backend_perchannel_xml_journal_filename(xbpx,
+                                                              channel_name);
+    old_filename = g_strconcat(filename, JOURNAL_OLD_SUFFIX, NULL);
+
+    old_len = blconf_backend_perchannel_xml_journal_replay_file(channel,
+                                                                old_filename);
+    channel->journal_size = blconf_backend_perchannel_xml_journal_replay_file(channel,
+                                                                              filename);
+
+    if(old_len > JOURNAL_HEADER_LEN
+       || channel->journal_size > JOURNAL_HEADER_LEN)
+    {
+        /* the xml file is behind */
+        channel->dirty = TRUE;
+        channel->properties = blconf_proptree_compact(channel->properties);
+    }
+
+    g_free(old_filename);
+    g_free(filename);
+}
+
+static void
+blconf_resolved_files_free(BlconfResolvedFiles *resolved)
+{
+    g_strfreev(resolved->filenames);
+    g_free(resolved->user_file);
+    g_slice_free(BlconfResolvedFiles, resolved);
+}
+
+/* forgets where the files of |channel_name| (or of all channels, if it's
+ * NULL) are, after something changed in the config directories */
+static void
+blconf_backend_perchannel_xml_invalidate_resolved(BlconfBackendPerchannelXml *xbpx,
+                                                  const gchar *channel_name)
+{
+    GHashTableIter iter;
+    gpointer key;
+
+    if(!xbpx->resolved)
+        return;
+
+    if(!channel_name)
+        g_hash_table_remove_all(xbpx->resolved);
+    else {
+        /* channel names are case-insensitive, file names aren't */
+        g_hash_table_iter_init(&iter, xbpx->resolved);
+        while(g_hash_table_iter_next(&iter, &key, NULL)) {
+            if(!g_ascii_strcasecmp(key, channel_name))
+                g_hash_table_iter_remove(&iter);
+        }
+    }
+}
+
+/* looks up the system files and the user file of |channel_name|, in the
+ * form xfce_resource_lookup_all() and xfce_resource_save_location() give
+ * them.  returns FALSE if there's no file at all for the channel, in
+ * which case |filenames| and |user_file| are left alone.  main thread
+ * only: xfce_resource_*() isn't thread-safe, and neither is the cache. */
+static gboolean
+blconf_backend_perchannel_xml_resolve_files(BlconfBackendPerchannelXml *xbpx,
+                                            const gchar *channel_name,
+                                            gchar ***filenames,
+                                            gchar **user_file)
+{
+    BlconfResolvedFiles *resolved = NULL;
+    gchar *filename_stem, *journal_file;
+    gboolean ret;
+
+    if(xbpx->resolved) {
+        resolved = g_hash_table_lookup(xbpx->resolved, channel_name);
+        if(resolved && !resolved->missing) {
+            *filenames = g_strdupv(resolved->filenames);
+            *user_file = g_strdup(resolved->user_file);
+        }
+        if(resolved)
+            return !resolved->missing;
+    }
+
+    resolved = g_slice_new0(BlconfResolvedFiles);
+
+    filename_stem = g_strdup_printf(CONFIG_FILE_FMT, channel_name);
+    resolved->filenames = xfce_resource_lookup_all(XFCE_RESOURCE_CONFIG,
+                                                   filename_stem);
+    resolved->user_file = xfce_resource_save_location(XFCE_RESOURCE_CONFIG,
+                                                      filename_stem, FALSE);
+    g_free(filename_stem);
+
+    if(!resolved->filenames || !resolved->filenames[0]) {
+        journal_file = blconf_backend_perchannel_xml_journal_filename(xbpx,
+                                                                      channel_name);
+        resolved->missing = ((!resolved->user_file
+                              || !g_file_test(resolved->user_file,
+                                              G_FILE_TEST_EXISTS))
+                             && !g_file_test(journal_file, G_FILE_TEST_EXISTS));
+        g_free(journal_file);
+    }
+
+    ret = !resolved->missing;
+    if(ret) {
+        *filenames = g_strdupv(resolved->filenames);
+        *user_file = g_strdup(resolved->user_file);
+    }
+
+    if(xbpx->resolved) {
+        if(g_hash_table_size(xbpx->resolved) >= RESOLVE_CACHE_MAX)
+            g_hash_table_remove_all(xbpx->resolved);
+        g_hash_table_replace(xbpx->resolved, g_strdup(channel_name), resolved);
+    } else
+        blconf_resolved_files_free(resolved);
+
+    return ret;
+}
+
+/* builds the channel's tree from the files resolve_files() found (|found|
+ * being what it returned) and the journal, without adding it to the
+ * channel table.  besides those files, this only looks at the save paths
+ * of |xbpx|, which never change, so the preload threads can use it. */
+static BlconfChannel *
+blconf_backend_perchannel_xml_read_files(BlconfBackendPerchannelXml *xbpx,
+                                         const gchar *channel_name,
+                                         gboolean found,
+                                         gchar **filenames,
+                                         const gchar *user_file,
+                                         GError **error)
+{
+    BlconfChannel *channel = NULL;
+    gint i, length;
+    GArray *sources;
+
+    TRACE("entering");
+
+    if(!found) {
+        /* nothing to read, and nothing worth a snapshot */
+        return blconf_channel_new(NULL);
+    }
+
+    if((!filenames || !filenames[0]) && !user_file) {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR,
+                        BLCONF_ERROR_CHANNEL_NOT_FOUND,
+                        _("Channel \"%s\" does not exist"), channel_name);
+        }
+        return NULL;
+    }
+
+    sources = blconf_snapshot_sources_new(filenames, user_file);
+
+    channel = blconf_backend_perchannel_xml_load_snapshot(xbpx, channel_name,
+                                                          sources);
+    if(channel) {
+        DBG("loaded channel \"%s\" from snapshot", channel_name);
+        channel->sources = sources;
+    } else {
+        channel = blconf_channel_new(NULL);
+        channel->sources = sources;
+
+        /* read in system files, we do this in reversed order to properly 
+         * follow the xdg spec, see bug #6079 for more information */
+        length = g_strv_length(filenames);
+        for(i = length - 1; i >= 0; --i) {
+            if(!g_strcmp0(user_file, filenames[i]))
+                continue;
+            blconf_backend_perchannel_xml_merge_file(xbpx, filenames[i], TRUE,
+                                                     channel, NULL);
+        }
+
+        if(!channel->locked && user_file) {
+            /* read in user file */
+            blconf_backend_perchannel_xml_merge_file(xbpx, user_file, FALSE,
+                                                     channel, NULL);
+        }
+
+        /* so the next load can skip the xml parsing.  the journal isn't
+         * replayed yet, and the write is left to the writer thread */
+        channel->snapshot_job = blconf_backend_perchannel_xml_snapshot_job(xbpx,
+                                                                           channel_name,
+                                                                           channel);
+    }
+
+    /* the journal holds whatever changed since the user file was last
+     * written; it's never part of the snapshot */
+    if(!channel->locked)
+        blconf_backend_perchannel_xml_journal_replay(xbpx, channel_name, channel);
+
+    return channel;
+}
+
+static BlconfChannel *
+blconf_backend_perchannel_xml_read_channel(BlconfBackendPerchannelXml *xbpx,
+                                           const gchar *channel_name,
+                                           GError **error)
+{
+    BlconfChannel *channel;
+    gchar **filenames = NULL, *user_file = NULL;
+    gboolean found;
+
+    found = blconf_backend_perchannel_xml_resolve_files(xbpx, channel_name,
+                                                        &filenames,
+                                                        &user_file);
+    channel = blconf_backend_perchannel_xml_read_files(xbpx, channel_name,
+                                                       found, filenames,
+                                                       user_file, error);
+
+    g_strfreev(filenames);
+    g_free(user_file);
+
+    return channel;
+}
+
+static BlconfChannel *
+blconf_backend_perchannel_xml_load_channel(BlconfBackendPerchannelXml *xbpx,
+                                           const gchar *channel_name,
+                                           GError **error)
+{
+    BlconfChannel *channel = NULL;
+
+    if(xbpx->preloads)
+        channel = blconf_backend_perchannel_xml_take_preload(xbpx, channel_name);
+    if(!channel) {
+        channel = blconf_backend_perchannel_xml_read_channel(xbpx, channel_name,
+                                                             error);
+        if(!channel)
+            return NULL;
+    }
+
+    blconf_backend_perchannel_xml_insert_channel(xbpx, channel_name, channel);
+
+    if(xbpx->preload_record)
+        blconf_backend_perchannel_xml_preload_record(xbpx, channel_name);
+
+    if(channel->journal_size >= JOURNAL_COMPACT_SIZE)
+        blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+
+    return channel;
+}
+
+static gboolean
+blconf_format_xml_tag(GString *elem_str,
+                      GValue *value,
+                      gboolean is_array_value,
+                      gchar spaces[MAX_PROP_PATH],
+                      gboolean *is_array)
+{
+    gchar *tmp;
+
+    switch(G_VALUE_TYPE(value)) {
+        case G_TYPE_STRING:
+            tmp = g_markup_escape_text(g_value_get_string(value), -1);
+            g_string_append_printf(elem_str, " type=\"string\" value=\"%s\"",
+                                   tmp);
+            g_free(tmp);
+            break;
+
+        case G_TYPE_UCHAR:
+            g_string_append_printf(elem_str, " type=\"uchar\" value=\"%hhu\"",
+                                   g_value_get_uchar(value));
+            break;
+
+        case G_TYPE_CHAR:
+            g_string_append_printf(elem_str, " type=\"char\" value=\"%hhd\"",
+                                   g_value_get_uchar(value));
+            break;
+
+        case G_TYPE_UINT:
+            g_string_append_printf(elem_str, " type=\"uint\" value=\"%u\"",
+                                   g_value_get_uint(value));
+            break;
+
+        case G_TYPE_INT:
+            g_string_append_printf(elem_str, " type=\"int\" value=\"%d\"",
+                                   g_value_get_int(value));
+            break;
+
+        case G_TYPE_UINT64:
+            g_string_append_printf(elem_str, " type=\"uint64\" value=\"%" G_GUINT64_FORMAT "\"",
+                                   g_value_get_uint64(value));
+            break;
+
+        case G_TYPE_INT64:
+            g_string_append_printf(elem_str, " type=\"int64\" value=\"%" G_GINT64_FORMAT "\"",
+                                   g_value_get_int64(value));
+            break;
+
+        case G_TYPE_FLOAT:
+            g_string_append_printf(elem_str, " type=\"float\" value=\"%f\"",
+                                   (gdouble)g_value_get_float(value));
+            break;
+
+        case G_TYPE_DOUBLE:
+            g_string_append_printf(elem_str, " type=\"double\" value=\"%f\"",
+                                   g_value_get_double(value));
+            break;
+
+        case G_TYPE_BOOLEAN:
+            g_string_append_printf(elem_str, " type=\"bool\" value=\"%s\"",
+                                   g_value_get_boolean(value) ? "true" : "false");
+            break;
+
+        default:
+            if(G_VALUE_TYPE(value) == G_TYPE_STRV) {
+                gchar **strlist;
+                gint i;
+
+                /* we shouldn't get here anymore, i think */
+                g_critical("Got G_TYPE_STRV.  Shouldn't happen anymore, right?");
+
+                if(is_array_value)
+                    return FALSE;
+
+                g_string_append(elem_str, " type=\"array\">\n");
+
+                strlist = g_value_get_boxed(value);
+                for(i = 0; strlist[i]; ++i) {
+                    gchar *value_str = g_markup_escape_text(strlist[i], -1);
+                    g_string_append_printf(elem_str,
+                                           "%s  <value type=\"string\" value=\"%s\"/>\n",
+                                           spaces, value_str);
+                    g_free(value_str);
+                }
+
+                *is_array = TRUE;
+            } else if(BLCONF_TYPE_G_VALUE_ARRAY == G_VALUE_TYPE(value)) {
+                GPtrArray *arr;
+                guint i;
+                
+                if(is_array_value)
+                    return FALSE;
+
+                g_string_append(elem_str, " type=\"array\">\n");
+
+                arr = g_value_get_boxed(value);
+                for(i = 0; i < arr->len; ++i) {
+                    GValue *value1 = g_ptr_array_index(arr, i);
+                    gboolean dummy;
+
+                    g_string_append_printf(elem_str, "%s  <value", spaces);
+                    if(!blconf_format_xml_tag(elem_str, value1, TRUE, spaces,
+                                              &dummy))
+                    {
+                        return FALSE;
+                    }
+                    g_string_append(elem_str, "/>\n");
+                }
+
+                *is_array = TRUE;
+            } else {
+                if(is_array_value)
+                    return FALSE;
+
+                if(G_VALUE_TYPE(value) != G_TYPE_INVALID) {
+                    g_warning("Unknown value type %d (\"%s\"), treating as branch",
+                              (int)G_VALUE_TYPE(value), G_VALUE_TYPE_NAME(value));
+                    g_value_unset(value);
+                }
+
+                is_array = FALSE;
+                g_string_append(elem_str, " type=\"empty\"");
+            }
+            break;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_perchannel_xml_write_node(BlconfBackendPerchannelXml *xbpx,
+                                         FILE *fp,
+                                         GNode *node,
+                                         gint depth,
+                                         GError **error)
+{
+    BlconfProperty *prop = node->data;
+    GValue *value = &prop->value;
+    GString *elem_str;
+    gchar spaces[MAX_PROP_PATH];
+    GNode *child;
+    gchar *escaped_name;
+    gboolean is_array = FALSE;
+    
+    if(depth * 2 > (gint) sizeof(spaces) + 1)
+        depth = sizeof(spaces) / 2 - 1;
+
+    memset(spaces, ' ', depth * 2);
+    spaces[depth * 2] = 0;
+
+    escaped_name = g_markup_escape_text(prop->name, strlen(prop->name));
+
+    elem_str = g_string_sized_new(128);
+    g_string_append_printf(elem_str, "%s<property name=\"%s\"", spaces,
+                           escaped_name);
+
+    g_free (escaped_name);
+
+    if(!blconf_format_xml_tag(elem_str, value, FALSE, spaces, &is_array)) {
+        /* _write_file() will handle |error| */
+        g_string_free(elem_str, TRUE);
+        return FALSE;
+    }
+
+    child = g_node_first_child(node);
+    if(!is_array) {
+        if(child)
+            g_string_append(elem_str, ">\n");
+        else
+            g_string_append(elem_str, "/>\n");
+    }
+
+    if(fputs(elem_str->str, fp) == EOF) {
+        /* _write_file() will handle |error| */
+        g_string_free(elem_str, TRUE);
+        return FALSE;
+    }
+    g_string_free(elem_str, TRUE);
+
+    for(; child; child = g_node_next_sibling(child)) {
+        if(!blconf_backend_perchannel_xml_write_node(xbpx, fp, child,
+                                                     depth + 1, error))
+        {
+            /* _write_file() will handle |error| */
+            return FALSE;
+        }
+    }
+
+    if(is_array || g_node_first_child(node)) {
+        if(fputs(spaces, fp) == EOF || fputs("</property>\n", fp) == EOF) {
+            /* _write_file() will handle |error| */
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* writes |properties| out to |filename|; this doesn't look at the
+ * backend or the channel, so it's safe to call from the writer thread */
+static gboolean
+blconf_backend_perchannel_xml_write_file(const gchar *channel_name,
+                                         GNode *properties,
+                                         const gchar *filename,
+                                         GError **error)
+{
+    gboolean ret = FALSE;
+    GNode *child;
+    gchar *filename_tmp;
+    FILE *fp = NULL;
+
+    filename_tmp = g_strconcat(filename, ".new", NULL);
+
+    fp = fopen(filename_tmp, "w");
+    if(!fp)
+        goto out;
+
+    if(fputs("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\n", fp) == EOF
+       || fprintf(fp, "<channel name=\"%s\" version=\"%s.%s\">\n", channel_name,
+                  FILE_VERSION_MAJOR, FILE_VERSION_MINOR) < 0)
+    {
+        goto out;
+    }
+
+    for(child = g_node_first_child(properties);
+        child;
+        child = g_node_next_sibling(child))
+    {
+        if(!blconf_backend_perchannel_xml_write_node(NULL, fp, child, 1, error))
+            goto out;
+    }
+
+    if(fputs("</channel>\n", fp) == EOF)
+        goto out;
+
+    if(fflush(fp))
+        goto out;
+
+#if defined(HAVE_FDATASYNC)
+    if(fdatasync(fileno(fp)))
+        goto out;
+#elif defined(HAVE_FSYNC)
+    if(fsync(fileno(fp)))
+        goto out;
+#else
+    sync();
+#endif
+
+    if(fclose(fp)) {
+        fp = NULL;
+        goto out;
+    }
+    fp = NULL;
+
+    if(rename(filename_tmp, filename))
+        goto out;
+
+    ret = TRUE;
+
+out:
+    if(!ret && error && !*error) {
+        g_set_error(error, BLCONF_ERROR,
+                    BLCONF_ERROR_WRITE_FAILURE,
+                    _("Unable to write channel \"%s\": %s"),
+                    channel_name, strerror(errno));
+    }
+
+    if(fp)
+        fclose(fp);
+
+    g_free(filename_tmp);
+
+    return ret;
+}
+
+static void
+blconf_proptree_copy_node(GNode *proptree,
+                          GNode *node,
+                          GNode *copy_node,
+                          gboolean with_index)
+{
+    const BlconfProperty *prop = node->data;
+    BlconfProperty *copy = copy_node->data;
+    GNode *child;
+
+    copy->locked = prop->locked;
+    if(G_VALUE_TYPE(&prop->value)) {
+        g_value_init(&copy->value, G_VALUE_TYPE(&prop->value));
+        g_value_copy(&prop->value, &copy->value);
+        blconf_property_value_pool(&copy->value);
+    }
+    if(prop->system_value) {
+        g_value_copy(prop->system_value,
+                     blconf_property_init_system_value(copy,
+                                                       G_VALUE_TYPE(prop->system_value)));
+        blconf_property_value_pool(copy->system_value);
+    }
+
+    /* walking the children backwards and prepending keeps this linear
+     * for wide nodes */
+    for(child = g_node_last_child(node); child; child = child->prev) {
+        GNode *copy_child = blconf_proptree_node_new(proptree,
+                                                     ((BlconfProperty *)child->data)->name);
+
+        g_node_prepend(copy_node, copy_child);
+        blconf_proptree_copy_node(proptree, child, copy_child, with_index);
+    }
+
+    if(with_index && prop->children) {
+        copy->children = g_hash_table_new(g_direct_hash, g_direct_equal);
+        for(child = g_node_first_child(copy_node);
+            child;
+            child = g_node_next_sibling(child))
+        {
+            g_hash_table_insert(copy->children,
+                                (gpointer)((BlconfProperty *)child->data)->name,
+                                child);
+        }
+    }
+}
+
+/* copies |proptree| into a new arena.  the child indexes are only needed
+ * for lookups; the writer only walks the tree, so it skips them. */
+static GNode *
+blconf_proptree_copy(GNode *proptree,
+                     gboolean with_index)
+{
+    GNode *copy = blconf_proptree_new();
+
+    blconf_proptree_copy_node(copy, proptree, copy, with_index);
+
+    return copy;
+}
+
+static void
+blconf_write_job_run(BlconfWriteJob *job)
+{
+    if(job->journal_sync) {
+        job->success = blconf_journal_sync_fd(job->journal_fd);
+        close(job->journal_fd);
+        job->journal_fd = -1;
+    } else if(!job->filename) {
+        /* only the snapshot of a channel that was just read in */
+        blconf_snapshot_write(job->snapshot_filename, job->sources,
+                              job->locked, job->lock_lists, job->properties,
+                              NULL);
+        job->success = TRUE;
+    } else {
+        job->success = blconf_backend_perchannel_xml_write_file(job->channel_name,
+                                                                job->properties,
+                                                                job->filename,
+                                                                &job->error);
+        if(job->success && job->snapshot_filename) {
+            blconf_snapshot_write(job->snapshot_filename, job->sources,
+                                  job->locked, job->lock_lists,
+                                  job->properties, job->filename);
+        } else if(job->success && job->sources && job->sources->len) {
+            /* so the file monitor can tell our own write from someone
+             * else's */
+            blconf_snapshot_source_stat(&g_array_index(job->sources,
+                                                       SnapshotSource,
+                                                       job->sources->len - 1));
+        }
+    }
+
+    /* the copy can go right away, and be freed off the main thread too */
+    blconf_proptree_destroy(job->properties);
+    job->properties = NULL;
+}
+
+static void
+blconf_write_job_free(BlconfWriteJob *job)
+{
+    g_free(job->channel_name);
+    g_free(job->filename);
+    g_free(job->snapshot_filename);
+    blconf_proptree_destroy(job->properties);
+    blconf_snapshot_sources_free(job->sources);
+    if(job->lock_lists)
+        g_hash_table_unref(job->lock_lists);
+    if(job->error)
+        g_error_free(job->error);
+    g_slice_free(BlconfWriteJob, job);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_write_done_idled(gpointer data)
+{
+    BlconfBackendPerchannelXml *xbpx = data;
+    GSList *done = NULL, *l;
+
+    blconf_backend_perchannel_xml_write_lock(xbpx);
+    xbpx->write_done_id = 0;
+    for(l = xbpx->write_jobs; l; l = l->next) {
+        BlconfWriteJob *job = l->data;
+
+        if(job->done)
+            done = g_slist_prepend(done, job);
+    }
+    blconf_backend_perchannel_xml_write_unlock(xbpx);
+
+    for(l = g_slist_reverse(done); l; l = l->next) {
+        /* finishing one job may have finished others already */
+        if(g_slist_find(xbpx->write_jobs, l->data))
+            blconf_backend_perchannel_xml_finish_write(xbpx, l->data, NULL);
+    }
+    g_slist_free(done);
+
+    return FALSE;
+}
+
+static gpointer
+blconf_backend_perchannel_xml_writer_thread(gpointer data)
+{
+    BlconfBackendPerchannelXml *xbpx = data;
+    BlconfWriteJob *job;
+
+    while((job = g_async_queue_pop(xbpx->write_queue)) != &writer_quit_job) {
+        blconf_write_job_run(job);
+
+        blconf_backend_perchannel_xml_write_lock(xbpx);
+        job->done = TRUE;
+        blconf_backend_perchannel_xml_write_signal(xbpx);
+        if(!xbpx->write_done_id) {
+            xbpx->write_done_id = g_idle_add(blconf_backend_perchannel_xml_write_done_idled,
+                                             xbpx);
+        }
+        blconf_backend_perchannel_xml_write_unlock(xbpx);
+    }
+
+    return NULL;
+}
+
+static gboolean
+blconf_backend_perchannel_xml_start_writer(BlconfBackendPerchannelXml *xbpx)
+{
+    GError *error = NULL;
+
+    if(xbpx->writer)
+        return TRUE;
+
+    if(!xbpx->write_queue)
+        xbpx->write_queue = g_async_queue_new();
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    xbpx->writer = g_thread_try_new("blconf-writer",
+                                    blconf_backend_perchannel_xml_writer_thread,
+                                    xbpx, &error);
+#else
+    xbpx->writer = g_thread_create(blconf_backend_perchannel_xml_writer_thread,
+                                   xbpx, TRUE, &error);
+#endif
+    if(!xbpx->writer) {
+        /* we'll just write on the main thread */
+        g_warning("Unable to start writer thread: %s", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* waits for |job| to complete if it's still running, and updates the
+ * channel accordingly */
+static gboolean
+blconf_backend_perchannel_xml_finish_write(BlconfBackendPerchannelXml *xbpx,
+                                           BlconfWriteJob *job,
+                                           GError **error)
+{
+    BlconfChannel *channel = job->channel;
+    gboolean ret;
+
+    blconf_backend_perchannel_xml_write_lock(xbpx);
+    while(!job->done)
+        blconf_backend_perchannel_xml_write_wait(xbpx);
+    blconf_backend_perchannel_xml_write_unlock(xbpx);
+
+    xbpx->write_jobs = g_slist_remove(xbpx->write_jobs, job);
+    xbpx->n_write_jobs--;
+
+    ret = job->success;
+    if(job->journal_sync) {
+        if(channel) {
+            channel->sync_job = NULL;
+
+            if(!ret) {
+                /* as when the append fails: get the changes into the
+                 * xml file instead */
+                g_warning("Unable to sync journal of channel \"%s\"",
+                          channel->name);
+                channel->sync_pending = FALSE;
+                blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+            } else if(channel->sync_pending) {
+                channel->sync_pending = FALSE;
+                if(channel->journal_fd >= 0)
+                    blconf_backend_perchannel_xml_journal_sync(xbpx, channel);
+            }
+        } else if(!ret)
+            g_warning("Unable to sync journal of channel \"%s\"",
+                      job->channel_name);
+
+        blconf_write_job_free(job);
+
+        return ret;
+    }
+
+    if(job->filename)
+        blconf_backend_perchannel_xml_invalidate_resolved(xbpx,
+                                                          job->channel_name);
+    if(!job->filename) {
+        /* a snapshot only; there's nothing else to update */
+    } else if(ret) {
+        /* everything in the set-aside journal is in the xml file now */
+        blconf_backend_perchannel_xml_journal_remove_old(xbpx,
+                                                         job->channel_name);
+    } else if(error && !*error) {
+        g_propagate_error(error, job->error);
+        job->error = NULL;
+    } else {
+        g_warning("%s", job->error ? job->error->message : "Write failed");
+    }
+
+    if(channel) {
+        channel->write_job = NULL;
+
+        if(ret) {
+            /* the writer re-stat()ed the user file */
+            blconf_snapshot_sources_free(channel->sources);
+            channel->sources = job->sources;
+            job->sources = NULL;
+        } else {
+            /* the changes are still in the journal; try again on the next
+             * save or flush */
+            channel->dirty = TRUE;
+        }
+
+        if(channel->flush_pending) {
+            channel->flush_pending = FALSE;
+            if(channel->dirty)
+                blconf_backend_perchannel_xml_flush_channel(xbpx, channel);
+        }
+    }
+
+    blconf_write_job_free(job);
+
+    return ret;
+}
+
+/* hands a copy of the channel off to the writer thread.  the channel is
+ * considered clean from here on; if the write fails, it's marked dirty
+ * again when the result comes back. */
+static void
+blconf_backend_perchannel_xml_flush_channel(BlconfBackendPerchannelXml *xbpx,
+                                            BlconfChannel *channel)
+{
+    BlconfWriteJob *job;
+
+    DBG("Flushing dirty channel \"%s\"", channel->name);
+
+    if(channel->write_job) {
+        /* the job has an older copy of the tree */
+        channel->flush_pending = TRUE;
+        return;
+    }
+
+    job = g_slice_new0(BlconfWriteJob);
+    job->channel = channel;
+    job->channel_name = g_strdup(channel->name);
+    job->filename = g_strdup_printf("%s/%s.xml", xbpx->config_save_path,
+                                    channel->name);
+    if(xbpx->cache_save_path) {
+        job->snapshot_filename = blconf_backend_perchannel_xml_snapshot_filename(xbpx,
+                                                                                 channel->name);
+    }
+    job->properties = blconf_proptree_copy(channel->properties, FALSE);
+    job->sources = blconf_snapshot_sources_copy(channel->sources);
+    if(channel->lock_lists)
+        job->lock_lists = g_hash_table_ref(channel->lock_lists);
+    job->locked = channel->locked;
+
+    /* changes from now on aren't part of this write */
+    blconf_backend_perchannel_xml_journal_rotate(xbpx, channel);
+
+    if(channel->save_id) {
+        g_source_remove(channel->save_id);
+        channel->save_id = 0;
+    }
+    channel->dirty = FALSE;
+    channel->write_job = job;
+
+    blconf_backend_perchannel_xml_submit_write(xbpx, job);
+}
+
+/* queues |job| for the writer thread, or runs it right away if there's
+ * no writer thread */
+static void
+blconf_backend_perchannel_xml_submit_write(BlconfBackendPerchannelXml *xbpx,
+                                           BlconfWriteJob *job)
+{
+    /* don't let writes pile up if the disk can't keep up */
+    while(xbpx->n_write_jobs >= WRITE_QUEUE_MAX && xbpx->write_jobs) {
+        blconf_backend_perchannel_xml_finish_write(xbpx,
+                                                   g_slist_last(xbpx->write_jobs)->data,
+                                                   NULL);
+    }
+
+    xbpx->write_jobs = g_slist_prepend(xbpx->write_jobs, job);
+    xbpx->n_write_jobs++;
+
+    if(blconf_backend_perchannel_xml_start_writer(xbpx))
+        g_async_queue_push(xbpx->write_queue, job);
+    else {
+        blconf_write_job_run(job);
+        job->done = TRUE;
+        blconf_backend_perchannel_xml_finish_write(xbpx, job, NULL);
+    }
+}
+
+
+
+static void
+blconf_preload_job_free(BlconfPreloadJob *job)
+{
+    g_free(job->channel_name);
+    g_strfreev(job->filenames);
+    g_free(job->user_file);
+    if(job->channel)
+        blconf_channel_destroy(job->channel);
+    g_slice_free(BlconfPreloadJob, job);
+}
+
+static void
+blconf_backend_perchannel_xml_install_preload(BlconfBackendPerchannelXml *xbpx,
+                                              BlconfPreloadJob *job)
+{
+    BlconfChannel *channel = job->channel;
+    gchar *key;
+
+    key = g_ascii_strdown(job->channel_name, -1);
+
+    /* someone may have created it in the meantime */
+    if(channel && !g_hash_table_lookup(xbpx->channels, key)) {
+        job->channel = NULL;
+        blconf_backend_perchannel_xml_insert_channel(xbpx, job->channel_name,
+                                                     channel);
+        if(channel->journal_size >= JOURNAL_COMPACT_SIZE)
+            blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+    }
+
+    g_hash_table_remove(xbpx->preloads, key);
+    g_free(key);
+}
+
+static void
+blconf_backend_perchannel_xml_preload_finished(BlconfBackendPerchannelXml *xbpx)
+{
+    if(g_hash_table_size(xbpx->preloads))
+        return;
+
+    /* everything's been picked up */
+    g_thread_pool_free(xbpx->preload_pool, FALSE, TRUE);
+    xbpx->preload_pool = NULL;
+    g_hash_table_destroy(xbpx->preloads);
+    xbpx->preloads = NULL;
+}
+
+static gboolean
+blconf_backend_perchannel_xml_preload_done_idled(gpointer data)
+{
+    BlconfBackendPerchannelXml *xbpx = data;
+    GHashTableIter iter;
+    gpointer job;
+    GSList *done = NULL, *l;
+
+    blconf_backend_perchannel_xml_write_lock(xbpx);
+    xbpx->preload_done_id = 0;
+    blconf_backend_perchannel_xml_write_unlock(xbpx);
+
+    /* the last ones may have been taken already */
+    if(!xbpx->preloads)
+        return FALSE;
+
+    blconf_backend_perchannel_xml_write_lock(xbpx);
+    g_hash_table_iter_init(&iter, xbpx->preloads);
+    while(g_hash_table_iter_next(&iter, NULL, &job)) {
+        if(((BlconfPreloadJob *)job)->done)
+            done = g_slist_prepend(done, job);
+    }
+    blconf_backend_perchannel_xml_write_unlock(xbpx);
+
+    for(l = done; l; l = l->next)
+        blconf_backend_perchannel_xml_install_preload(xbpx, l->data);
+    g_slist_free(done);
+
+    blconf_backend_perchannel_xml_preload_finished(xbpx);
+
+    return FALSE;
+}
+
+static void
+blconf_backend_perchannel_xml_preload_thread(gpointer data,
+                                             gpointer user_data)
+{
+    BlconfPreloadJob *job = data;
+    BlconfBackendPerchannelXml *xbpx = user_data;
+    BlconfChannel *channel;
+
+    /* the files were resolved on the main thread; reading them only
+     * touches the channel's files and the save paths of |xbpx|.  the
+     * snapshot, if one is needed, is written once the channel is
+     * installed. */
+    channel = blconf_backend_perchannel_xml_read_files(xbpx,
+                                                       job->channel_name,
+                                                       job->found,
+                                                       job->filenames,
+                                                       job->user_file,
+                                                       NULL);
+
+    blconf_backend_perchannel_xml_write_lock(xbpx);
+    job->channel = channel;
+    job->done = TRUE;
+    blconf_backend_perchannel_xml_write_signal(xbpx);
+    if(!xbpx->preload_done_id) {
+        xbpx->preload_done_id = g_idle_add(blconf_backend_perchannel_xml_preload_done_idled,
+                                           xbpx);
+    }
+    blconf_backend_perchannel_xml_write_unlock(xbpx);
+}
+
+/* if |channel_name| is being preloaded, waits for it and hands it over,
+ * rather than reading it a second time */
+static BlconfChannel *
+blconf_backend_perchannel_xml_take_preload(BlconfBackendPerchannelXml *xbpx,
+                                           const gchar *channel_name)
+{
+    BlconfPreloadJob *job;
+    BlconfChannel *channel;
+    gchar *key;
+
+    key = g_ascii_strdown(channel_name, -1);
+    job = g_hash_table_lookup(xbpx->preloads, key);
+    if(!job) {
+        g_free(key);
+        return NULL;
+    }
+
+    blconf_backend_perchannel_xml_write_lock(xbpx);
+    while(!job->done)
+        blconf_backend_perchannel_xml_write_wait(xbpx);
+    blconf_backend_perchannel_xml_write_unlock(xbpx);
+
+    channel = job->channel;
+    job->channel = NULL;
+    g_hash_table_remove(xbpx->preloads, key);
+    g_free(key);
+
+    blconf_backend_perchannel_xml_preload_finished(xbpx);
+
+    return channel;
+}
+
+static void
+blconf_backend_perchannel_xml_preload_record(BlconfBackendPerchannelXml *xbpx,
+                                             const gchar *channel_name)
+{
+    gchar *key = g_ascii_strdown(channel_name, -1);
+
+    if(!g_hash_table_lookup(xbpx->preload_record, key)) {
+        g_hash_table_insert(xbpx->preload_record, key,
+                            g_strdup(channel_name));
+    } else
+        g_free(key);
+}
+
+/* saves the channels that were used during startup for the next time */
+static gboolean
+blconf_backend_perchannel_xml_preload_record_timeout(gpointer data)
+{
+    BlconfBackendPerchannelXml *xbpx = data;
+    GString *contents = g_string_sized_new(256);
+    GHashTableIter iter;
+    gpointer channel_name;
+    gchar *filename;
+    GError *error = NULL;
+
+    g_hash_table_iter_init(&iter, xbpx->preload_record);
+    while(g_hash_table_iter_next(&iter, NULL, &channel_name)) {
+        g_string_append(contents, channel_name);
+        g_string_append_c(contents, '\n');
+    }
+
+    filename = g_strdup_printf(PRELOAD_FILE_FMT, xbpx->cache_save_path);
+    if(!g_file_set_contents(filename, contents->str, contents->len, &error)) {
+        DBG("Unable to write \"%s\": %s", filename, error->message);
+        g_error_free(error);
+    }
+    g_free(filename);
+    g_string_free(contents, TRUE);
+
+    g_hash_table_destroy(xbpx->preload_record);
+    xbpx->preload_record = NULL;
+    xbpx->preload_record_id = 0;
+
+    return FALSE;
+}
+
+/* starts reading in the channels that were used early on last time in
+ * the background, and starts recording the ones used this time */
+static void
+blconf_backend_perchannel_xml_start_preload(BlconfBackendPerchannelXml *xbpx)
+{
+    gchar *filename, *contents = NULL, **channel_names;
+    GError *error = NULL;
+    gint i;
+
+    xbpx->preload_record = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                 (GDestroyNotify)g_free,
+                                                 (GDestroyNotify)g_free);
+    xbpx->preload_record_id = g_timeout_add_seconds(xbpx->preload_time,
+                                                    blconf_backend_perchannel_xml_preload_record_timeout,
+                                                    xbpx);
+
+    filename = g_strdup_printf(PRELOAD_FILE_FMT, xbpx->cache_save_path);
+    if(!g_file_get_contents(filename, &contents, NULL, NULL)) {
+        g_free(filename);
+        return;
+    }
+    g_free(filename);
+
+    channel_names = g_strsplit(contents, "\n", -1);
+    g_free(contents);
+
+    xbpx->preload_pool = g_thread_pool_new(blconf_backend_perchannel_xml_preload_thread,
+                                           xbpx, PRELOAD_THREADS, FALSE,
+                                           &error);
+    if(!xbpx->preload_pool) {
+        g_warning("Unable to start preload threads: %s", error->message);
+        g_error_free(error);
+        g_strfreev(channel_names);
+        return;
+    }
+
+    xbpx->preloads = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           (GDestroyNotify)g_free,
+                                           (GDestroyNotify)blconf_preload_job_free);
+
+    for(i = 0; channel_names[i]; ++i) {
+        BlconfPreloadJob *job;
+        gchar *key;
+
+        if(!*channel_names[i])
+            continue;
+
+        key = g_ascii_strdown(channel_names[i], -1);
+        if(g_hash_table_lookup(xbpx->preloads, key)) {
+            g_free(key);
+            continue;
+        }
+
+        DBG("preloading channel \"%s\"", channel_names[i]);
+
+        job = g_slice_new0(BlconfPreloadJob);
+        job->channel_name = g_strdup(channel_names[i]);
+        job->found = blconf_backend_perchannel_xml_resolve_files(xbpx,
+                                                                 job->channel_name,
+                                                                 &job->filenames,
+                                                                 &job->user_file);
+        g_hash_table_insert(xbpx->preloads, key, job);
+        g_thread_pool_push(xbpx->preload_pool, job, NULL);
+    }
+
+    g_strfreev(channel_names);
+
+    blconf_backend_perchannel_xml_preload_finished(xbpx);
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+static gboolean
+proptree_collect_values(GNode *node,
+                        gpointer data)
+{
+    BlconfProperty *prop = node->data;
+    GHashTable *values = data;
+    const GValue *value = NULL;
+    gchar prop_name[MAX_PROP_PATH];
+
+    /* what a Get would return */
+    value = blconf_property_get_value(prop);
+
+    if(value) {
+        blconf_proptree_build_propname(node, prop_name, sizeof(prop_name));
+        g_hash_table_insert(values, g_strdup(prop_name), (gpointer)value);
+    }
+
+    return FALSE;
+}
+
+/* returns the names of the properties whose values differ between the
+ * two trees, including those that exist in only one of them */
+static GSList *
+blconf_proptree_diff(GNode *old_tree,
+                     GNode *new_tree)
+{
+    GHashTable *old_values, *new_values;
+    GHashTableIter iter;
+    gpointer key, value;
+    GSList *changed = NULL;
+
+    old_values = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    new_values = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g_node_traverse(old_tree, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+                    proptree_collect_values, old_values);
+    g_node_traverse(new_tree, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+                    proptree_collect_values, new_values);
+
+    g_hash_table_iter_init(&iter, new_values);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        const GValue *old_value = g_hash_table_lookup(old_values, key);
+
+        if(!old_value || !blconf_gvalue_is_equal_deep(old_value, value))
+            changed = g_slist_prepend(changed, g_strdup(key));
+        if(old_value)
+            g_hash_table_remove(old_values, key);
+    }
+
+    /* whatever's left is gone */
+    g_hash_table_iter_init(&iter, old_values);
+    while(g_hash_table_iter_next(&iter, &key, NULL))
+        changed = g_slist_prepend(changed, g_strdup(key));
+
+    g_hash_table_destroy(old_values);
+    g_hash_table_destroy(new_values);
+
+    return changed;
+}
+
+static GArray *
+blconf_backend_perchannel_xml_channel_sources(BlconfBackendPerchannelXml *xbpx,
+                                              const gchar *channel_name)
+{
+    gchar **filenames, *user_file;
+    GArray *sources;
+
+    if(!blconf_backend_perchannel_xml_resolve_files(xbpx, channel_name,
+                                                    &filenames, &user_file))
+    {
+        return NULL;
+    }
+
+    sources = blconf_snapshot_sources_new(filenames, user_file);
+
+    g_strfreev(filenames);
+    g_free(user_file);
+
+    return sources;
+}
+
+/* re-reads a loaded channel whose files changed on disk, and notifies
+ * about the properties that are actually different now */
+static void
+blconf_backend_perchannel_xml_reload_channel(BlconfBackendPerchannelXml *xbpx,
+                                             BlconfChannel *channel)
+{
+    BlconfChannel *new_channel;
+    GArray *sources;
+    GNode *old_properties;
+    GHashTable *lock_lists;
+    GSList *changed, *l;
+
+    /* our own writes show up here as well */
+    sources = blconf_backend_perchannel_xml_channel_sources(xbpx,
+                                                            channel->name);
+    if(blconf_snapshot_sources_equal(channel->sources, sources)
+       || (!channel->sources && !sources))
+    {
+        blconf_snapshot_sources_free(sources);
+        return;
+    }
+    blconf_snapshot_sources_free(sources);
+
+    DBG("files of channel \"%s\" changed, reloading", channel->name);
+
+    new_channel = blconf_backend_perchannel_xml_read_channel(xbpx,
+                                                             channel->name,
+                                                             NULL);
+    if(!new_channel) {
+        /* all of the files are gone, but unsaved changes aren't */
+        new_channel = blconf_channel_new(NULL);
+        blconf_backend_perchannel_xml_journal_replay(xbpx, channel->name,
+                                                     new_channel);
+    }
+
+    changed = blconf_proptree_diff(channel->properties,
+                                   new_channel->properties);
+
+    /* swap in the new tree, but keep the channel's pending save, journal
+     * and such; the old tree goes away with |new_channel| */
+    old_properties = channel->properties;
+    channel->properties = new_channel->properties;
+    new_channel->properties = old_properties;
+    sources = channel->sources;
+    channel->sources = new_channel->sources;
+    new_channel->sources = sources;
+    lock_lists = channel->lock_lists;
+    channel->lock_lists = new_channel->lock_lists;
+    new_channel->lock_lists = lock_lists;
+    channel->locked = new_channel->locked;
+    if(new_channel->snapshot_job) {
+        blconf_backend_perchannel_xml_submit_write(xbpx,
+                                                   new_channel->snapshot_job);
+        new_channel->snapshot_job = NULL;
+    }
+    channel->mem_size_stale = TRUE;
+    blconf_channel_destroy(new_channel);
+
+    /* locks may have changed as well, which clients aren't told about */
+    if(xbpx->prop_changed_func) {
+        xbpx->prop_changed_func(BLCONF_BACKEND(xbpx), channel->name, NULL,
+                                xbpx->prop_changed_data);
+    }
+
+    for(l = changed; l; l = l->next) {
+        if(xbpx->prop_changed_func) {
+            xbpx->prop_changed_func(BLCONF_BACKEND(xbpx), channel->name,
+                                    l->data, xbpx->prop_changed_data);
+        }
+        g_free(l->data);
+    }
+    g_slist_free(changed);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_reload_timeout(gpointer data)
+{
+    BlconfBackendPerchannelXml *xbpx = data;
+    GHashTableIter iter;
+    gpointer key;
+    gboolean retry = FALSE;
+
+    g_hash_table_iter_init(&iter, xbpx->reload_channels);
+    while(g_hash_table_iter_next(&iter, &key, NULL)) {
+        BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, key);
+
+        if(channel && channel->write_job) {
+            /* wait until we know what we wrote ourselves */
+            retry = TRUE;
+            continue;
+        }
+
+        if(channel)
+            blconf_backend_perchannel_xml_reload_channel(xbpx, channel);
+        g_hash_table_iter_remove(&iter);
+    }
+
+    if(!retry)
+        xbpx->reload_id = 0;
+
+    return retry;
+}
+
+static void
+blconf_backend_perchannel_xml_queue_reload(BlconfBackendPerchannelXml *xbpx,
+                                           const gchar *channel_name)
+{
+    /* channels that aren't loaded will just be read fresh when they're
+     * first used, but what was said about them before may be wrong now */
+    if(!g_hash_table_lookup(xbpx->channels, channel_name)) {
+        if(xbpx->prop_changed_func) {
+            xbpx->prop_changed_func(BLCONF_BACKEND(xbpx), channel_name, NULL,
+                                    xbpx->prop_changed_data);
+        }
+        return;
+    }
+
+    g_hash_table_replace(xbpx->reload_channels, g_strdup(channel_name), NULL);
+
+    /* restart the timer, so we act once things have settled */
+    if(xbpx->reload_id)
+        g_source_remove(xbpx->reload_id);
+    xbpx->reload_id = g_timeout_add(RELOAD_DELAY,
+                                    blconf_backend_perchannel_xml_reload_timeout,
+                                    xbpx);
+}
+
+static void
+blconf_backend_perchannel_xml_queue_reload_all(gpointer key,
+                                               gpointer value,
+                                               gpointer user_data)
+{
+    blconf_backend_perchannel_xml_queue_reload(user_data, key);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_inotify_cb(GIOChannel *source,
+                                         GIOCondition condition,
+                                         gpointer data)
+{
+    BlconfBackendPerchannelXml *xbpx = data;
+    union {
+        struct inotify_event event;
+        gchar buf[4096];
+    } events;
+    gssize len;
+    gchar *p;
+
+    if(condition & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+        g_warning("Lost the config directory monitor; changes made on disk won't be picked up");
+        xbpx->inotify_watch_id = 0;
+
+        /* nothing would tell us when these go out of date anymore */
+        if(xbpx->registry) {
+            g_hash_table_destroy(xbpx->registry);
+            g_hash_table_destroy(xbpx->registry_files);
+            xbpx->registry = xbpx->registry_files = NULL;
+        }
+        blconf_backend_perchannel_xml_write_lock(xbpx);
+        g_hash_table_destroy(xbpx->resolved);
+        xbpx->resolved = NULL;
+        blconf_backend_perchannel_xml_write_unlock(xbpx);
+
+        return FALSE;
+    }
+
+    len = read(xbpx->inotify_fd, events.buf, sizeof(events.buf));
+    if(len <= 0)
+        return TRUE;
+
+    for(p = events.buf;
+        p < events.buf + len;
+        p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len)
+    {
+        struct inotify_event *event = (struct inotify_event *)p;
+        gchar *channel_name;
+
+        if(event->mask & IN_Q_OVERFLOW) {
+            /* we don't know what changed, so look at everything */
+            if(xbpx->registry) {
+                g_hash_table_destroy(xbpx->registry);
+                g_hash_table_destroy(xbpx->registry_files);
+                xbpx->registry = xbpx->registry_files = NULL;
+            }
+            blconf_backend_perchannel_xml_invalidate_resolved(xbpx, NULL);
+            g_hash_table_foreach(xbpx->channels,
+                                 blconf_backend_perchannel_xml_queue_reload_all,
+                                 xbpx);
+            continue;
+        }
+
+        if(!event->len || event->name[0] == '.')
+            continue;
+
+        if(xbpx->registry) {
+            const gchar *dir = g_hash_table_lookup(xbpx->watch_dirs,
+                                                   GINT_TO_POINTER(event->wd));
+
+            if(!dir)
+                ;
+            else if(event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                blconf_channel_registry_remove(xbpx->registry,
+                                               xbpx->registry_files,
+                                               dir, event->name);
+            } else {
+                blconf_channel_registry_add(xbpx->registry,
+                                            xbpx->registry_files,
+                                            dir, event->name);
+            }
+        }
+
+        if(g_str_has_suffix(event->name, ".xml")) {
+            channel_name = g_ascii_strdown(event->name,
+                                           strlen(event->name) - strlen(".xml"));
+            blconf_backend_perchannel_xml_invalidate_resolved(xbpx, channel_name);
+            blconf_backend_perchannel_xml_queue_reload(xbpx, channel_name);
+            g_free(channel_name);
+        } else if(g_str_has_suffix(event->name, ".journal")) {
+            channel_name = g_ascii_strdown(event->name,
+                                           strlen(event->name) - strlen(".journal"));
+            blconf_backend_perchannel_xml_invalidate_resolved(xbpx, channel_name);
+            g_free(channel_name);
+        }
+    }
+
+    return TRUE;
+}
+
+/* watches the per-channel directories in all the config dirs, so edits
+ * made to the files behind blconfd's back are picked up.  directories
+ * that don't exist yet aren't watched. */
+static void
+blconf_backend_perchannel_xml_watch_dirs(BlconfBackendPerchannelXml *xbpx)
+{
+    gchar **dirs;
+    GIOChannel *ioc;
+    gint i, n_watches = 0;
+
+    xbpx->inotify_fd = inotify_init();
+    if(xbpx->inotify_fd < 0) {
+        g_warning("Unable to monitor the config directories: %s",
+                  strerror(errno));
+        return;
+    }
+    fcntl(xbpx->inotify_fd, F_SETFD, FD_CLOEXEC);
+    fcntl(xbpx->inotify_fd, F_SETFL, O_NONBLOCK);
+
+    xbpx->watch_dirs = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                             NULL, (GDestroyNotify)g_free);
+
+    dirs = xfce_resource_lookup_all(XFCE_RESOURCE_CONFIG, CONFIG_DIR_STEM);
+    for(i = 0; dirs && dirs[i]; ++i) {
+        gint wd = inotify_add_watch(xbpx->inotify_fd, dirs[i],
+                                    IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO
+                                    | IN_MOVED_FROM | IN_DELETE);
+
+        if(wd < 0)
+            DBG("unable to watch \"%s\": %s", dirs[i], strerror(errno));
+        else {
+            g_hash_table_insert(xbpx->watch_dirs, GINT_TO_POINTER(wd),
+                                g_strdup(dirs[i]));
+            n_watches++;
+        }
+    }
+    g_strfreev(dirs);
+
+    if(!n_watches) {
+        g_hash_table_destroy(xbpx->watch_dirs);
+        xbpx->watch_dirs = NULL;
+        close(xbpx->inotify_fd);
+        xbpx->inotify_fd = -1;
+        return;
+    }
+
+    xbpx->reload_channels = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  (GDestroyNotify)g_free, NULL);
+    xbpx->resolved = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           (GDestroyNotify)g_free,
+                                           (GDestroyNotify)blconf_resolved_files_free);
+
+    ioc = g_io_channel_unix_new(xbpx->inotify_fd);
+    xbpx->inotify_watch_id = g_io_add_watch(ioc,
+                                            G_IO_IN | G_IO_ERR | G_IO_HUP,
+                                            blconf_backend_perchannel_xml_inotify_cb,
+                                            xbpx);
+    g_io_channel_unref(ioc);
+}
+
+#endif  /* HAVE_SYS_INOTIFY_H */
@@ -245,6 +245,82 @@ blconf_backend_set(BlconfBackend *backend,
     return iface->set(backend, channel, property, value, error);
 }
 
+/**
+ * blconf_backend_set_many:
+ * @backend: The #BlconfBackend.
+ * @channel: A channel name.
+ * @properties: A #GHashTable of property names to #GValue<!-- -->s.
+ * @error: An error return.
+ *
+ * Sets all of @properties on @channel.  Either every property is set,
+ * or, if any of them can't be (because it's locked, for example), none
+ * are.
+ *
+ * Backends don't have to implement this; for those that don't, the
+ * properties are checked with blconf_backend_is_property_locked() first
+ * and then set one at a time, so only a failure of the write itself can
+ * leave some of them set.
+ *
+ * Return value: The backend should return %TRUE if the operation
+ *               was successful, or %FALSE otherwise.  On %FALSE,
+ *               @error should be set to a description of the failure.
+ **/
+gboolean
+blconf_backend_set_many(BlconfBackend *backend,
+                        const gchar *channel,
+                        GHashTable *properties,
+                        GError **error)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+    GHashTableIter iter;
+    gpointer property, value;
+    
+    blconf_backend_return_val_if_fail(iface && iface->set && channel && *channel
+                                      && properties
+                                      && (!error || !*error), FALSE);
+    if(!blconf_channel_is_valid(channel, error))
+        return FALSE;
+
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &property, &value)) {
+        if(!value || !blconf_property_is_valid(property, error))
+            return FALSE;
+    }
+
+    if(iface->set_many)
+        return iface->set_many(backend, channel, properties, error);
+
+    if(iface->is_property_locked) {
+        g_hash_table_iter_init(&iter, properties);
+        while(g_hash_table_iter_next(&iter, &property, NULL)) {
+            gboolean locked = FALSE;
+
+            if(!iface->is_property_locked(backend, channel, property,
+                                          &locked, error))
+            {
+                return FALSE;
+            }
+            if(locked) {
+                if(error) {
+                    g_set_error(error, BLCONF_ERROR,
+                                BLCONF_ERROR_PERMISSION_DENIED,
+                                _("Permission denied while modifying property \"%s\" on channel \"%s\""),
+                                (const gchar *)property, channel);
+                }
+                return FALSE;
+            }
+        }
+    }
+
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &property, &value)) {
+        if(!iface->set(backend, channel, property, value, error))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  * blconf_backend_get:
  * @backend: The #BlconfBackend.
@@ -279,6 +355,66 @@ blconf_backend_get(BlconfBackend *backend,
     return iface->get(backend, channel, property, value, error);
 }
 
+/**
+ * blconf_backend_get_many:
+ * @backend: The #BlconfBackend.
+ * @channel: A channel name.
+ * @properties: A %NULL-terminated array of property names.
+ * @values: A #GHashTable.
+ * @error: An error return.
+ *
+ * Gets the values of those of @properties that exist on @channel and
+ * adds them to @values, with the (newly-allocated) property names as
+ * keys and (newly-allocated) #GValue<!-- -->s as values.  Properties
+ * that don't exist are skipped, and properties already in @values are
+ * left alone.
+ *
+ * Backends don't have to implement this; for those that don't, the
+ * properties are fetched one at a time with blconf_backend_get().
+ *
+ * Return value: The backend should return %TRUE if the operation
+ *               was successful, or %FALSE otherwise.  On %FALSE,
+ *               @error should be set to a description of the failure.
+ **/
+gboolean
+blconf_backend_get_many(BlconfBackend *backend,
+                        const gchar *channel,
+                        const gchar * const *properties,
+                        GHashTable *values,
+                        GError **error)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+    gint i;
+    
+    blconf_backend_return_val_if_fail(iface && iface->get && channel && *channel
+                                      && properties && values
+                                      && (!error || !*error), FALSE);
+    if(!blconf_channel_is_valid(channel, error))
+        return FALSE;
+    for(i = 0; properties[i]; ++i) {
+        if(!blconf_property_is_valid(properties[i], error))
+            return FALSE;
+    }
+
+    if(iface->get_many)
+        return iface->get_many(backend, channel, properties, values, error);
+
+    for(i = 0; properties[i]; ++i) {
+        GValue *value;
+
+        if(g_hash_table_lookup(values, properties[i]))
+            continue;
+
+        value = g_new0(GValue, 1);
+        if(iface->get(backend, channel, properties[i], value, NULL))
+            g_hash_table_insert(values, g_strdup(properties[i]), value);
+        else
+            g_free(value);
+    }
+
+    return TRUE;
+}
+
 /**
  * blconf_backend_get_all:
  * @backend: The #BlconfBackend.
@@ -323,6 +459,68 @@ blconf_backend_get_all(BlconfBackend *backend,
     return iface->get_all(backend, channel, property_base, properties, error);
 }
 
+/**
+ * blconf_backend_has_get_all_foreach:
+ * @backend: The #BlconfBackend.
+ *
+ * Checks whether @backend implements blconf_backend_get_all_foreach().
+ *
+ * Return value: %TRUE if it does, %FALSE otherwise.
+ **/
+gboolean
+blconf_backend_has_get_all_foreach(BlconfBackend *backend)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+
+    return iface && iface->get_all_foreach;
+}
+
+/**
+ * blconf_backend_get_all_foreach:
+ * @backend: The #BlconfBackend.
+ * @channel: A channel name.
+ * @property_base: The base of properties to visit.
+ * @func: A function to call for each property.
+ * @user_data: Data to pass to @func.
+ * @error: An error return.
+ *
+ * Like blconf_backend_get_all(), but instead of copying the properties
+ * into a hash table, calls @func with the full name and value of each
+ * one.  Both are owned by the backend and only valid during the call.
+ * If @func returns %FALSE, no further properties are visited.
+ *
+ * This is optional for backends; see
+ * blconf_backend_has_get_all_foreach().
+ *
+ * Return value: The backend should return %TRUE if the operation
+ *               was successful, or %FALSE otherwise.  On %FALSE,
+ *               @error should be set to a description of the failure.
+ **/
+gboolean
+blconf_backend_get_all_foreach(BlconfBackend *backend,
+                               const gchar *channel,
+                               const gchar *property_base,
+                               BlconfPropertyVisitFunc func,
+                               gpointer user_data,
+                               GError **error)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+    
+    blconf_backend_return_val_if_fail(iface && iface->get_all_foreach
+                                      && channel && *channel && property_base
+                                      && func && (!error || !*error), FALSE);
+    if(!blconf_channel_is_valid(channel, error))
+        return FALSE;
+    if(*property_base && !(property_base[0] == '/' && !property_base[1])
+       && !blconf_property_is_valid(property_base, error))
+    {
+        return FALSE;
+    }
+
+    return iface->get_all_foreach(backend, channel, property_base, func,
+                                  user_data, error);
+}
+
 /**
  * blconf_backend_exists:
  * @backend: The #BlconfBackend.
@@ -411,6 +609,119 @@ blconf_backend_reset(BlconfBackend *backend,
     return iface->reset(backend, channel, property, recursive, error);
 }
 
+/**
+ * blconf_backend_reset_many:
+ * @backend: The #BlconfBackend.
+ * @channel: A channel name.
+ * @properties: A %NULL-terminated array of property names.
+ * @recursive: Whether or not the resets are recursive.
+ * @error: An error return.
+ *
+ * Like blconf_backend_reset() for each of @properties, except that if
+ * any of them can't be reset, none of them are.
+ *
+ * Backends don't have to implement this; for those that don't, the
+ * properties are reset one at a time, stopping at the first failure.
+ *
+ * Return value: The backend should return %TRUE if the operation
+ *               was successful, or %FALSE otherwise.  On %FALSE,
+ *               @error should be set to a description of the failure.
+ **/
+gboolean
+blconf_backend_reset_many(BlconfBackend *backend,
+                          const gchar *channel,
+                          const gchar * const *properties,
+                          gboolean recursive,
+                          GError **error)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+    gint i;
+    
+    blconf_backend_return_val_if_fail(iface && iface->reset && channel
+                                      && *channel && properties
+                                      && (!error || !*error), FALSE);
+    if(!blconf_channel_is_valid(channel, error))
+        return FALSE;
+
+    for(i = 0; properties[i]; ++i) {
+        const gchar *property = properties[i];
+
+        if(!recursive && (!*property || (property[0] == '/' && !property[1]))) {
+            if(error) {
+                g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_INVALID_PROPERTY,
+                            _("The property name can only be empty or \"/\" if a recursive reset was specified"));
+            }
+            return FALSE;
+        }
+        if(*property && !(property[0] == '/' && !property[1])
+           && !blconf_property_is_valid(property, error))
+        {
+            return FALSE;
+        }
+    }
+
+    if(iface->reset_many)
+        return iface->reset_many(backend, channel, properties, recursive, error);
+
+    for(i = 0; properties[i]; ++i) {
+        if(!iface->reset(backend, channel, properties[i], recursive, error))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * blconf_backend_can_reset:
+ * @backend: The #BlconfBackend.
+ * @channel: A channel name.
+ * @property: A property name.
+ * @recursive: Whether or not the reset would be recursive.
+ * @error: An error return.
+ *
+ * Finds out whether blconf_backend_reset() would succeed, without
+ * changing anything.
+ *
+ * Backends don't have to implement this; for those that don't, any
+ * reset of a valid property is assumed to succeed.
+ *
+ * Return value: %TRUE if the reset would succeed, or %FALSE with @error
+ *               set to what blconf_backend_reset() would report.
+ **/
+gboolean
+blconf_backend_can_reset(BlconfBackend *backend,
+                         const gchar *channel,
+                         const gchar *property,
+                         gboolean recursive,
+                         GError **error)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+    
+    blconf_backend_return_val_if_fail(iface && channel && *channel
+                                      && property
+                                      && (!error || !*error), FALSE);
+    if(!blconf_channel_is_valid(channel, error))
+        return FALSE;
+
+    if(!recursive && (!*property || (property[0] == '/' && !property[1]))) {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_INVALID_PROPERTY,
+                        _("The property name can only be empty or \"/\" if a recursive reset was specified"));
+        }
+        return FALSE;
+    }
+    if(*property && !(property[0] == '/' && !property[1])
+       && !blconf_property_is_valid(property, error))
+    {
+        return FALSE;
+    }
+
+    if(!iface->can_reset)
+        return TRUE;
+
+    return iface->can_reset(backend, channel, property, recursive, error);
+}
+
 /**
  * blconf_backend_list_channels:
  * @backend: The #BlconfBackend.
@@ -504,6 +815,11 @@ blconf_backend_flush(BlconfBackend *backend,
  * Registers a function to be called when a property changes.  The
  * backend implementation should keep a pointer to @func and @user_data
  * and call @func when a property in the configuration store changes.
+ *
+ * A backend may also call @func with a %NULL property when something
+ * about the channel that isn't a property value changed (for example,
+ * which properties are locked), so any answers cached about the channel
+ * should be forgotten.  No change notification is sent for those.
  **/
 void
 blconf_backend_register_property_changed_func(BlconfBackend *backend,
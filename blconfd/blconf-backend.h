@@ -57,6 +57,10 @@ typedef void (*BlconfPropertyChangedFunc)(BlconfBackend *backend,
                                           const gchar *property,
                                           gpointer user_data);
 
+typedef gboolean (*BlconfPropertyVisitFunc)(const gchar *property,
+                                            const GValue *value,
+                                            gpointer user_data);
+
 struct _BlconfBackendInterface
 {
     GTypeInterface parent;
@@ -111,11 +115,40 @@ struct _BlconfBackendInterface
                                            BlconfPropertyChangedFunc func,
                                            gpointer user_data);
     
-    /*< reserved for future expansion >*/
-    void (*_xb_reserved0)();
-    void (*_xb_reserved1)();
-    void (*_xb_reserved2)();
-    void (*_xb_reserved3)();
+    /* optional */
+    gboolean (*get_all_foreach)(BlconfBackend *backend,
+                                const gchar *channel,
+                                const gchar *property_base,
+                                BlconfPropertyVisitFunc func,
+                                gpointer user_data,
+                                GError **error);
+    
+    /* optional */
+    gboolean (*set_many)(BlconfBackend *backend,
+                         const gchar *channel,
+                         GHashTable *properties,
+                         GError **error);
+    
+    /* optional */
+    gboolean (*reset_many)(BlconfBackend *backend,
+                           const gchar *channel,
+                           const gchar * const *properties,
+                           gboolean recursive,
+                           GError **error);
+    
+    /* optional */
+    gboolean (*get_many)(BlconfBackend *backend,
+                         const gchar *channel,
+                         const gchar * const *properties,
+                         GHashTable *values,
+                         GError **error);
+    
+    /* optional */
+    gboolean (*can_reset)(BlconfBackend *backend,
+                          const gchar *channel,
+                          const gchar *property,
+                          gboolean recursive,
+                          GError **error);
 };
 
 GType blconf_backend_get_type(void) G_GNUC_CONST;
@@ -129,18 +162,38 @@ gboolean blconf_backend_set(BlconfBackend *backend,
                             const GValue *value,
                             GError **error);
 
+gboolean blconf_backend_set_many(BlconfBackend *backend,
+                                 const gchar *channel,
+                                 GHashTable *properties,
+                                 GError **error);
+
 gboolean blconf_backend_get(BlconfBackend *backend,
                             const gchar *channel,
                             const gchar *property,
                             GValue *value,
                             GError **error);
 
+gboolean blconf_backend_get_many(BlconfBackend *backend,
+                                 const gchar *channel,
+                                 const gchar * const *properties,
+                                 GHashTable *values,
+                                 GError **error);
+
 gboolean blconf_backend_get_all(BlconfBackend *backend,
                                 const gchar *channel,
                                 const gchar *property_base,
                                 GHashTable *properties,
                                 GError **error);
 
+gboolean blconf_backend_has_get_all_foreach(BlconfBackend *backend);
+
+gboolean blconf_backend_get_all_foreach(BlconfBackend *backend,
+                                        const gchar *channel,
+                                        const gchar *property_base,
+                                        BlconfPropertyVisitFunc func,
+                                        gpointer user_data,
+                                        GError **error);
+
 gboolean blconf_backend_exists(BlconfBackend *backend,
                                const gchar *channel,
                                const gchar *property,
@@ -153,6 +206,18 @@ gboolean blconf_backend_reset(BlconfBackend *backend,
                               gboolean recursive,
                               GError **error);
 
+gboolean blconf_backend_reset_many(BlconfBackend *backend,
+                                   const gchar *channel,
+                                   const gchar * const *properties,
+                                   gboolean recursive,
+                                   GError **error);
+
+gboolean blconf_backend_can_reset(BlconfBackend *backend,
+                                  const gchar *channel,
+                                  const gchar *property,
+                                  gboolean recursive,
+                                  GError **error);
+
 gboolean blconf_backend_list_channels(BlconfBackend *backend,
                                       GSList **channels,
                                       GError **error);
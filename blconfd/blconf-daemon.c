@@ -32,6 +32,7 @@
 #include "common/blconf-marshal.h"
 #include "common/blconf-gvaluefuncs.h"
 #include "blconf/blconf-errors.h"
+#include "blconf/blconf-types.h"
 #include "common/blconf-common-private.h"
 
 static void blconf_set_property(BlconfDaemon *blconfd,
@@ -39,10 +40,18 @@ static void blconf_set_property(BlconfDaemon *blconfd,
                                 const gchar *property,
                                 const GValue *value,
                                 DBusGMethodInvocation *context);
+static void blconf_set_properties(BlconfDaemon *blconfd,
+                                  const gchar *channel,
+                                  GHashTable *properties,
+                                  DBusGMethodInvocation *context);
 static void blconf_get_property(BlconfDaemon *blconfd,
                                 const gchar *channel,
                                 const gchar *property,
                                 DBusGMethodInvocation *context);
+static void blconf_get_properties(BlconfDaemon *blconfd,
+                                  const gchar *channel,
+                                  const gchar **properties,
+                                  DBusGMethodInvocation *context);
 static void blconf_get_all_properties(BlconfDaemon *blconfd,
                                       const gchar *channel,
                                       const gchar *property_base,
@@ -56,6 +65,11 @@ static void blconf_reset_property(BlconfDaemon *blconfd,
                                   const gchar *property,
                                   gboolean recursive,
                                   DBusGMethodInvocation *context);
+static void blconf_reset_properties(BlconfDaemon *blconfd,
+                                    const gchar *channel,
+                                    const gchar **properties,
+                                    gboolean recursive,
+                                    DBusGMethodInvocation *context);
 static void blconf_list_channels(BlconfDaemon *blconfd,
                                  DBusGMethodInvocation *context);
 static void blconf_is_property_locked(BlconfDaemon *blconfd,
@@ -65,6 +79,15 @@ static void blconf_is_property_locked(BlconfDaemon *blconfd,
 
 #include "blconf-dbus-server.h"
 
+/* with more than one backend, at most this many channels (and this many
+ * properties per channel) are remembered by the resolver */
+#define ROUTES_MAX_CHANNELS    (256)
+#define ROUTES_MAX_PROPERTIES  (1024)
+
+/* how often (in seconds) to log how many notifications the rate limits
+ * held back */
+#define RATE_LIMIT_REPORT_INTERVAL  (300)
+
 struct _BlconfDaemon
 {
     GObject parent;
@@ -72,8 +95,69 @@ struct _BlconfDaemon
     DBusGConnection *dbus_conn;
 
     GList *backends;
+
+    /* only used with more than one backend: channel name -> BlconfRoute */
+    GHashTable *routes;
+
+    /* changes reported by the backends since the last PropertiesChanged:
+     * channel name -> (property name -> reporting BlconfBackend) */
+    GHashTable *pending_changes;
+    guint pending_changes_id;
+    /* whether PropertyChanged and PropertyRemoved are sent as well */
+    gboolean legacy_signals;
+
+    /* BlconfRateLimit rules from the command line, and the throttle state
+     * of each property that changed within its rule's interval:
+     * "channel/property" (with the channel name lowercased) ->
+     * BlconfThrottle */
+    GSList *rate_limits;
+    GHashTable *throttles;
+    guint rate_limit_report_id;
 };
 
+/* which backend answers for each property of a channel, so a Get or Set
+ * doesn't have to ask all of them every time.  a property's owner is
+ * forgotten when a backend reports a change to it (or a reset of anything
+ * above it); lock verdicts only when a backend says the channel changed
+ * in some other way. */
+typedef struct
+{
+    /* property -> first backend that has it, or BLCONF_ROUTE_NO_OWNER */
+    GHashTable *owners;
+    /* property -> GINT_TO_POINTER(1) if it's locked on any backend, or
+     * GINT_TO_POINTER(-1) if it's locked on none */
+    GHashTable *locks;
+} BlconfRoute;
+
+#define BLCONF_ROUTE_NO_OWNER  ((gpointer)&blconf_route_no_owner)
+static const gchar blconf_route_no_owner = 0;
+
+/* change notifications for properties matching a rate limit rule are sent
+ * at most once per interval; the last change in a burst is always sent,
+ * it just might be sent late. */
+typedef struct
+{
+    gchar *channel;
+    gchar *prefix;  /* "" for the whole channel */
+    guint interval;  /* in ms */
+    guint64 suppressed;
+    guint64 reported;  /* how many of |suppressed| were logged already */
+} BlconfRateLimit;
+
+/* a property that has sent a notification less than an interval ago.  it
+ * goes away when an interval passes without any more changes. */
+typedef struct
+{
+    BlconfDaemon *blconfd;
+    BlconfRateLimit *rate_limit;
+    gchar *channel;
+    gchar *property;
+    guint timeout_id;  /* fires when the current interval is over */
+    gboolean held;  /* whether a change waits for the interval to end */
+    BlconfBackend *backend;  /* the backend that reported the held change */
+    guint suppressed;  /* in the current burst */
+} BlconfThrottle;
+
 typedef struct _BlconfDaemonClass
 {
     GObjectClass parent;
@@ -83,10 +167,13 @@ enum
 {
     SIG_PROPERTY_CHANGED = 0,
     SIG_PROPERTY_REMOVED,
+    SIG_PROPERTIES_CHANGED,
     N_SIGS,
 };
 
 static void blconf_daemon_finalize(GObject *obj);
+static void blconf_daemon_clear_rate_limits(BlconfDaemon *blconfd,
+                                            gboolean flush);
 
 static DBusHandlerResult blconf_daemon_handle_dbus_disconnect(DBusConnection *conn,
                                                               DBusMessage *message,
@@ -126,6 +213,17 @@ blconf_daemon_class_init(BlconfDaemonClass *klass)
                                                  2, G_TYPE_STRING,
                                                  G_TYPE_STRING);
 
+    signals[SIG_PROPERTIES_CHANGED] = g_signal_new(I_("properties-changed"),
+                                                   BLCONF_TYPE_DAEMON,
+                                                   G_SIGNAL_RUN_LAST,
+                                                   0,
+                                                   NULL, NULL,
+                                                   _blconf_marshal_VOID__STRING_BOXED_BOXED,
+                                                   G_TYPE_NONE,
+                                                   3, G_TYPE_STRING,
+                                                   BLCONF_TYPE_G_STRING_VALUE_HASHTABLE,
+                                                   G_TYPE_STRV);
+
     dbus_g_object_type_install_info(G_TYPE_FROM_CLASS(klass),
                                     &dbus_glib_blconf_object_info);
     dbus_g_error_domain_register(BLCONF_ERROR, "org.blade.Blconf.Error",
@@ -151,6 +249,16 @@ blconf_daemon_finalize(GObject *obj)
     }
     g_list_free(blconfd->backends);
 
+    if(blconfd->routes)
+        g_hash_table_destroy(blconfd->routes);
+
+    if(blconfd->pending_changes_id)
+        g_source_remove(blconfd->pending_changes_id);
+    if(blconfd->pending_changes)
+        g_hash_table_destroy(blconfd->pending_changes);
+
+    blconf_daemon_clear_rate_limits(blconfd, FALSE);
+
     if(blconfd->dbus_conn) {
         dbus_connection_remove_filter(dbus_g_connection_get_connection(blconfd->dbus_conn),
                                       blconf_daemon_handle_dbus_disconnect,
@@ -161,55 +269,476 @@ blconf_daemon_finalize(GObject *obj)
     G_OBJECT_CLASS(blconf_daemon_parent_class)->finalize(obj);
 }
 
-typedef struct
+static guint
+blconf_daemon_channel_hash(gconstpointer key)
 {
-    BlconfDaemon *blconfd;
-    BlconfBackend *backend;
-    gchar *channel;
-    gchar *property;
-} BlconfPropChangedData;
+    const gchar *p = key;
+    guint h = 5381;
+
+    /* channel names are case-insensitive */
+    for(; *p; ++p)
+        h = (h << 5) + h + g_ascii_tolower(*p);
+
+    return h;
+}
 
 static gboolean
-blconf_daemon_emit_property_changed_idled(gpointer data)
+blconf_daemon_channel_equal(gconstpointer a,
+                            gconstpointer b)
 {
-    BlconfPropChangedData *pdata = data;
-    GValue value = { 0, };
+    return !g_ascii_strcasecmp(a, b);
+}
 
-    blconf_backend_get(pdata->backend, pdata->channel, pdata->property,
-                       &value, NULL);
+static void
+blconf_route_free(BlconfRoute *route)
+{
+    g_hash_table_destroy(route->owners);
+    g_hash_table_destroy(route->locks);
+    g_slice_free(BlconfRoute, route);
+}
 
-    if(G_VALUE_TYPE(&value)) {
-        g_signal_emit(G_OBJECT(pdata->blconfd), signals[SIG_PROPERTY_CHANGED],
-                      0, pdata->channel, pdata->property, &value);
-        g_value_unset(&value);
-    } else {
-        g_signal_emit(G_OBJECT(pdata->blconfd), signals[SIG_PROPERTY_REMOVED],
-                      0, pdata->channel, pdata->property);
+static BlconfRoute *
+blconf_daemon_get_route(BlconfDaemon *blconfd,
+                        const gchar *channel)
+{
+    BlconfRoute *route;
+
+    if(G_UNLIKELY(!blconfd->routes)) {
+        blconfd->routes = g_hash_table_new_full(blconf_daemon_channel_hash,
+                                                blconf_daemon_channel_equal,
+                                                (GDestroyNotify)g_free,
+                                                (GDestroyNotify)blconf_route_free);
     }
 
-    g_object_unref(G_OBJECT(pdata->backend));
-    g_free(pdata->channel);
-    g_free(pdata->property);
-    g_object_unref(G_OBJECT(pdata->blconfd));
-    g_slice_free(BlconfPropChangedData, pdata);
+    route = g_hash_table_lookup(blconfd->routes, channel);
+    if(!route) {
+        /* clients asking for lots of made-up channels shouldn't make this
+         * grow without bounds */
+        if(g_hash_table_size(blconfd->routes) >= ROUTES_MAX_CHANNELS)
+            g_hash_table_remove_all(blconfd->routes);
+
+        route = g_slice_new(BlconfRoute);
+        route->owners = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              (GDestroyNotify)g_free, NULL);
+        route->locks = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                             (GDestroyNotify)g_free, NULL);
+        g_hash_table_insert(blconfd->routes, g_strdup(channel), route);
+    }
+
+    return route;
+}
+
+static void
+blconf_route_insert(GHashTable *table,
+                    const gchar *property,
+                    gpointer value)
+{
+    if(g_hash_table_size(table) >= ROUTES_MAX_PROPERTIES)
+        g_hash_table_remove_all(table);
+    g_hash_table_replace(table, g_strdup(property), value);
+}
+
+static gboolean
+blconf_route_is_below(gpointer key,
+                      gpointer value,
+                      gpointer user_data)
+{
+    const gchar *property = key, *base = user_data;
+    gsize len = strlen(base);
+
+    return !strncmp(property, base, len)
+           && (property[len] == '\0' || property[len] == '/');
+}
+
+/* forgets who owns |property| (and everything below it, if |recursive|),
+ * or everything about |channel| if |property| is NULL */
+static void
+blconf_daemon_forget_route(BlconfDaemon *blconfd,
+                           const gchar *channel,
+                           const gchar *property,
+                           gboolean recursive)
+{
+    BlconfRoute *route;
+
+    if(!blconfd->routes)
+        return;
+
+    if(!property || (recursive && !strcmp(property, "/"))) {
+        g_hash_table_remove(blconfd->routes, channel);
+        return;
+    }
+
+    route = g_hash_table_lookup(blconfd->routes, channel);
+    if(!route)
+        return;
+
+    /* setting or resetting a property never changes whether it's locked */
+    if(recursive) {
+        g_hash_table_foreach_remove(route->owners, blconf_route_is_below,
+                                    (gpointer)property);
+    } else
+        g_hash_table_remove(route->owners, property);
+}
+
+/* finds out whether |property| is locked on any of the backends, asking
+ * them only if we don't know yet */
+static gboolean
+blconf_daemon_is_property_locked(BlconfDaemon *blconfd,
+                                 const gchar *channel,
+                                 const gchar *property,
+                                 gboolean *locked,
+                                 GError **error)
+{
+    BlconfRoute *route = blconf_daemon_get_route(blconfd, channel);
+    gpointer verdict = g_hash_table_lookup(route->locks, property);
+    GList *l;
+
+    if(verdict) {
+        *locked = GPOINTER_TO_INT(verdict) > 0;
+        return TRUE;
+    }
+
+    *locked = FALSE;
+    for(l = blconfd->backends; l; l = l->next) {
+        if(!blconf_backend_is_property_locked(l->data, channel, property,
+                                              locked, error))
+        {
+            return FALSE;
+        }
+
+        if(*locked)
+            break;
+    }
+
+    blconf_route_insert(route->locks, property,
+                        GINT_TO_POINTER(*locked ? 1 : -1));
+
+    return TRUE;
+}
+
+/* sends one PropertiesChanged per channel for everything that changed
+ * since the last time.  properties that changed more than once only show
+ * up once, with their current value.  if asked to, PropertyChanged and
+ * PropertyRemoved follow, coalesced the same way, for clients that only
+ * know about those. */
+static gboolean
+blconf_daemon_emit_properties_changed_idled(gpointer data)
+{
+    BlconfDaemon *blconfd = data;
+    GHashTable *pending_changes = blconfd->pending_changes;
+    GHashTableIter channel_iter, prop_iter;
+    gpointer channel, properties, property, backend, prop_value;
+    guint i;
+
+    blconfd->pending_changes = NULL;
+    blconfd->pending_changes_id = 0;
+
+    g_hash_table_iter_init(&channel_iter, pending_changes);
+    while(g_hash_table_iter_next(&channel_iter, &channel, &properties)) {
+        GHashTable *changed;
+        GPtrArray *removed;
+
+        changed = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                        (GDestroyNotify)_blconf_gvalue_free);
+        removed = g_ptr_array_new();
+
+        g_hash_table_iter_init(&prop_iter, properties);
+        while(g_hash_table_iter_next(&prop_iter, &property, &backend)) {
+            GValue *value = g_new0(GValue, 1);
+
+            if(blconf_backend_get(backend, channel, property, value, NULL))
+                g_hash_table_insert(changed, property, value);
+            else {
+                g_free(value);
+                g_ptr_array_add(removed, property);
+            }
+        }
+        g_ptr_array_add(removed, NULL);
+
+        g_signal_emit(G_OBJECT(blconfd), signals[SIG_PROPERTIES_CHANGED], 0,
+                      channel, changed, removed->pdata);
+
+        if(blconfd->legacy_signals) {
+            g_hash_table_iter_init(&prop_iter, changed);
+            while(g_hash_table_iter_next(&prop_iter, &property, &prop_value)) {
+                g_signal_emit(G_OBJECT(blconfd), signals[SIG_PROPERTY_CHANGED], 0,
+                              channel, property, prop_value);
+            }
+            for(i = 0; i < removed->len - 1; ++i) {
+                g_signal_emit(G_OBJECT(blconfd), signals[SIG_PROPERTY_REMOVED], 0,
+                              channel, g_ptr_array_index(removed, i));
+            }
+        }
+
+        g_hash_table_destroy(changed);
+        g_ptr_array_free(removed, TRUE);
+    }
+
+    g_hash_table_destroy(pending_changes);
 
     return FALSE;
 }
 
+static void
+blconf_daemon_queue_change(BlconfDaemon *blconfd,
+                           BlconfBackend *backend,
+                           const gchar *channel,
+                           const gchar *property)
+{
+    GHashTable *properties;
+
+    if(!blconfd->pending_changes) {
+        blconfd->pending_changes = g_hash_table_new_full(blconf_daemon_channel_hash,
+                                                         blconf_daemon_channel_equal,
+                                                         (GDestroyNotify)g_free,
+                                                         (GDestroyNotify)g_hash_table_destroy);
+    }
+
+    properties = g_hash_table_lookup(blconfd->pending_changes, channel);
+    if(!properties) {
+        properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           (GDestroyNotify)g_free, NULL);
+        g_hash_table_insert(blconfd->pending_changes, g_strdup(channel),
+                            properties);
+    }
+    g_hash_table_replace(properties, g_strdup(property), backend);
+
+    if(!blconfd->pending_changes_id) {
+        blconfd->pending_changes_id = g_idle_add(blconf_daemon_emit_properties_changed_idled,
+                                                 blconfd);
+    }
+}
+
+static void
+blconf_throttle_free(BlconfThrottle *throttle)
+{
+    if(throttle->timeout_id)
+        g_source_remove(throttle->timeout_id);
+    g_free(throttle->channel);
+    g_free(throttle->property);
+    g_slice_free(BlconfThrottle, throttle);
+}
+
+static void
+blconf_rate_limit_free(BlconfRateLimit *rate_limit)
+{
+    g_free(rate_limit->channel);
+    g_free(rate_limit->prefix);
+    g_slice_free(BlconfRateLimit, rate_limit);
+}
+
+/* the most specific rule covering the property, if any */
+static BlconfRateLimit *
+blconf_daemon_find_rate_limit(BlconfDaemon *blconfd,
+                              const gchar *channel,
+                              const gchar *property)
+{
+    BlconfRateLimit *best = NULL;
+    gsize best_len = 0;
+    GSList *l;
+
+    for(l = blconfd->rate_limits; l; l = l->next) {
+        BlconfRateLimit *rate_limit = l->data;
+        gsize len = strlen(rate_limit->prefix);
+
+        if(g_ascii_strcasecmp(rate_limit->channel, channel))
+            continue;
+        if(strncmp(rate_limit->prefix, property, len)
+           || (property[len] != '\0' && property[len] != '/'))
+        {
+            continue;
+        }
+
+        if(!best || len > best_len) {
+            best = rate_limit;
+            best_len = len;
+        }
+    }
+
+    return best;
+}
+
+/* sends the held change, if any */
+static void
+blconf_throttle_flush(BlconfThrottle *throttle)
+{
+    if(!throttle->held)
+        return;
+
+    if(throttle->suppressed) {
+        DBG("rate limit on %s%s dropped %u notifications",
+            throttle->channel, throttle->property, throttle->suppressed);
+        throttle->suppressed = 0;
+    }
+
+    /* the value is read when the signal goes out, so this is always the
+     * latest one */
+    throttle->held = FALSE;
+    blconf_daemon_queue_change(throttle->blconfd, throttle->backend,
+                               throttle->channel, throttle->property);
+}
+
+static gboolean
+blconf_daemon_throttle_timeout(gpointer data)
+{
+    BlconfThrottle *throttle = data;
+    gchar *lower, *key;
+
+    if(throttle->held) {
+        /* sending it starts another interval */
+        blconf_throttle_flush(throttle);
+        return TRUE;
+    }
+
+    /* a whole interval went by without changes, so the next one can go
+     * out right away; there's nothing to remember until then */
+    throttle->timeout_id = 0;
+    lower = g_ascii_strdown(throttle->channel, -1);
+    key = g_strconcat(lower, throttle->property, NULL);
+    g_hash_table_remove(throttle->blconfd->throttles, key);
+    g_free(key);
+    g_free(lower);
+
+    return FALSE;
+}
+
+/* returns TRUE if the change has been held back */
+static gboolean
+blconf_daemon_throttle_change(BlconfDaemon *blconfd,
+                              BlconfBackend *backend,
+                              const gchar *channel,
+                              const gchar *property)
+{
+    BlconfRateLimit *rate_limit;
+    BlconfThrottle *throttle;
+    gchar *lower, *key;
+
+    if(!blconfd->rate_limits)
+        return FALSE;
+
+    lower = g_ascii_strdown(channel, -1);
+    key = g_strconcat(lower, property, NULL);
+    g_free(lower);
+
+    throttle = blconfd->throttles ? g_hash_table_lookup(blconfd->throttles, key) : NULL;
+    if(throttle) {
+        g_free(key);
+
+        if(throttle->held) {
+            /* the held change will never be seen on its own */
+            throttle->suppressed++;
+            throttle->rate_limit->suppressed++;
+        }
+        throttle->held = TRUE;
+        throttle->backend = backend;
+
+        return TRUE;
+    }
+
+    rate_limit = blconf_daemon_find_rate_limit(blconfd, channel, property);
+    if(!rate_limit) {
+        g_free(key);
+        return FALSE;
+    }
+
+    if(!blconfd->throttles) {
+        blconfd->throttles = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                   (GDestroyNotify)g_free,
+                                                   (GDestroyNotify)blconf_throttle_free);
+    }
+
+    /* this one goes out now, and starts the interval */
+    throttle = g_slice_new0(BlconfThrottle);
+    throttle->blconfd = blconfd;
+    throttle->rate_limit = rate_limit;
+    throttle->channel = g_strdup(channel);
+    throttle->property = g_strdup(property);
+    throttle->timeout_id = g_timeout_add(rate_limit->interval,
+                                         blconf_daemon_throttle_timeout,
+                                         throttle);
+    g_hash_table_insert(blconfd->throttles, key, throttle);
+
+    return FALSE;
+}
+
+/* logs how many notifications each rule held back since the last time */
+static void
+blconf_daemon_report_rate_limits(BlconfDaemon *blconfd)
+{
+    GSList *l;
+
+    for(l = blconfd->rate_limits; l; l = l->next) {
+        BlconfRateLimit *rate_limit = l->data;
+
+        if(rate_limit->suppressed == rate_limit->reported)
+            continue;
+
+        g_message("Rate limit %s%s=%u suppressed %" G_GUINT64_FORMAT
+                  " change notifications (%" G_GUINT64_FORMAT " in total)",
+                  rate_limit->channel, rate_limit->prefix,
+                  rate_limit->interval,
+                  rate_limit->suppressed - rate_limit->reported,
+                  rate_limit->suppressed);
+        rate_limit->reported = rate_limit->suppressed;
+    }
+}
+
+static gboolean
+blconf_daemon_report_rate_limits_timeout(gpointer data)
+{
+    blconf_daemon_report_rate_limits(data);
+    return TRUE;
+}
+
+/* drops all rules and throttle state, sending the held changes first if
+ * |flush| is TRUE */
+static void
+blconf_daemon_clear_rate_limits(BlconfDaemon *blconfd,
+                                gboolean flush)
+{
+    GSList *l;
+
+    if(blconfd->throttles) {
+        if(flush) {
+            GHashTableIter iter;
+            gpointer throttle;
+
+            g_hash_table_iter_init(&iter, blconfd->throttles);
+            while(g_hash_table_iter_next(&iter, NULL, &throttle))
+                blconf_throttle_flush(throttle);
+        }
+        g_hash_table_destroy(blconfd->throttles);
+        blconfd->throttles = NULL;
+    }
+
+    if(blconfd->rate_limit_report_id) {
+        g_source_remove(blconfd->rate_limit_report_id);
+        blconfd->rate_limit_report_id = 0;
+    }
+    blconf_daemon_report_rate_limits(blconfd);
+
+    for(l = blconfd->rate_limits; l; l = l->next)
+        blconf_rate_limit_free(l->data);
+    g_slist_free(blconfd->rate_limits);
+    blconfd->rate_limits = NULL;
+}
+
 static void
 blconf_daemon_backend_property_changed(BlconfBackend *backend,
                                        const gchar *channel,
                                        const gchar *property,
                                        gpointer user_data)
 {
-    BlconfPropChangedData *pdata = g_slice_new0(BlconfPropChangedData);
+    BlconfDaemon *blconfd = user_data;
 
-    pdata->blconfd = g_object_ref(G_OBJECT(user_data));
-    pdata->backend = g_object_ref(G_OBJECT(backend));
-    pdata->channel = g_strdup(channel);
-    pdata->property = g_strdup(property);
+    blconf_daemon_forget_route(blconfd, channel, property, FALSE);
 
-    g_idle_add(blconf_daemon_emit_property_changed_idled, pdata);
+    /* nothing a client can see has changed */
+    if(!property)
+        return;
+
+    if(!blconf_daemon_throttle_change(blconfd, backend, channel, property))
+        blconf_daemon_queue_change(blconfd, backend, channel, property);
 }
 
 static void
@@ -219,30 +748,75 @@ blconf_set_property(BlconfDaemon *blconfd,
                     const GValue *value,
                     DBusGMethodInvocation *context)
 {
-    GList *l;
     GError *error = NULL;
 
     /* if there's more than one backend, we need to make sure the
      * property isn't locked on ANY of them */
     if(G_UNLIKELY(blconfd->backends->next)) {
-        for(l = blconfd->backends; l; l = l->next) {
-            gboolean locked = FALSE;
+        gboolean locked = FALSE;
+
+        if(blconf_daemon_is_property_locked(blconfd, channel, property,
+                                            &locked, &error)
+           && locked)
+        {
+            g_set_error(&error, BLCONF_ERROR,
+                        BLCONF_ERROR_PERMISSION_DENIED,
+                        _("Permission denied while modifying property \"%s\" on channel \"%s\""),
+                        property, channel);
+        }
 
-            if(!blconf_backend_is_property_locked(l->data, channel, property,
-                                                  &locked, &error))
-                break;
+        /* there is always an error set if something failed or the
+         * property is locked */
+        if(error) {
+            dbus_g_method_return_error(context, error);
+            g_error_free(error);
+            return;
+        }
+    }
 
-            if(locked) {
+    /* only write to first backend */
+    if(blconf_backend_set(blconfd->backends->data, channel, property,
+                          value, &error))
+    {
+        /* which is also the first one a Get asks */
+        if(G_UNLIKELY(blconfd->backends->next)) {
+            blconf_route_insert(blconf_daemon_get_route(blconfd, channel)->owners,
+                                property, blconfd->backends->data);
+        }
+        dbus_g_method_return(context);
+    } else {
+        dbus_g_method_return_error(context, error);
+        g_error_free(error);
+    }
+}
+
+static void
+blconf_set_properties(BlconfDaemon *blconfd,
+                      const gchar *channel,
+                      GHashTable *properties,
+                      DBusGMethodInvocation *context)
+{
+    GError *error = NULL;
+    GHashTableIter iter;
+    gpointer property;
+
+    /* as with SetProperty, nothing may be locked on ANY backend */
+    if(G_UNLIKELY(blconfd->backends->next)) {
+        g_hash_table_iter_init(&iter, properties);
+        while(!error && g_hash_table_iter_next(&iter, &property, NULL)) {
+            gboolean locked = FALSE;
+
+            if(blconf_daemon_is_property_locked(blconfd, channel, property,
+                                                &locked, &error)
+               && locked)
+            {
                 g_set_error(&error, BLCONF_ERROR,
                             BLCONF_ERROR_PERMISSION_DENIED,
                             _("Permission denied while modifying property \"%s\" on channel \"%s\""),
-                            property, channel);
-                break;
+                            (const gchar *)property, channel);
             }
         }
 
-        /* there is always an error set if something failed or the
-         * property is locked */
         if(error) {
             dbus_g_method_return_error(context, error);
             g_error_free(error);
@@ -251,9 +825,18 @@ blconf_set_property(BlconfDaemon *blconfd,
     }
 
     /* only write to first backend */
-    if(blconf_backend_set(blconfd->backends->data, channel, property,
-                          value, &error))
+    if(blconf_backend_set_many(blconfd->backends->data, channel, properties,
+                               &error))
     {
+        if(G_UNLIKELY(blconfd->backends->next)) {
+            BlconfRoute *route = blconf_daemon_get_route(blconfd, channel);
+
+            g_hash_table_iter_init(&iter, properties);
+            while(g_hash_table_iter_next(&iter, &property, NULL)) {
+                blconf_route_insert(route->owners, property,
+                                    blconfd->backends->data);
+            }
+        }
         dbus_g_method_return(context);
     } else {
         dbus_g_method_return_error(context, error);
@@ -270,21 +853,344 @@ blconf_get_property(BlconfDaemon *blconfd,
     GList *l;
     GValue value = { 0, };
     GError *error = NULL;
+    BlconfRoute *route = NULL;
+
+    if(G_UNLIKELY(blconfd->backends->next)) {
+        gpointer owner;
+
+        route = blconf_daemon_get_route(blconfd, channel);
+        owner = g_hash_table_lookup(route->owners, property);
+
+        if(owner == BLCONF_ROUTE_NO_OWNER) {
+            g_set_error(&error, BLCONF_ERROR, BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                        _("Property \"%s\" does not exist on channel \"%s\""),
+                        property, channel);
+            dbus_g_method_return_error(context, error);
+            g_error_free(error);
+            return;
+        } else if(owner) {
+            if(blconf_backend_get(owner, channel, property, &value, NULL)) {
+                dbus_g_method_return(context, &value);
+                g_value_unset(&value);
+                return;
+            }
+
+            /* the backend changed without telling us; ask all of them */
+            g_hash_table_remove(route->owners, property);
+        }
+    }
 
-    /* check each backend until we find a value */
+    /* check each backend until we find a value.  only the last one's
+     * error is of any use, so don't have the others build theirs. */
     for(l = blconfd->backends; l; l = l->next) {
-        if(blconf_backend_get(l->data, channel, property, &value, &error)) {
+        if(blconf_backend_get(l->data, channel, property, &value,
+                              l->next ? NULL : &error))
+        {
+            if(route)
+                blconf_route_insert(route->owners, property, l->data);
             dbus_g_method_return (context, &value);
             g_value_unset(&value);
             return;
-        } else if(l->next)
-            g_clear_error(&error);
+        }
+    }
+
+    /* only remember misses we're sure about, not e.g. read errors */
+    if(route && g_error_matches(error, BLCONF_ERROR,
+                                BLCONF_ERROR_PROPERTY_NOT_FOUND))
+    {
+        blconf_route_insert(route->owners, property, BLCONF_ROUTE_NO_OWNER);
     }
 
     dbus_g_method_return_error(context, error);
     g_error_free(error);
 }
 
+/* returns the D-Bus signature dbus-glib would use for a variant holding
+ * |type|, or NULL if it's not one we can marshal ourselves */
+static const gchar *
+blconf_daemon_variant_signature(GType type)
+{
+    switch(type) {
+        case G_TYPE_CHAR:
+        case G_TYPE_UCHAR:
+            return DBUS_TYPE_BYTE_AS_STRING;
+        case G_TYPE_BOOLEAN:
+            return DBUS_TYPE_BOOLEAN_AS_STRING;
+        case G_TYPE_INT:
+            return DBUS_TYPE_INT32_AS_STRING;
+        case G_TYPE_UINT:
+            return DBUS_TYPE_UINT32_AS_STRING;
+        case G_TYPE_INT64:
+            return DBUS_TYPE_INT64_AS_STRING;
+        case G_TYPE_UINT64:
+            return DBUS_TYPE_UINT64_AS_STRING;
+        case G_TYPE_FLOAT:
+        case G_TYPE_DOUBLE:
+            return DBUS_TYPE_DOUBLE_AS_STRING;
+        case G_TYPE_STRING:
+            return DBUS_TYPE_STRING_AS_STRING;
+        default:
+            if(type == BLCONF_TYPE_INT16)
+                return DBUS_TYPE_INT16_AS_STRING;
+            else if(type == BLCONF_TYPE_UINT16)
+                return DBUS_TYPE_UINT16_AS_STRING;
+            else if(type == G_TYPE_STRV)
+                return DBUS_TYPE_ARRAY_AS_STRING DBUS_TYPE_STRING_AS_STRING;
+            else if(type == BLCONF_TYPE_G_VALUE_ARRAY)
+                return DBUS_TYPE_ARRAY_AS_STRING DBUS_TYPE_VARIANT_AS_STRING;
+            break;
+    }
+
+    return NULL;
+}
+
+static gboolean
+blconf_daemon_append_variant(DBusMessageIter *iter,
+                             const GValue *value)
+{
+    const gchar *signature = blconf_daemon_variant_signature(G_VALUE_TYPE(value));
+    DBusMessageIter variant_iter;
+    gboolean ret = TRUE;
+
+    if(!signature
+       || !dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT,
+                                            signature, &variant_iter))
+    {
+        return FALSE;
+    }
+
+    switch(G_VALUE_TYPE(value)) {
+#define APPEND_BASIC(gtype, ctype, dbus_type, getter) \
+        case gtype: { \
+            ctype v = getter(value); \
+            ret = dbus_message_iter_append_basic(&variant_iter, dbus_type, &v); \
+            break; \
+        }
+
+        APPEND_BASIC(G_TYPE_CHAR, guchar, DBUS_TYPE_BYTE, g_value_get_schar)
+        APPEND_BASIC(G_TYPE_UCHAR, guchar, DBUS_TYPE_BYTE, g_value_get_uchar)
+        APPEND_BASIC(G_TYPE_BOOLEAN, dbus_bool_t, DBUS_TYPE_BOOLEAN, g_value_get_boolean)
+        APPEND_BASIC(G_TYPE_INT, dbus_int32_t, DBUS_TYPE_INT32, g_value_get_int)
+        APPEND_BASIC(G_TYPE_UINT, dbus_uint32_t, DBUS_TYPE_UINT32, g_value_get_uint)
+        APPEND_BASIC(G_TYPE_INT64, dbus_int64_t, DBUS_TYPE_INT64, g_value_get_int64)
+        APPEND_BASIC(G_TYPE_UINT64, dbus_uint64_t, DBUS_TYPE_UINT64, g_value_get_uint64)
+        APPEND_BASIC(G_TYPE_FLOAT, gdouble, DBUS_TYPE_DOUBLE, g_value_get_float)
+        APPEND_BASIC(G_TYPE_DOUBLE, gdouble, DBUS_TYPE_DOUBLE, g_value_get_double)
+
+#undef APPEND_BASIC
+
+        case G_TYPE_STRING: {
+            const gchar *str = g_value_get_string(value);
+
+            if(!str)
+                str = "";
+            ret = dbus_message_iter_append_basic(&variant_iter,
+                                                 DBUS_TYPE_STRING, &str);
+            break;
+        }
+
+        default: {
+            GPtrArray *arr;
+            DBusMessageIter array_iter;
+            guint i;
+
+            if(G_VALUE_TYPE(value) == BLCONF_TYPE_INT16) {
+                dbus_int16_t v = blconf_g_value_get_int16(value);
+                ret = dbus_message_iter_append_basic(&variant_iter,
+                                                     DBUS_TYPE_INT16, &v);
+                break;
+            } else if(G_VALUE_TYPE(value) == BLCONF_TYPE_UINT16) {
+                dbus_uint16_t v = blconf_g_value_get_uint16(value);
+                ret = dbus_message_iter_append_basic(&variant_iter,
+                                                     DBUS_TYPE_UINT16, &v);
+                break;
+            } else if(G_VALUE_TYPE(value) == G_TYPE_STRV) {
+                gchar **strv = g_value_get_boxed(value);
+
+                if(!dbus_message_iter_open_container(&variant_iter,
+                                                     DBUS_TYPE_ARRAY,
+                                                     DBUS_TYPE_STRING_AS_STRING,
+                                                     &array_iter))
+                {
+                    ret = FALSE;
+                    break;
+                }
+
+                for(i = 0; ret && strv && strv[i]; ++i)
+                    ret = dbus_message_iter_append_basic(&array_iter,
+                                                         DBUS_TYPE_STRING,
+                                                         &strv[i]);
+
+                if(!dbus_message_iter_close_container(&variant_iter,
+                                                      &array_iter))
+                {
+                    ret = FALSE;
+                }
+                break;
+            }
+
+            arr = g_value_get_boxed(value);
+            if(!dbus_message_iter_open_container(&variant_iter,
+                                                 DBUS_TYPE_ARRAY,
+                                                 DBUS_TYPE_VARIANT_AS_STRING,
+                                                 &array_iter))
+            {
+                ret = FALSE;
+                break;
+            }
+
+            for(i = 0; ret && arr && i < arr->len; ++i)
+                ret = blconf_daemon_append_variant(&array_iter,
+                                                   g_ptr_array_index(arr, i));
+
+            if(!dbus_message_iter_close_container(&variant_iter, &array_iter))
+                ret = FALSE;
+            break;
+        }
+    }
+
+    if(!dbus_message_iter_close_container(iter, &variant_iter))
+        ret = FALSE;
+
+    return ret;
+}
+
+typedef struct
+{
+    DBusMessageIter array_iter;
+    gboolean failed;
+} BlconfGetAllReply;
+
+static void
+blconf_get_properties(BlconfDaemon *blconfd,
+                      const gchar *channel,
+                      const gchar **properties,
+                      DBusGMethodInvocation *context)
+{
+    GList *l;
+    GHashTable *values;
+    GError *error = NULL;
+    gboolean succeed = FALSE;
+
+    values = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                   (GDestroyNotify)g_free,
+                                   (GDestroyNotify)_blconf_gvalue_free);
+
+    /* backends skip properties an earlier one already found, so the
+     * first backend that has a property wins, as with GetProperty */
+    for(l = blconfd->backends; l; l = l->next) {
+        if(blconf_backend_get_many(l->data, channel,
+                                   (const gchar * const *)properties,
+                                   values, &error))
+        {
+            succeed = TRUE;
+        } else if(l->next)
+            g_clear_error(&error);
+    }
+
+    if(succeed)
+        dbus_g_method_return(context, values);
+    else
+        dbus_g_method_return_error(context, error);
+
+    if(error)
+        g_error_free(error);
+    g_hash_table_destroy(values);
+}
+
+static gboolean
+blconf_get_all_properties_append(const gchar *property,
+                                 const GValue *value,
+                                 gpointer user_data)
+{
+    BlconfGetAllReply *get_all_reply = user_data;
+    DBusMessageIter entry_iter;
+
+    if(!dbus_message_iter_open_container(&get_all_reply->array_iter,
+                                         DBUS_TYPE_DICT_ENTRY, NULL,
+                                         &entry_iter))
+    {
+        get_all_reply->failed = TRUE;
+        return FALSE;
+    }
+
+    if(!dbus_message_iter_append_basic(&entry_iter, DBUS_TYPE_STRING,
+                                       &property)
+       || !blconf_daemon_append_variant(&entry_iter, value))
+    {
+        get_all_reply->failed = TRUE;
+    }
+
+    if(!dbus_message_iter_close_container(&get_all_reply->array_iter,
+                                          &entry_iter))
+    {
+        get_all_reply->failed = TRUE;
+    }
+
+    return !get_all_reply->failed;
+}
+
+/* writes the properties straight into the reply, rather than copying
+ * them into a hash table for dbus-glib to marshal.  returns FALSE if this
+ * isn't possible, and the caller has to fall back to the latter. */
+static gboolean
+blconf_get_all_properties_streamed(BlconfDaemon *blconfd,
+                                   const gchar *channel,
+                                   const gchar *property_base,
+                                   DBusGMethodInvocation *context)
+{
+    BlconfBackend *backend;
+    DBusMessage *reply;
+    DBusMessageIter iter;
+    BlconfGetAllReply get_all_reply;
+    GError *error = NULL;
+
+    /* results from more than one backend need merging */
+    if(!blconfd->backends || blconfd->backends->next)
+        return FALSE;
+
+    backend = blconfd->backends->data;
+    if(!blconf_backend_has_get_all_foreach(backend))
+        return FALSE;
+
+    reply = dbus_g_method_get_reply(context);
+    dbus_message_iter_init_append(reply, &iter);
+    if(!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+                                         DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+                                         DBUS_TYPE_STRING_AS_STRING
+                                         DBUS_TYPE_VARIANT_AS_STRING
+                                         DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+                                         &get_all_reply.array_iter))
+    {
+        dbus_message_unref(reply);
+        return FALSE;
+    }
+    get_all_reply.failed = FALSE;
+
+    if(!blconf_backend_get_all_foreach(backend, channel, property_base,
+                                       blconf_get_all_properties_append,
+                                       &get_all_reply, &error))
+    {
+        dbus_message_unref(reply);
+        dbus_g_method_return_error(context, error);
+        g_error_free(error);
+        return TRUE;
+    }
+
+    /* a property of a type we can't marshal (or running out of memory)
+     * stops the walk early; the half-built reply is no good then */
+    if(get_all_reply.failed
+       || !dbus_message_iter_close_container(&iter, &get_all_reply.array_iter))
+    {
+        dbus_message_unref(reply);
+        return FALSE;
+    }
+
+    dbus_g_method_send_reply(context, reply);
+
+    return TRUE;
+}
+
 static void
 blconf_get_all_properties(BlconfDaemon *blconfd,
                           const gchar *channel,
@@ -296,6 +1202,12 @@ blconf_get_all_properties(BlconfDaemon *blconfd,
     GError *error = NULL;
     gboolean succeed = FALSE;
 
+    if(blconf_get_all_properties_streamed(blconfd, channel, property_base,
+                                          context))
+    {
+        return;
+    }
+
     properties = g_hash_table_new_full(g_str_hash, g_str_equal,
                                         (GDestroyNotify)g_free,
                                         (GDestroyNotify)_blconf_gvalue_free);
@@ -371,6 +1283,9 @@ blconf_reset_property(BlconfDaemon *blconfd,
             g_clear_error(&error);
     }
 
+    /* backends don't report every property a recursive reset removes */
+    blconf_daemon_forget_route(blconfd, channel, property, recursive);
+
     if(succeed)
         dbus_g_method_return(context);
     else
@@ -380,6 +1295,103 @@ blconf_reset_property(BlconfDaemon *blconfd,
         g_error_free(error);
 }
 
+/* resets all of |properties|, or none of them if any can't be reset.
+ * with more than one backend, that's only checked up front: each
+ * backend is asked with blconf_backend_can_reset() before any of them
+ * resets anything, and then they reset their share one after another.
+ * if a later backend then fails anyway (a read or write error, say),
+ * the earlier ones have already dropped their values, and those can't
+ * be brought back. */
+static void
+blconf_reset_properties(BlconfDaemon *blconfd,
+                        const gchar *channel,
+                        const gchar **properties,
+                        gboolean recursive,
+                        DBusGMethodInvocation *context)
+{
+    GList *l;
+    GPtrArray **resets;
+    GError *error = NULL;
+    gint i, j, n_backends;
+
+    /* a single backend already leaves everything alone if any of the
+     * resets can't be done */
+    if(!blconfd->backends->next) {
+        blconf_backend_reset_many(blconfd->backends->data, channel,
+                                  (const gchar * const *)properties,
+                                  recursive, &error);
+        goto out;
+    }
+
+    /* as with blconf_reset_property(), each property is reset in all
+     * backends that have it, and has to exist in at least one of them.
+     * find out which ones those are before touching any of them. */
+    n_backends = g_list_length(blconfd->backends);
+    resets = g_new0(GPtrArray *, n_backends);
+
+    for(i = 0; !error && properties[i]; ++i) {
+        GError *not_found = NULL;
+        gboolean found = FALSE;
+
+        for(l = blconfd->backends, j = 0; l; l = l->next, ++j) {
+            GError *tmp_error = NULL;
+
+            if(blconf_backend_can_reset(l->data, channel, properties[i],
+                                        recursive, &tmp_error))
+            {
+                if(!resets[j])
+                    resets[j] = g_ptr_array_new();
+                g_ptr_array_add(resets[j], (gpointer)properties[i]);
+                found = TRUE;
+            } else if(g_error_matches(tmp_error, BLCONF_ERROR,
+                                      BLCONF_ERROR_PROPERTY_NOT_FOUND)
+                      || g_error_matches(tmp_error, BLCONF_ERROR,
+                                         BLCONF_ERROR_CHANNEL_NOT_FOUND))
+            {
+                if(not_found)
+                    g_error_free(not_found);
+                not_found = tmp_error;
+            } else {
+                /* the backend itself is in trouble */
+                error = tmp_error;
+                break;
+            }
+        }
+
+        if(!error && !found) {
+            error = not_found;
+            not_found = NULL;
+        }
+        if(not_found)
+            g_error_free(not_found);
+    }
+
+    for(l = blconfd->backends, j = 0; l; l = l->next, ++j) {
+        if(!resets[j])
+            continue;
+
+        if(!error) {
+            g_ptr_array_add(resets[j], NULL);
+            blconf_backend_reset_many(l->data, channel,
+                                      (const gchar * const *)resets[j]->pdata,
+                                      recursive, &error);
+        }
+        g_ptr_array_free(resets[j], TRUE);
+    }
+    g_free(resets);
+
+out:
+    for(i = 0; properties[i]; ++i)
+        blconf_daemon_forget_route(blconfd, channel, properties[i], recursive);
+
+    if(!error)
+        dbus_g_method_return(context);
+    else {
+        dbus_g_method_return_error(context, error);
+        g_error_free(error);
+    }
+}
+
 static void
 blconf_list_channels(BlconfDaemon *blconfd,
                      DBusGMethodInvocation *context)
@@ -428,6 +1440,14 @@ static void blconf_is_property_locked(BlconfDaemon *blconfd,
     GError *error = NULL;
     gboolean succeed = FALSE;
 
+    if(G_UNLIKELY(blconfd->backends->next)
+       && blconf_daemon_is_property_locked(blconfd, channel, property,
+                                           &locked, NULL))
+    {
+        dbus_g_method_return(context, locked);
+        return;
+    }
+
     for(l = blconfd->backends; !locked && l; l = l->next) {
         if(blconf_backend_is_property_locked(l->data, channel, property,
                                              &locked, &error))
@@ -570,3 +1590,90 @@ blconf_daemon_new_unique(gchar * const *backend_ids,
 
     return blconfd;
 }
+
+/**
+ * blconf_daemon_set_legacy_signals:
+ * @blconfd: A #BlconfDaemon.
+ * @legacy_signals: Whether to send PropertyChanged and PropertyRemoved.
+ *
+ * Every change is reported with PropertiesChanged.  Clients built
+ * against older versions of libblconf only listen to PropertyChanged and
+ * PropertyRemoved, though, which are only sent if @legacy_signals is
+ * %TRUE.  Off by default, as every client listening to the interface
+ * would get woken up for those too.
+ **/
+void
+blconf_daemon_set_legacy_signals(BlconfDaemon *blconfd,
+                                 gboolean legacy_signals)
+{
+    g_return_if_fail(BLCONF_IS_DAEMON(blconfd));
+    blconfd->legacy_signals = legacy_signals;
+}
+
+/**
+ * blconf_daemon_set_rate_limits:
+ * @blconfd: A #BlconfDaemon.
+ * @rate_limits: A %NULL-terminated list of "CHANNEL[/PROPERTY]=MS" rules.
+ *
+ * Limits change notifications for properties under each rule's channel or
+ * property subtree to one every MS milliseconds.  The most specific rule
+ * wins.  Malformed rules are ignored with a warning.  The rules replace
+ * any set earlier.  How many notifications were held back is logged
+ * every few minutes.
+ **/
+void
+blconf_daemon_set_rate_limits(BlconfDaemon *blconfd,
+                              gchar * const *rate_limits)
+{
+    gint i;
+
+    g_return_if_fail(BLCONF_IS_DAEMON(blconfd));
+
+    /* any throttle state refers to the old rules; let the changes they
+     * are holding go out now */
+    blconf_daemon_clear_rate_limits(blconfd, TRUE);
+
+    for(i = 0; rate_limits && rate_limits[i]; ++i) {
+        BlconfRateLimit *rate_limit;
+        const gchar *eq, *slash;
+        gchar *end = NULL;
+        guint64 interval;
+
+        eq = strrchr(rate_limits[i], '=');
+        if(eq)
+            interval = g_ascii_strtoull(eq + 1, &end, 10);
+        if(!eq || eq == rate_limits[i] || *rate_limits[i] == '/'
+           || !end || end == eq + 1 || *end != '\0'
+           || interval == 0 || interval > G_MAXUINT)
+        {
+            g_warning("Ignoring invalid rate limit \"%s\"", rate_limits[i]);
+            continue;
+        }
+
+        slash = memchr(rate_limits[i], '/', eq - rate_limits[i]);
+
+        rate_limit = g_slice_new0(BlconfRateLimit);
+        rate_limit->interval = interval;
+        if(slash) {
+            rate_limit->channel = g_strndup(rate_limits[i],
+                                            slash - rate_limits[i]);
+            rate_limit->prefix = g_strndup(slash, eq - slash);
+            /* "chan/" and "chan/foo/" mean the same as "chan" and "chan/foo" */
+            if(g_str_has_suffix(rate_limit->prefix, "/"))
+                rate_limit->prefix[strlen(rate_limit->prefix) - 1] = '\0';
+        } else {
+            rate_limit->channel = g_strndup(rate_limits[i], eq - rate_limits[i]);
+            rate_limit->prefix = g_strdup("");
+        }
+
+        blconfd->rate_limits = g_slist_prepend(blconfd->rate_limits,
+                                               rate_limit);
+    }
+    blconfd->rate_limits = g_slist_reverse(blconfd->rate_limits);
+
+    if(blconfd->rate_limits) {
+        blconfd->rate_limit_report_id = g_timeout_add_seconds(RATE_LIMIT_REPORT_INTERVAL,
+                                                              blconf_daemon_report_rate_limits_timeout,
+                                                              blconfd);
+    }
+}
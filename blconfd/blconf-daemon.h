@@ -38,6 +38,12 @@ GType blconf_daemon_get_type(void) G_GNUC_CONST;
 BlconfDaemon *blconf_daemon_new_unique(gchar * const *backend_ids,
                                        GError **error);
 
+void blconf_daemon_set_legacy_signals(BlconfDaemon *blconfd,
+                                      gboolean legacy_signals);
+
+void blconf_daemon_set_rate_limits(BlconfDaemon *blconfd,
+                                   gchar * const *rate_limits);
+
 G_END_DECLS
 
 #endif  /* __BLCONF_DAEMON_H__ */
@@ -33,38 +33,179 @@
 #include <grp.h>
 #endif
 
+#ifdef HAVE_PWD_H
+#include <pwd.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include "blconf-locking-utils.h"
 
+#define GROUP_FILE            "/etc/group"
+#define GROUP_CHECK_INTERVAL  (G_USEC_PER_SEC)  /* stat() it at most once a second */
+#define MAX_LOCK_VERDICTS     (256)
+
 /* group cache stuff */
 
+/* channels may be loaded from more than one thread at a time */
+G_LOCK_DEFINE_STATIC(group_cache);
 static time_t etc_group_mtime = 0;
+static gint64 etc_group_checked = 0;
+
+#ifdef HAVE_GETGROUPLIST
+/* names of the groups the current user is in */
+static GHashTable *user_groups = NULL;
+#else
+/* group name -> set of member names, for every group on the system */
 static GHashTable *group_cache = NULL;
+#endif
 
+/* lock expression -> whether the current user matches it.  there are
+ * only a handful of distinct expressions in practice, but every locked
+ * property in a kiosk setup carries one. */
+static GHashTable *lock_verdicts = NULL;
+
+/* drops everything we know about groups if /etc/group changed since we
+ * last looked */
 static void
-blconf_ensure_group_cache(void)
+blconf_check_group_file(void)
 {
-    gboolean needs_rebuild = FALSE;
+    gint64 now = g_get_monotonic_time();
+    gboolean changed = FALSE;
     struct stat st;
-    struct group *gr;
-    GHashTable *members;
-        
-    if(!stat("/etc/group", &st)) {
+
+    if(etc_group_checked && now - etc_group_checked < GROUP_CHECK_INTERVAL)
+        return;
+    etc_group_checked = now;
+
+    if(!stat(GROUP_FILE, &st)) {
         if(st.st_mtime > etc_group_mtime) {
             etc_group_mtime = st.st_mtime;
-            needs_rebuild = TRUE;
+            changed = TRUE;
         }
     } else
-        needs_rebuild = TRUE;        
-    
-    if(!needs_rebuild && group_cache)
+        changed = TRUE;
+
+    if(!changed)
         return;
-    
-    if(group_cache)
+
+#ifdef HAVE_GETGROUPLIST
+    if(user_groups) {
+        g_hash_table_destroy(user_groups);
+        user_groups = NULL;
+    }
+#else
+    if(group_cache) {
         g_hash_table_destroy(group_cache);
+        group_cache = NULL;
+    }
+#endif
+
+    if(lock_verdicts)
+        g_hash_table_remove_all(lock_verdicts);
+}
+
+#ifdef HAVE_GETGROUPLIST
+
+/* the login group of |user|.  the daemon's own gid is only a fallback:
+ * it needn't be the same, e.g. if blconfd was started with sg. */
+static gid_t
+blconf_user_primary_gid(const gchar *user)
+{
+    gid_t gid = getgid();
+#ifdef HAVE_PWD_H
+    struct passwd pwd, *result = NULL;
+    gchar *buf = NULL;
+    gsize buflen = 1024;
+    gint ret;
+
+    do {
+        buf = g_realloc(buf, buflen);
+        ret = getpwnam_r(user, &pwd, buf, buflen, &result);
+        buflen *= 2;
+    } while(ret == ERANGE && buflen <= 1024 * 1024);
+
+    if(!ret && result)
+        gid = pwd.pw_gid;
+
+    g_free(buf);
+#endif
+
+    return gid;
+}
+
+/* only looks up the user's own groups, rather than enumerating every
+ * group on the system, which can be very slow with NSS/LDAP.  the list
+ * includes the user's primary group, so "@group" matches users whose
+ * login group it is, even if the group doesn't list them as members. */
+static void
+blconf_ensure_user_groups(const gchar *user)
+{
+    gid_t primary_gid;
+    gid_t *groups;
+    gint n_groups = 32, n_alloc = 0, i;
+    struct group *gr;
+
+    if(user_groups)
+        return;
+
+    user_groups = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        (GDestroyNotify)g_free, NULL);
+
+    primary_gid = blconf_user_primary_gid(user);
+    groups = NULL;
+    do {
+        if(n_groups <= n_alloc)
+            n_groups = n_alloc * 2;  /* not all platforms tell us how many */
+        if(n_groups > 65536) {
+            n_groups = 0;
+            break;
+        }
+
+        n_alloc = n_groups;
+        groups = g_renew(gid_t, groups, n_alloc);
+    } while(getgrouplist(user, primary_gid, groups, &n_groups) < 0);
+
+    for(i = 0; i < n_groups && i < n_alloc; ++i) {
+        gr = getgrgid(groups[i]);
+        if(gr && gr->gr_name) {
+            g_hash_table_replace(user_groups, g_strdup(gr->gr_name),
+                                 GINT_TO_POINTER(1));
+        }
+    }
+
+    g_free(groups);
+}
+
+static gboolean
+blconf_user_is_in_group(const gchar *user,
+                        const gchar *group)
+{
+    blconf_ensure_user_groups(user);
+
+    return g_hash_table_lookup(user_groups, group) ? TRUE : FALSE;
+}
+
+#else  /* !HAVE_GETGROUPLIST */
+
+static void
+blconf_ensure_group_cache(void)
+{
+    struct group *gr;
+    GHashTable *members;
+
+    if(group_cache)
+        return;
     
     group_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
                                         (GDestroyNotify)g_free,
@@ -83,6 +224,7 @@ blconf_ensure_group_cache(void)
         
         g_hash_table_replace(group_cache, g_strdup(gr->gr_name), members);
     }
+    endgrent();
 }
 
 static gboolean
@@ -90,19 +232,21 @@ blconf_user_is_in_group(const gchar *user,
                         const gchar *group)
 {
     GHashTable *members;
-    
+
     blconf_ensure_group_cache();
     
     members = g_hash_table_lookup(group_cache, group);
     
-    if(G_UNLIKELY(!members))
-        return FALSE;
-    
-    return g_hash_table_lookup(members, user) ? TRUE : FALSE;
+    if(G_LIKELY(members))
+        return g_hash_table_lookup(members, user) ? TRUE : FALSE;
+
+    return FALSE;
 }
 
-gboolean
-blconf_user_is_in_list(const gchar *list)
+#endif  /* !HAVE_GETGROUPLIST */
+
+static gboolean
+blconf_user_is_in_list_real(const gchar *list)
 {
     gboolean ret = FALSE;
     const gchar *user_name = g_get_user_name();
@@ -131,3 +275,37 @@ blconf_user_is_in_list(const gchar *list)
     
     return ret;
 }
+
+gboolean
+blconf_user_is_in_list(const gchar *list)
+{
+    gpointer verdict;
+    gboolean ret;
+
+    G_LOCK(group_cache);
+
+    blconf_check_group_file();
+
+    if(G_UNLIKELY(!lock_verdicts)) {
+        lock_verdicts = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              (GDestroyNotify)g_free, NULL);
+    }
+
+    verdict = g_hash_table_lookup(lock_verdicts, list);
+    if(verdict)
+        ret = GPOINTER_TO_INT(verdict) > 0;
+    else {
+        ret = blconf_user_is_in_list_real(list);
+
+        /* a file with lots of one-off expressions shouldn't make this
+         * grow without bounds */
+        if(g_hash_table_size(lock_verdicts) >= MAX_LOCK_VERDICTS)
+            g_hash_table_remove_all(lock_verdicts);
+        g_hash_table_insert(lock_verdicts, g_strdup(list),
+                            GINT_TO_POINTER(ret ? 1 : -1));
+    }
+
+    G_UNLOCK(group_cache);
+
+    return ret;
+}
@@ -0,0 +1,135 @@
+/*
+ *  blconfd
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* a process-wide table of refcounted strings.  property names ("size",
+ * "enabled", ...) and many string values repeat across and within
+ * channels; storing each of them once also means that two pooled strings
+ * are equal exactly when their pointers are. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "blconf-string-pool.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+/* the key of each entry points at its own |str| */
+typedef struct
+{
+    guint refcount;
+    gchar str[1];
+} PooledString;
+
+/* channels may be loaded (and written out) from more than one thread */
+G_LOCK_DEFINE_STATIC(string_pool);
+static GHashTable *string_pool = NULL;
+
+/**
+ * blconf_string_pool_ref:
+ * @str: A string.
+ *
+ * Returns the pooled copy of @str, adding it to the pool if necessary.
+ * Each call must be balanced by a call to blconf_string_pool_unref().
+ **/
+const gchar *
+blconf_string_pool_ref(const gchar *str)
+{
+    PooledString *pooled;
+
+    g_return_val_if_fail(str, NULL);
+
+    G_LOCK(string_pool);
+
+    if(G_UNLIKELY(!string_pool))
+        string_pool = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            NULL, g_free);
+
+    pooled = g_hash_table_lookup(string_pool, str);
+    if(!pooled) {
+        gsize len = strlen(str);
+
+        pooled = g_malloc(G_STRUCT_OFFSET(PooledString, str) + len + 1);
+        pooled->refcount = 0;
+        memcpy(pooled->str, str, len + 1);
+        g_hash_table_insert(string_pool, pooled->str, pooled);
+    }
+    pooled->refcount++;
+
+    G_UNLOCK(string_pool);
+
+    return pooled->str;
+}
+
+/**
+ * blconf_string_pool_lookup:
+ * @str: A string.
+ *
+ * Returns the pooled copy of @str without taking a reference, or %NULL
+ * if it isn't in the pool.  The result can only be compared against
+ * other pooled strings, never dereferenced, unless the caller holds a
+ * reference already.
+ **/
+const gchar *
+blconf_string_pool_lookup(const gchar *str)
+{
+    PooledString *pooled = NULL;
+
+    g_return_val_if_fail(str, NULL);
+
+    G_LOCK(string_pool);
+    if(string_pool)
+        pooled = g_hash_table_lookup(string_pool, str);
+    G_UNLOCK(string_pool);
+
+    return pooled ? pooled->str : NULL;
+}
+
+/**
+ * blconf_string_pool_unref:
+ * @str: A string.
+ *
+ * Drops a reference to @str, if it's a pooled string, freeing it when
+ * the last one goes away.  Returns %FALSE (and does nothing) if @str is
+ * not the pool's copy, e.g. because it was never pooled.
+ **/
+gboolean
+blconf_string_pool_unref(const gchar *str)
+{
+    PooledString *pooled = NULL;
+    gboolean ret = FALSE;
+
+    g_return_val_if_fail(str, FALSE);
+
+    G_LOCK(string_pool);
+
+    if(string_pool)
+        pooled = g_hash_table_lookup(string_pool, str);
+    if(pooled && pooled->str == str) {
+        if(--pooled->refcount == 0)
+            g_hash_table_remove(string_pool, pooled->str);
+        ret = TRUE;
+    }
+
+    G_UNLOCK(string_pool);
+
+    return ret;
+}
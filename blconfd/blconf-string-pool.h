@@ -0,0 +1,33 @@
+/*
+ *  blconfd
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __BLCONF_STRING_POOL_H__
+#define __BLCONF_STRING_POOL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+G_GNUC_INTERNAL const gchar *blconf_string_pool_ref(const gchar *str);
+G_GNUC_INTERNAL const gchar *blconf_string_pool_lookup(const gchar *str);
+G_GNUC_INTERNAL gboolean blconf_string_pool_unref(const gchar *str);
+
+G_END_DECLS
+
+#endif  /* __BLCONF_STRING_POOL_H__ */
@@ -127,7 +127,10 @@ main(int argc,
     
     GOptionContext *opt_ctx;
     gchar **backends = NULL;
+    gchar **backend_options = NULL;
+    gchar **rate_limits = NULL;
     gboolean print_version = FALSE;
+    gboolean legacy_signals = FALSE;
     gboolean do_daemon = FALSE;
     GOptionEntry options[] = {
         { "version", 'V', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &print_version,
@@ -135,6 +138,16 @@ main(int argc,
         { "backends", 'b', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_STRING_ARRAY, &backends,
             N_("Configuration backends to use.  The first backend specified " \
                "is opened read/write; the others, read-only."), NULL },
+        { "backend-option", 'o', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_STRING_ARRAY, &backend_options,
+            N_("Set a backend option, such as \"save-delay=5000\".  May be " \
+               "given more than once."), N_("NAME=VALUE") },
+        { "rate-limit", 'r', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_STRING_ARRAY, &rate_limits,
+            N_("Send change notifications for a channel, or a property " \
+               "and its children, at most once every MS milliseconds.  " \
+               "May be given more than once."), N_("CHANNEL[/PROPERTY]=MS") },
+        { "legacy-signals", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &legacy_signals,
+            N_("Also send the PropertyChanged and PropertyRemoved signals " \
+               "that clients using libblconf older than 4.13 listen to."), NULL },
         { "daemon", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &do_daemon,
             N_("Fork into background after starting; only useful for " \
                 "testing purposes"), NULL },
@@ -159,6 +172,11 @@ main(int argc,
     g_set_application_name(_("Xfce Configuration Daemon"));
     g_set_prgname(G_LOG_DOMAIN);
 
+#if !GLIB_CHECK_VERSION(2,32,0)
+    /* the perchannel-xml backend writes from a separate thread */
+    if(!g_thread_supported())
+        g_thread_init(NULL);
+#endif
 #if !GLIB_CHECK_VERSION(2,36,0)
     g_type_init();
 #endif
@@ -209,6 +227,9 @@ main(int argc,
         backends[0] = g_strdup(DEFAULT_BACKEND);
     }
     
+    blconf_backend_factory_set_options(backend_options);
+    g_strfreev(backend_options);
+
     blconfd = blconf_daemon_new_unique(backends, &error);
     if(!blconfd) {
         g_critical("Blconfd failed to start: %s\n", error->message);
@@ -217,6 +238,10 @@ main(int argc,
     }
     g_strfreev(backends);
 
+    blconf_daemon_set_legacy_signals(blconfd, legacy_signals);
+    blconf_daemon_set_rate_limits(blconfd, rate_limits);
+    g_strfreev(rate_limits);
+
     if(do_daemon) {
         pid_t child_pid;
 
@@ -24,6 +24,7 @@
 #include <dbus/dbus-glib.h>
 
 #define BLCONF_TYPE_G_VALUE_ARRAY  (dbus_g_type_get_collection("GPtrArray", G_TYPE_VALUE))
+#define BLCONF_TYPE_G_STRING_VALUE_HASHTABLE  (dbus_g_type_get_map("GHashTable", G_TYPE_STRING, G_TYPE_VALUE))
 
 #define I_(string) (g_intern_static_string((string)))
 
@@ -0,0 +1,309 @@
+/*
+ *  blconf
+ *
+ *  Copyright (c) 2007 Brian Tarricone <bjt23@cornell.edu>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define EVICT_BASE  "/test/evicttest"
+
+#define METHOD_MATCH  "type='method_call',interface='org.blade.Blconf'"
+
+/* automake's exit status for a skipped test */
+#define TEST_SKIPPED  77
+
+enum
+{
+    PROP_0,
+    PROP_TEST
+};
+
+typedef struct _TestObject TestObject;
+typedef struct _TestObjectClass TestObjectClass;
+
+struct _TestObjectClass
+{
+    GObjectClass __parent__;
+};
+
+struct _TestObject
+{
+    GObject __parent__;
+
+    gchar *test;
+};
+
+GType test_object_get_type(void) G_GNUC_CONST;
+static void test_object_finalize(GObject *object);
+static void test_object_get_property(GObject *object,
+                                     guint prop_id,
+                                     GValue *value,
+                                     GParamSpec *pspec);
+static void test_object_set_property(GObject *object,
+                                     guint prop_id,
+                                     const GValue *value,
+                                     GParamSpec *pspec);
+
+G_DEFINE_TYPE(TestObject, test_object, G_TYPE_OBJECT)
+
+static gint n_calls = 0;
+
+static void
+test_object_class_init(TestObjectClass *klass)
+{
+    GObjectClass *gobject_class;
+
+    gobject_class = G_OBJECT_CLASS(klass);
+    gobject_class->finalize = test_object_finalize;
+    gobject_class->get_property = test_object_get_property;
+    gobject_class->set_property = test_object_set_property;
+
+    g_object_class_install_property(gobject_class,
+                                    PROP_TEST,
+                                    g_param_spec_string("test",
+                                                        NULL, NULL,
+                                                        NULL,
+                                                        G_PARAM_READWRITE));
+}
+
+static void
+test_object_init(TestObject *object)
+{
+}
+
+static void
+test_object_finalize(GObject *object)
+{
+    g_free(((TestObject *)object)->test);
+
+    G_OBJECT_CLASS(test_object_parent_class)->finalize(object);
+}
+
+static void
+test_object_get_property(GObject *object,
+                         guint prop_id,
+                         GValue *value,
+                         GParamSpec *pspec)
+{
+    g_value_set_string(value, ((TestObject *)object)->test);
+}
+
+static void
+test_object_set_property(GObject *object,
+                         guint prop_id,
+                         const GValue *value,
+                         GParamSpec *pspec)
+{
+    g_free(((TestObject *)object)->test);
+    ((TestObject *)object)->test = g_value_dup_string(value);
+}
+
+static DBusHandlerResult
+test_filter(DBusConnection *connection,
+            DBusMessage *message,
+            void *user_data)
+{
+    if(dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_METHOD_CALL
+       && !g_strcmp0(dbus_message_get_interface(message), "org.blade.Blconf"))
+    {
+        n_calls++;
+    }
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+/* a second connection that gets to see every call made to the daemon,
+ * even the blocking ones */
+static DBusConnection *
+test_monitor_new(void)
+{
+    DBusConnection *monitor;
+    DBusMessage *message, *reply;
+    DBusMessageIter iter, sub;
+    const gchar *rule = METHOD_MATCH;
+    dbus_uint32_t flags = 0;
+
+    monitor = dbus_bus_get_private(DBUS_BUS_SESSION, NULL);
+    if(!monitor)
+        return NULL;
+    dbus_connection_set_exit_on_disconnect(monitor, FALSE);
+
+    message = dbus_message_new_method_call(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS,
+                                           "org.freedesktop.DBus.Monitoring",
+                                           "BecomeMonitor");
+    dbus_message_iter_init_append(message, &iter);
+    dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+                                     DBUS_TYPE_STRING_AS_STRING, &sub);
+    dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &rule);
+    dbus_message_iter_close_container(&iter, &sub);
+    dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &flags);
+
+    reply = dbus_connection_send_with_reply_and_block(monitor, message,
+                                                      -1, NULL);
+    dbus_message_unref(message);
+    if(!reply) {
+        /* too old a bus */
+        dbus_connection_close(monitor);
+        dbus_connection_unref(monitor);
+        return NULL;
+    }
+    dbus_message_unref(reply);
+
+    dbus_connection_add_filter(monitor, test_filter, NULL, NULL);
+
+    return monitor;
+}
+
+/* the number of calls made to the daemon since the last time */
+static gint
+test_count_calls(DBusConnection *monitor)
+{
+    gint64 end = g_get_monotonic_time() + G_USEC_PER_SEC / 2;
+    gint n;
+
+    while(g_get_monotonic_time() < end)
+        dbus_connection_read_write_dispatch(monitor, 50);
+
+    n = n_calls;
+    n_calls = 0;
+
+    return n;
+}
+
+static gboolean
+test_watchdog(gpointer data)
+{
+    g_main_loop_quit(data);
+    return FALSE;
+}
+
+/* lets the cache's eviction timer run */
+static void
+test_wait(guint seconds)
+{
+    GMainLoop *mloop = g_main_loop_new(NULL, FALSE);
+
+    g_timeout_add_seconds(seconds, test_watchdog, mloop);
+    g_main_loop_run(mloop);
+    g_main_loop_unref(mloop);
+}
+
+static gboolean
+test_has_string(BlconfChannel *channel,
+                const gchar *property,
+                const gchar *expected)
+{
+    gchar *str = blconf_channel_get_string(channel, property, NULL);
+    gboolean ret = !g_strcmp0(str, expected);
+
+    g_free(str);
+
+    return ret;
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel, *base_channel;
+    DBusConnection *monitor;
+    TestObject *object;
+    gulong id;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    monitor = test_monitor_new();
+    if(!monitor) {
+        blconf_tests_end();
+        return TEST_SKIPPED;
+    }
+
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+    blconf_channel_reset_property(channel, EVICT_BASE, TRUE);
+    TEST_OPERATION(blconf_channel_set_string(channel, EVICT_BASE "/one", "one"));
+    TEST_OPERATION(blconf_channel_set_string(channel, EVICT_BASE "/two", "two"));
+    TEST_OPERATION(blconf_channel_set_string(channel, EVICT_BASE "/three", "three"));
+
+    /* this one fetches all of the subtree, so it knows that what it
+     * didn't get doesn't exist */
+    base_channel = blconf_channel_new_with_property_base(TEST_CHANNEL_NAME,
+                                                         EVICT_BASE);
+    object = g_object_new(test_object_get_type(), NULL);
+    id = blconf_g_property_bind(base_channel, "/one", G_TYPE_STRING,
+                                object, "test");
+    TEST_OPERATION(!g_strcmp0(object->test, "one"));
+    test_count_calls(monitor);
+
+    /* all but the bound property get dropped */
+    g_object_set(G_OBJECT(base_channel), "max-cache-entries", 1, NULL);
+
+    TEST_OPERATION(!blconf_channel_has_property(base_channel, "/nonexistent"));
+    TEST_OPERATION(test_count_calls(monitor) == 0);
+
+    TEST_OPERATION(test_has_string(base_channel, "/two", "two"));
+    TEST_OPERATION(test_count_calls(monitor) == 1);
+
+    TEST_OPERATION(test_has_string(base_channel, "/one", "one"));
+    TEST_OPERATION(test_count_calls(monitor) == 0);
+
+    /* the bound one counts against the limit, so nothing else stays */
+    TEST_OPERATION(test_has_string(base_channel, "/two", "two"));
+    TEST_OPERATION(test_count_calls(monitor) == 1);
+
+    blconf_g_property_unbind(id);
+
+    /* a reset makes the cache forget which properties don't exist */
+    blconf_channel_reset_property(base_channel, "/three", FALSE);
+    test_count_calls(monitor);
+
+    /* properties known not to exist are limited the same way */
+    TEST_OPERATION(!blconf_channel_has_property(base_channel, "/absent1"));
+    TEST_OPERATION(test_count_calls(monitor) == 1);
+    TEST_OPERATION(!blconf_channel_has_property(base_channel, "/absent1"));
+    TEST_OPERATION(test_count_calls(monitor) == 0);
+    TEST_OPERATION(!blconf_channel_has_property(base_channel, "/absent2"));
+    TEST_OPERATION(test_count_calls(monitor) == 1);
+    TEST_OPERATION(!blconf_channel_has_property(base_channel, "/absent1"));
+    TEST_OPERATION(test_count_calls(monitor) == 1);
+
+    g_object_set(G_OBJECT(base_channel),
+                 "max-cache-entries", -1,
+                 "max-cache-age", 1,
+                 NULL);
+
+    TEST_OPERATION(!blconf_channel_has_property(base_channel, "/absent3"));
+    TEST_OPERATION(test_count_calls(monitor) == 1);
+    TEST_OPERATION(!blconf_channel_has_property(base_channel, "/absent3"));
+    TEST_OPERATION(test_count_calls(monitor) == 0);
+    test_wait(3);
+    TEST_OPERATION(!blconf_channel_has_property(base_channel, "/absent3"));
+    TEST_OPERATION(test_count_calls(monitor) == 1);
+
+    blconf_channel_reset_property(channel, EVICT_BASE, TRUE);
+
+    g_object_unref(object);
+    g_object_unref(G_OBJECT(base_channel));
+    g_object_unref(G_OBJECT(channel));
+
+    dbus_connection_close(monitor);
+    dbus_connection_unref(monitor);
+
+    blconf_tests_end();
+
+    return 0;
+}
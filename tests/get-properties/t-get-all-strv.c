@@ -0,0 +1,73 @@
+/*
+ *  blconf
+ *
+ *  Copyright (c) 2026 agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define STRV_BASE      "/test/getallstrvtest"
+#define STRV_PROPERTY  STRV_BASE "/strv"
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+    GHashTable *properties;
+    GValue value = { 0, }, *strv_value;
+    gchar **strv;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+
+    /* a G_TYPE_STRV goes over the wire as "as" and is kept that way by
+     * the daemon until the channel is written out */
+    g_value_init(&value, G_TYPE_STRV);
+    g_value_set_boxed(&value, test_strlist);
+    TEST_OPERATION(blconf_channel_set_property(channel, STRV_PROPERTY, &value));
+    g_value_unset(&value);
+
+    /* the daemon writes GetAllProperties replies itself, so this has
+     * to come back whole rather than falling back to dbus-glib */
+    properties = blconf_channel_get_properties(channel, STRV_BASE);
+    TEST_OPERATION(properties != NULL);
+    TEST_OPERATION(g_hash_table_size(properties) == 1);
+
+    strv_value = g_hash_table_lookup(properties, STRV_PROPERTY);
+    TEST_OPERATION(strv_value && G_VALUE_HOLDS(strv_value, G_TYPE_STRV));
+
+    strv = g_value_get_boxed(strv_value);
+    TEST_OPERATION(strv && g_strv_length(strv) == 2
+                   && !strcmp(strv[0], test_strlist[0])
+                   && !strcmp(strv[1], test_strlist[1]));
+
+    g_hash_table_destroy(properties);
+
+    blconf_channel_reset_property(channel, STRV_BASE, TRUE);
+
+    g_object_unref(G_OBJECT(channel));
+
+    blconf_tests_end();
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ *  blconf
+ *
+ *  Copyright (c) 2007 Brian Tarricone <bjt23@cornell.edu>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+typedef struct
+{
+    GMainLoop *mloop;
+    gint pending;
+    gint n_strings;
+    gboolean got_missing;
+    gboolean got_cancelled;
+} AsyncTestData;
+
+static void
+test_done(AsyncTestData *atd)
+{
+    if(--atd->pending == 0)
+        g_main_loop_quit(atd->mloop);
+}
+
+static void
+test_got_string(GObject *source,
+                GAsyncResult *result,
+                gpointer user_data)
+{
+    AsyncTestData *atd = user_data;
+    GValue value = { 0, };
+
+    if(blconf_channel_get_property_finish(BLCONF_CHANNEL(source), result,
+                                          &value, NULL))
+    {
+        if(G_VALUE_HOLDS_STRING(&value)
+           && !strcmp(g_value_get_string(&value), test_string))
+        {
+            atd->n_strings++;
+        }
+        g_value_unset(&value);
+    }
+
+    test_done(atd);
+}
+
+static void
+test_got_has_property(GObject *source,
+                      GAsyncResult *result,
+                      gpointer user_data)
+{
+    AsyncTestData *atd = user_data;
+    GError *error = NULL;
+
+    if(!blconf_channel_has_property_finish(BLCONF_CHANNEL(source), result,
+                                           &error)
+       && !error)
+    {
+        atd->got_missing = TRUE;
+    }
+    if(error)
+        g_error_free(error);
+
+    test_done(atd);
+}
+
+static void
+test_got_cancelled(GObject *source,
+                   GAsyncResult *result,
+                   gpointer user_data)
+{
+    AsyncTestData *atd = user_data;
+    GValue value = { 0, };
+    GError *error = NULL;
+
+    if(!blconf_channel_get_property_finish(BLCONF_CHANNEL(source), result,
+                                           &value, &error))
+    {
+        atd->got_cancelled = g_error_matches(error, G_IO_ERROR,
+                                             G_IO_ERROR_CANCELLED);
+        g_error_free(error);
+    } else
+        g_value_unset(&value);
+
+    test_done(atd);
+}
+
+static gboolean
+test_watchdog(gpointer data)
+{
+    AsyncTestData *atd = data;
+    g_main_loop_quit(atd->mloop);
+    return FALSE;
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+    GCancellable *cancellable;
+    AsyncTestData atd = { NULL, 4, 0, FALSE, FALSE };
+    
+    if(!blconf_tests_start())
+        return 1;
+    
+    atd.mloop = g_main_loop_new(NULL, FALSE);
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+    cancellable = g_cancellable_new();
+    
+    /* both misses are served by the same request */
+    blconf_channel_get_property_async(channel, test_string_property, NULL,
+                                      test_got_string, &atd);
+    blconf_channel_get_property_async(channel, test_string_property, NULL,
+                                      test_got_string, &atd);
+    blconf_channel_has_property_async(channel, "/test/asynctest/nonexistent",
+                                      NULL, test_got_has_property, &atd);
+    blconf_channel_get_property_async(channel, test_int_property, cancellable,
+                                      test_got_cancelled, &atd);
+    g_cancellable_cancel(cancellable);
+    
+    g_timeout_add(WAIT_TIMEOUT * 1000, test_watchdog, &atd);
+    g_main_loop_run(atd.mloop);
+    
+    TEST_OPERATION(atd.pending == 0);
+    TEST_OPERATION(atd.n_strings == 2);
+    TEST_OPERATION(atd.got_missing);
+    TEST_OPERATION(atd.got_cancelled);
+    
+    g_object_unref(cancellable);
+    g_object_unref(G_OBJECT(channel));
+    g_main_loop_unref(atd.mloop);
+    
+    blconf_tests_end();
+    
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ *  blconf
+ *
+ *  Copyright (c) 2007 Brian Tarricone <bjt23@cornell.edu>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+    GHashTable *values;
+    GValue *value;
+    const gchar *properties[] = {
+        test_string_property,
+        test_int_property,
+        "/test/getmanytest/nonexistent",
+        NULL
+    };
+    
+    if(!blconf_tests_start())
+        return 1;
+    
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+    
+    values = blconf_channel_get_many(channel, properties);
+    TEST_OPERATION(values != NULL);
+    TEST_OPERATION(g_hash_table_size(values) == 2);
+    value = g_hash_table_lookup(values, test_string_property);
+    TEST_OPERATION(value && G_VALUE_HOLDS_STRING(value)
+                   && !strcmp(g_value_get_string(value), test_string));
+    value = g_hash_table_lookup(values, test_int_property);
+    TEST_OPERATION(value && G_VALUE_HOLDS_INT(value)
+                   && g_value_get_int(value) == test_int);
+    g_hash_table_destroy(values);
+    
+    g_object_unref(G_OBJECT(channel));
+    
+    blconf_tests_end();
+    
+    return 0;
+}
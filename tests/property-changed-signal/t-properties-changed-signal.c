@@ -0,0 +1,171 @@
+/*
+ *  blconf
+ *
+ *  Copyright (c) 2007 Brian Tarricone <bjt23@cornell.edu>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#define BURST_BASE      "/test/burst"
+#define BURST_STRING    BURST_BASE "/string"
+#define BURST_INT       BURST_BASE "/int"
+
+#define SIGNAL_MATCH  "type='signal',interface='org.blade.Blconf'"
+
+typedef struct
+{
+    gint n_properties_changed;
+    gint n_changed;
+    GSList *removed;
+    gint n_property_changed;
+    gint n_property_removed;
+} SignalTestData;
+
+static void
+signal_test_data_clear(SignalTestData *std)
+{
+    std->n_properties_changed = std->n_changed = 0;
+    std->n_property_changed = std->n_property_removed = 0;
+    g_slist_foreach(std->removed, (GFunc)g_free, NULL);
+    g_slist_free(std->removed);
+    std->removed = NULL;
+}
+
+static gboolean
+test_has_removed(SignalTestData *std,
+                 const gchar *property)
+{
+    return g_slist_find_custom(std->removed, property,
+                               (GCompareFunc)strcmp) != NULL;
+}
+
+static DBusHandlerResult
+test_filter(DBusConnection *connection,
+            DBusMessage *message,
+            void *user_data)
+{
+    SignalTestData *std = user_data;
+    DBusMessageIter iter, sub;
+    const gchar *channel = NULL;
+
+    if(dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_SIGNAL
+       || g_strcmp0(dbus_message_get_interface(message), "org.blade.Blconf"))
+    {
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+    if(!dbus_message_iter_init(message, &iter)
+       || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+    {
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+    dbus_message_iter_get_basic(&iter, &channel);
+    if(g_ascii_strcasecmp(channel, TEST_CHANNEL_NAME))
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    if(dbus_message_has_member(message, "PropertiesChanged")) {
+        std->n_properties_changed++;
+
+        dbus_message_iter_next(&iter);
+        dbus_message_iter_recurse(&iter, &sub);
+        while(dbus_message_iter_get_arg_type(&sub) == DBUS_TYPE_DICT_ENTRY) {
+            std->n_changed++;
+            dbus_message_iter_next(&sub);
+        }
+
+        dbus_message_iter_next(&iter);
+        dbus_message_iter_recurse(&iter, &sub);
+        while(dbus_message_iter_get_arg_type(&sub) == DBUS_TYPE_STRING) {
+            const gchar *property;
+
+            dbus_message_iter_get_basic(&sub, &property);
+            std->removed = g_slist_prepend(std->removed, g_strdup(property));
+            dbus_message_iter_next(&sub);
+        }
+    } else if(dbus_message_has_member(message, "PropertyChanged"))
+        std->n_property_changed++;
+    else if(dbus_message_has_member(message, "PropertyRemoved"))
+        std->n_property_removed++;
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+    DBusConnection *dbus_conn;
+    SignalTestData std = { 0, 0, NULL, 0, 0 };
+
+    if(!blconf_tests_start())
+        return 1;
+
+    /* the same connection libblconf uses, so it's already hooked up to
+     * the main loop */
+    dbus_conn = dbus_bus_get(DBUS_BUS_SESSION, NULL);
+    dbus_bus_add_match(dbus_conn, SIGNAL_MATCH, NULL);
+    dbus_connection_add_filter(dbus_conn, test_filter, &std, NULL);
+
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+    blconf_channel_reset_property(channel, BURST_BASE, TRUE);
+    TEST_OPERATION(blconf_tests_sync());
+    signal_test_data_clear(&std);
+
+    /* a batch is set with a single call, so the daemon sees all of it at
+     * once; setting a property twice only gets it reported once */
+    blconf_channel_begin_batch(channel);
+    TEST_OPERATION(blconf_channel_set_string(channel, BURST_STRING, "first"));
+    TEST_OPERATION(blconf_channel_set_int(channel, BURST_INT, test_int));
+    TEST_OPERATION(blconf_channel_set_string(channel, BURST_STRING, test_string));
+    TEST_OPERATION(blconf_channel_commit_batch(channel));
+    TEST_OPERATION(blconf_tests_sync());
+
+    TEST_OPERATION(std.n_properties_changed == 1);
+    TEST_OPERATION(std.n_changed == 2);
+    TEST_OPERATION(std.removed == NULL);
+    /* nothing else, unless blconfd runs with --legacy-signals */
+    TEST_OPERATION(std.n_property_changed == 0);
+    TEST_OPERATION(std.n_property_removed == 0);
+    signal_test_data_clear(&std);
+
+    /* removing the whole subtree is one burst as well */
+    blconf_channel_reset_property(channel, BURST_BASE, TRUE);
+    TEST_OPERATION(blconf_tests_sync());
+
+    TEST_OPERATION(std.n_properties_changed == 1);
+    TEST_OPERATION(std.n_changed == 0);
+    TEST_OPERATION(g_slist_length(std.removed) == 2);
+    TEST_OPERATION(test_has_removed(&std, BURST_STRING));
+    TEST_OPERATION(test_has_removed(&std, BURST_INT));
+    TEST_OPERATION(std.n_property_changed == 0);
+    TEST_OPERATION(std.n_property_removed == 0);
+    signal_test_data_clear(&std);
+
+    dbus_connection_remove_filter(dbus_conn, test_filter, &std);
+    dbus_bus_remove_match(dbus_conn, SIGNAL_MATCH, NULL);
+    dbus_connection_unref(dbus_conn);
+
+    g_object_unref(G_OBJECT(channel));
+
+    blconf_tests_end();
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ *  blconf
+ *
+ *  Copyright (c) 2007 Brian Tarricone <bjt23@cornell.edu>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define NOOP_BASE      "/test/nooptest"
+#define NOOP_PROPERTY  NOOP_BASE "/string"
+/* only in the system defaults, see tests/test-xdg_config_dirs */
+#define NOOP_DEFAULT   NOOP_BASE "/system-only"
+
+#define SIGNAL_MATCH  "type='signal',interface='org.blade.Blconf',member='PropertiesChanged'"
+
+typedef struct
+{
+    gint n_properties_changed;
+} SignalTestData;
+
+static DBusHandlerResult
+test_filter(DBusConnection *connection,
+            DBusMessage *message,
+            void *user_data)
+{
+    SignalTestData *std = user_data;
+    const gchar *channel = NULL;
+
+    if(dbus_message_is_signal(message, "org.blade.Blconf", "PropertiesChanged")
+       && dbus_message_get_args(message, NULL,
+                                DBUS_TYPE_STRING, &channel,
+                                DBUS_TYPE_INVALID)
+       && !g_ascii_strcasecmp(channel, TEST_CHANNEL_NAME))
+    {
+        std->n_properties_changed++;
+    }
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+    DBusConnection *dbus_conn;
+    SignalTestData std = { 0 };
+    gchar *str;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    dbus_conn = dbus_bus_get(DBUS_BUS_SESSION, NULL);
+    dbus_bus_add_match(dbus_conn, SIGNAL_MATCH, NULL);
+    dbus_connection_add_filter(dbus_conn, test_filter, &std, NULL);
+
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+
+    /* leave the subtree behind without any values of its own */
+    TEST_OPERATION(blconf_channel_set_string(channel, NOOP_PROPERTY, test_string));
+    blconf_channel_reset_property(channel, NOOP_PROPERTY, FALSE);
+    TEST_OPERATION(!blconf_channel_has_property(channel, NOOP_PROPERTY));
+    TEST_OPERATION(blconf_tests_sync());
+    std.n_properties_changed = 0;
+
+    /* none of these change anything, so nobody should hear about them */
+    blconf_channel_reset_property(channel, NOOP_PROPERTY, FALSE);
+    blconf_channel_reset_property(channel, NOOP_BASE, TRUE);
+    blconf_channel_reset_property(channel, NOOP_BASE "/never-set", FALSE);
+    TEST_OPERATION(blconf_tests_sync());
+
+    TEST_OPERATION(std.n_properties_changed == 0);
+    TEST_OPERATION(!blconf_channel_has_property(channel, NOOP_PROPERTY));
+
+    /* there's no user value to drop, so the default stays and nothing
+     * changes */
+    TEST_OPERATION(blconf_channel_has_property(channel, NOOP_DEFAULT));
+    blconf_channel_reset_property(channel, NOOP_DEFAULT, FALSE);
+    TEST_OPERATION(blconf_tests_sync());
+
+    TEST_OPERATION(std.n_properties_changed == 0);
+    str = blconf_channel_get_string(channel, NOOP_DEFAULT, NULL);
+    TEST_OPERATION(!g_strcmp0(str, "default"));
+    g_free(str);
+
+    dbus_connection_remove_filter(dbus_conn, test_filter, &std);
+    dbus_bus_remove_match(dbus_conn, SIGNAL_MATCH, NULL);
+    dbus_connection_unref(dbus_conn);
+
+    g_object_unref(G_OBJECT(channel));
+
+    blconf_tests_end();
+
+    return 0;
+}
@@ -47,6 +47,11 @@
 #define TEST_CHANNEL_NAME  "test-channel"
 #define WAIT_TIMEOUT       15
 
+/* a channel of its own that blconf_tests_sync() changes */
+#define TEST_SENTINEL_CHANNEL   "test-sentinel"
+#define TEST_SENTINEL_PROPERTY  "/sentinel"
+#define TEST_SENTINEL_MATCH     "type='signal',interface='org.blade.Blconf',member='PropertiesChanged',arg0='" TEST_SENTINEL_CHANNEL "'"
+
 #define TEST_OPERATION(x) G_STMT_START{ \
     if(!(x)) { \
         g_critical("Test failed: " # x); \
@@ -128,4 +133,111 @@ blconf_tests_end(void)
     blconf_shutdown();
 }
 
+typedef struct
+{
+    GMainLoop *mloop;
+    gboolean seen;
+} BlconfTestsSync;
+
+/* not static, for the same reason as the values above */
+DBusHandlerResult
+blconf_tests_sync_filter(DBusConnection *connection,
+                         DBusMessage *message,
+                         void *user_data)
+{
+    BlconfTestsSync *sync = user_data;
+    const gchar *channel = NULL;
+
+    if(dbus_message_is_signal(message, "org.blade.Blconf", "PropertiesChanged")
+       && dbus_message_get_args(message, NULL,
+                                DBUS_TYPE_STRING, &channel,
+                                DBUS_TYPE_INVALID)
+       && !g_ascii_strcasecmp(channel, TEST_SENTINEL_CHANNEL))
+    {
+        sync->seen = TRUE;
+        g_main_loop_quit(sync->mloop);
+    }
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+gboolean
+blconf_tests_sync_watchdog(gpointer data)
+{
+    BlconfTestsSync *sync = data;
+    g_main_loop_quit(sync->mloop);
+    return FALSE;
+}
+
+/* returns once everything blconfd sent before now has gone through the
+ * filters on the session bus connection.  blconfd signals changes from
+ * an idle callback, after the call that made them has returned, so a
+ * Ping on its own could get answered first.  a change to the sentinel
+ * channel isn't signalled any earlier than those, though, and once that
+ * has come in, a Ping brings along whatever was sent with it. */
+gboolean
+blconf_tests_sync(void)
+{
+    DBusConnection *dbus_conn;
+    DBusMessage *msg, *ret;
+    BlconfChannel *sentinel;
+    BlconfTestsSync sync = { NULL, FALSE };
+    GTimeVal now;
+    guint watchdog_id;
+
+    dbus_conn = dbus_bus_get(DBUS_BUS_SESSION, NULL);
+    if(!dbus_conn)
+        return FALSE;
+
+    sync.mloop = g_main_loop_new(NULL, FALSE);
+    dbus_bus_add_match(dbus_conn, TEST_SENTINEL_MATCH, NULL);
+    dbus_connection_add_filter(dbus_conn, blconf_tests_sync_filter,
+                               &sync, NULL);
+
+    /* a new value every time, so there's always a change to signal */
+    g_get_current_time(&now);
+    sentinel = blconf_channel_new(TEST_SENTINEL_CHANNEL);
+    if(blconf_channel_set_uint64(sentinel, TEST_SENTINEL_PROPERTY,
+                                 (guint64)now.tv_sec * G_USEC_PER_SEC
+                                 + now.tv_usec))
+    {
+        watchdog_id = g_timeout_add_seconds(WAIT_TIMEOUT,
+                                            blconf_tests_sync_watchdog,
+                                            &sync);
+        g_main_loop_run(sync.mloop);
+        if(sync.seen)
+            g_source_remove(watchdog_id);
+    }
+    g_object_unref(G_OBJECT(sentinel));
+
+    dbus_connection_remove_filter(dbus_conn, blconf_tests_sync_filter, &sync);
+    dbus_bus_remove_match(dbus_conn, TEST_SENTINEL_MATCH, NULL);
+    g_main_loop_unref(sync.mloop);
+
+    if(sync.seen) {
+        msg = dbus_message_new_method_call("org.blade.Blconf",
+                                           "/org/blade/Blconf",
+                                           "org.freedesktop.DBus.Peer",
+                                           "Ping");
+        ret = dbus_connection_send_with_reply_and_block(dbus_conn, msg,
+                                                        -1, NULL);
+        dbus_message_unref(msg);
+        if(ret)
+            dbus_message_unref(ret);
+        else
+            sync.seen = FALSE;
+
+        /* hand what came in meanwhile to the test's filters */
+        while(g_main_context_iteration(NULL, FALSE))
+            ;
+    }
+
+    dbus_connection_unref(dbus_conn);
+
+    if(!sync.seen)
+        g_critical("blconfd didn't catch up within %d seconds", WAIT_TIMEOUT);
+
+    return sync.seen;
+}
+
 #endif  /* __BLCONF_TESTS_COMMON_H__ */